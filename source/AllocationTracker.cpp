@@ -0,0 +1,206 @@
+#include "AllocationTracker.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+namespace dae {
+	namespace
+	{
+		std::atomic<uint64_t> g_NumAllocations{};
+		std::atomic<uint64_t> g_NumBytes{};
+		std::atomic<bool> g_IsAssertEnabled{ false };
+		std::atomic<AllocationTracker::Site*> g_pFirstSite{};
+	}
+
+#if ALLOCATION_TRACKING_ENABLED
+	namespace
+	{
+		void* AllocateCounted(size_t size) noexcept
+		{
+			g_NumAllocations.fetch_add(1, std::memory_order_relaxed);
+			g_NumBytes.fetch_add(size, std::memory_order_relaxed);
+			return std::malloc(size > 0 ? size : 1);
+		}
+
+		void* AllocateCountedAligned(size_t size, size_t alignment) noexcept
+		{
+			g_NumAllocations.fetch_add(1, std::memory_order_relaxed);
+			g_NumBytes.fetch_add(size, std::memory_order_relaxed);
+#if defined(_MSC_VER)
+			return _aligned_malloc(size > 0 ? size : 1, alignment);
+#else
+			//aligned_alloc wants a non-zero multiple of the alignment
+			const size_t paddedSize{ size > 0 ? (size + alignment - 1) / alignment * alignment : alignment };
+			return std::aligned_alloc(alignment, paddedSize);
+#endif
+		}
+
+		void FreeAligned(void* pMemory) noexcept
+		{
+#if defined(_MSC_VER)
+			_aligned_free(pMemory);
+#else
+			std::free(pMemory);
+#endif
+		}
+	}
+#endif
+
+	AllocationTracker::Counts AllocationTracker::GetCounts()
+	{
+		return { g_NumAllocations.load(std::memory_order_relaxed), g_NumBytes.load(std::memory_order_relaxed) };
+	}
+
+	AllocationTracker::Site::Site(const char* _name) :
+		name(_name),
+		pNext(g_pFirstSite.load())
+	{
+		while (!g_pFirstSite.compare_exchange_weak(pNext, this)) {}
+	}
+
+	void AllocationTracker::SetAssertEnabled(bool isEnabled)
+	{
+		g_IsAssertEnabled = isEnabled;
+	}
+
+	bool AllocationTracker::IsAssertEnabled()
+	{
+		return g_IsAssertEnabled;
+	}
+
+	void AllocationTracker::EndRun(Site& site, const Counts& start)
+	{
+		const Counts end{ GetCounts() };
+		const uint64_t numAllocations{ end.numAllocations - start.numAllocations };
+		if (site.numRuns.fetch_add(1) < Site::NumWarmupRuns || numAllocations == 0)
+			return;
+
+		site.numAllocations += numAllocations;
+		site.numBytes += end.numBytes - start.numBytes;
+		if (IsAssertEnabled())
+		{
+			std::cout << numAllocations << " heap allocations in " << site.name << std::endl;
+			assert(!"Heap allocation in a scope that should not allocate");
+		}
+	}
+
+	void AllocationTracker::PrintSites()
+	{
+		for (Site* pSite{ g_pFirstSite.load() }; pSite; pSite = pSite->pNext)
+		{
+			const uint64_t numAllocations{ pSite->numAllocations.exchange(0) };
+			const uint64_t numBytes{ pSite->numBytes.exchange(0) };
+			if (numAllocations > 0)
+				std::cout << "Allocations in " << pSite->name << ": " << numAllocations << " (" << numBytes << " bytes)" << std::endl;
+		}
+	}
+}
+
+#if ALLOCATION_TRACKING_ENABLED
+#pragma region Global operator new
+void* operator new(size_t size)
+{
+	if (void* pMemory{ dae::AllocateCounted(size) })
+		return pMemory;
+	throw std::bad_alloc{};
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return dae::AllocateCounted(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return dae::AllocateCounted(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	if (void* pMemory{ dae::AllocateCountedAligned(size, static_cast<size_t>(alignment)) })
+		return pMemory;
+	throw std::bad_alloc{};
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return dae::AllocateCountedAligned(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return dae::AllocateCountedAligned(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* pMemory) noexcept
+{
+	std::free(pMemory);
+}
+
+void operator delete[](void* pMemory) noexcept
+{
+	std::free(pMemory);
+}
+
+void operator delete(void* pMemory, size_t) noexcept
+{
+	std::free(pMemory);
+}
+
+void operator delete[](void* pMemory, size_t) noexcept
+{
+	std::free(pMemory);
+}
+
+void operator delete(void* pMemory, const std::nothrow_t&) noexcept
+{
+	std::free(pMemory);
+}
+
+void operator delete[](void* pMemory, const std::nothrow_t&) noexcept
+{
+	std::free(pMemory);
+}
+
+void operator delete(void* pMemory, std::align_val_t) noexcept
+{
+	dae::FreeAligned(pMemory);
+}
+
+void operator delete[](void* pMemory, std::align_val_t) noexcept
+{
+	dae::FreeAligned(pMemory);
+}
+
+void operator delete(void* pMemory, size_t, std::align_val_t) noexcept
+{
+	dae::FreeAligned(pMemory);
+}
+
+void operator delete[](void* pMemory, size_t, std::align_val_t) noexcept
+{
+	dae::FreeAligned(pMemory);
+}
+
+void operator delete(void* pMemory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	dae::FreeAligned(pMemory);
+}
+
+void operator delete[](void* pMemory, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	dae::FreeAligned(pMemory);
+}
+#pragma endregion
+#endif
@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+//Replaces the global operator new to count heap allocations. On in debug builds, define it as 1 for release benchmarks
+#ifndef ALLOCATION_TRACKING_ENABLED
+#ifdef NDEBUG
+#define ALLOCATION_TRACKING_ENABLED 0
+#else
+#define ALLOCATION_TRACKING_ENABLED 1
+#endif
+#endif
+
+namespace dae
+{
+	namespace AllocationTracker
+	{
+		struct Counts
+		{
+			uint64_t numAllocations{};
+			uint64_t numBytes{};
+		};
+
+		//Allocations of all threads since the program started, zero when tracking is compiled out
+		Counts GetCounts();
+
+		//Code that should not allocate once it ran a few times, counted across all of its runs
+		struct Site
+		{
+			//Runs that may allocate, to grow reused buffers, before a check fails
+			static constexpr uint32_t NumWarmupRuns{ 3 };
+
+			Site(const char* _name);
+
+			//Has to be a string literal, only the pointer is stored
+			const char* name{};
+			std::atomic<uint32_t> numRuns{};
+			//Allocations after the warmup runs
+			std::atomic<uint64_t> numAllocations{};
+			std::atomic<uint64_t> numBytes{};
+			Site* pNext{};
+		};
+
+		//Assert when a site allocates after its warmup, otherwise the allocations are only counted
+		void SetAssertEnabled(bool isEnabled);
+		bool IsAssertEnabled();
+
+		void EndRun(Site& site, const Counts& start);
+		//Prints every site that allocated after its warmup and resets their counts
+		void PrintSites();
+
+		class ScopedCheck final
+		{
+		public:
+			explicit ScopedCheck(Site& site) :
+				m_Site(site),
+				m_Start(GetCounts())
+			{
+			}
+			~ScopedCheck()
+			{
+				EndRun(m_Site, m_Start);
+			}
+
+			ScopedCheck(const ScopedCheck&) = delete;
+			ScopedCheck(ScopedCheck&&) noexcept = delete;
+			ScopedCheck& operator=(const ScopedCheck&) = delete;
+			ScopedCheck& operator=(ScopedCheck&&) noexcept = delete;
+
+		private:
+			Site& m_Site;
+			Counts m_Start{};
+		};
+	}
+}
+
+#define ALLOCATION_CONCAT_IMPL(a, b) a##b
+#define ALLOCATION_CONCAT(a, b) ALLOCATION_CONCAT_IMPL(a, b)
+
+//Counts are global, allocations of other threads running at the same time are attributed to the scope as well
+#if ALLOCATION_TRACKING_ENABLED
+#define ALLOCATION_CHECK_SCOPE(name) \
+	static ::dae::AllocationTracker::Site ALLOCATION_CONCAT(allocationSite, __LINE__){ name }; \
+	const ::dae::AllocationTracker::ScopedCheck ALLOCATION_CONCAT(allocationCheck, __LINE__){ ALLOCATION_CONCAT(allocationSite, __LINE__) }
+#else
+#define ALLOCATION_CHECK_SCOPE(name) ((void)0)
+#endif
@@ -13,12 +13,12 @@ namespace dae
 		 */
 		static ColorRGB Lambert(float kd, const ColorRGB& cd)
 		{
-			return (cd * kd)/PI;
+			return cd * (kd * INV_PI);
 		}
 
 		static ColorRGB Lambert(const ColorRGB& kd, const ColorRGB& cd)
 		{
-			return (cd * kd)/PI;
+			return (cd * kd) * INV_PI;
 		}
 
 
@@ -39,6 +39,18 @@ namespace dae
 			return ColorRGB{ calc, calc, calc };
 		}
 
+		/**
+		 * \brief Phong for integer exponents, evaluated with multiplies instead of powf
+		 * \param exp Phong Exponent (>= 0)
+		 */
+		static ColorRGB Phong(float ks, int exp, const Vector3& l, const Vector3& v, const Vector3& n)
+		{
+			Vector3 reflect{ l - 2 * (Vector3::Dot(n,l) * n) };
+			float cosa{ Vector3::Dot(reflect, v) };
+			float calc{ ks * PowInt(cosa, exp) };
+			return ColorRGB{ calc, calc, calc };
+		}
+
 		/**
 		 * \brief BRDF Fresnel Function >> Schlick
 		 * \param h Normalized Halfvector between View and Light directions
@@ -48,7 +60,21 @@ namespace dae
 		 */
 		static ColorRGB FresnelFunction_Schlick(const Vector3& h, const Vector3& v, const ColorRGB& f0)
 		{
-			return f0 + (ColorRGB(1, 1, 1) - f0) * powf((1 - (Vector3::Dot(h, v))), 5);
+			const float x{ 1 - Vector3::Dot(h, v) };
+			const float x2{ x * x };
+			return f0 + (ColorRGB(1, 1, 1) - f0) * (x2 * x2 * x);
+		}
+
+		/**
+		 * \brief Trowbridge-Reitz GGX with squared(roughness) precomputed by the material
+		 * \param alpha2 Squared roughness
+		 */
+		static float NormalDistribution_GGX_Alpha2(const Vector3& n, const Vector3& h, float alpha2)
+		{
+			float nhSquared = Square(Vector3::Dot(n, h));
+			float B = alpha2 - 1;
+
+			return alpha2 * INV_PI / Square(nhSquared * B + 1);
 		}
 
 		/**
@@ -60,12 +86,26 @@ namespace dae
 		 */
 		static float NormalDistribution_GGX(const Vector3& n, const Vector3& h, float roughness)
 		{
-			float nhSquared = Square(Vector3::Dot(n, h));
-			float B = Square(roughness) - 1;
+			return NormalDistribution_GGX_Alpha2(n, h, Square(roughness));
+		}
+
 
-			return Square(roughness) / (PI * Square(nhSquared * B + 1));
+		//Remapping of roughness to k for direct lighting
+		static float GetSchlickGGX_K(float roughness)
+		{
+			return Square((roughness + 1)) * 0.125f;
 		}
 
+		/**
+		 * \brief Schlick GGX with k precomputed by the material (see GetSchlickGGX_K)
+		 */
+		static float GeometryFunction_SchlickGGX_K(const Vector3& n, const Vector3& v, float k)
+		{
+			float dotNV = Vector3::Dot(n, v);
+			if (dotNV < 0) return 0;
+
+			return dotNV / (dotNV * (1 - k) + k);
+		}
 
 		/**
 		 * \brief BRDF Geometry Function >> Schlick GGX (Direct Lighting + UE4 implementation - squared(roughness))
@@ -76,12 +116,17 @@ namespace dae
 		 */
 		static float GeometryFunction_SchlickGGX(const Vector3& n, const Vector3& v, float roughness)
 		{
-			float k = Square((roughness + 1)) / 8;
-			float dotNV = Vector3::Dot(n, v);
-			if (dotNV < 0) return 0;
-			
+			return GeometryFunction_SchlickGGX_K(n, v, GetSchlickGGX_K(roughness));
+		}
 
-			return dotNV / (dotNV * (1 - k) + k);
+		/**
+		 * \brief Smith with k precomputed by the material (see GetSchlickGGX_K)
+		 */
+		static float GeometryFunction_Smith_K(const Vector3& n, const Vector3& v, const Vector3& l, float k)
+		{
+			float Gv{ GeometryFunction_SchlickGGX_K(n, v, k) };
+			float Gl{ GeometryFunction_SchlickGGX_K(n, l, k) };
+			return Gv * Gl;
 		}
 
 		/**
@@ -94,9 +139,8 @@ namespace dae
 		 */
 		static float GeometryFunction_Smith(const Vector3& n, const Vector3& v, const Vector3& l, float roughness)
 		{
-			float Gv{ GeometryFunction_SchlickGGX(n, v, Square(roughness)) };
-			float Gl{ GeometryFunction_SchlickGGX(n, l, Square(roughness)) };
-			return Gv * Gl;
+			const float k{ GetSchlickGGX_K(Square(roughness)) };
+			return GeometryFunction_Smith_K(n, v, l, k);
 		}
 
 	}
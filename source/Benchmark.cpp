@@ -0,0 +1,547 @@
+#include "Benchmark.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include "AllocationTracker.h"
+#include "Camera.h"
+#include "Executor.h"
+#include "Profiler.h"
+#include "Renderer.h"
+#include "Scene.h"
+#include "Timer.h"
+
+namespace dae {
+	namespace
+	{
+		//Resident memory of the whole process in bytes, 0 when unknown
+		size_t GetProcessMemory()
+		{
+#if defined(_WIN32)
+			PROCESS_MEMORY_COUNTERS counters{};
+			if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+				return counters.WorkingSetSize;
+#elif defined(__linux__)
+			std::ifstream statm{ "/proc/self/statm" };
+			size_t totalPages{};
+			size_t residentPages{};
+			if (statm >> totalPages >> residentPages)
+				return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+			return 0;
+		}
+	}
+
+#pragma region CameraPath
+	void CameraPath::Apply(float time, Camera& camera) const
+	{
+		if (m_Keyframes.empty())
+			return;
+
+		const float duration{ GetDuration() };
+		if (duration > 0.f)
+			time = fmodf(time, duration);
+
+		//Find the keyframes around 'time'
+		size_t next{ 0 };
+		while (next < m_Keyframes.size() && m_Keyframes[next].time <= time)
+			++next;
+
+		if (next == 0 || next == m_Keyframes.size())
+		{
+			const CameraKeyframe& keyframe{ next == 0 ? m_Keyframes.front() : m_Keyframes.back() };
+			camera.origin = keyframe.origin;
+			camera.totalPitch = keyframe.totalPitch;
+			camera.totalYaw = keyframe.totalYaw;
+			return;
+		}
+
+		const CameraKeyframe& from{ m_Keyframes[next - 1] };
+		const CameraKeyframe& to{ m_Keyframes[next] };
+		const float t{ (time - from.time) / (to.time - from.time) };
+
+		camera.origin = from.origin + (to.origin - from.origin) * t;
+		camera.totalPitch = Lerpf(from.totalPitch, to.totalPitch, t);
+		camera.totalYaw = Lerpf(from.totalYaw, to.totalYaw, t);
+	}
+
+	CameraPath CameraPath::CreateDefault(const Camera& camera)
+	{
+		const Vector3 start{ camera.origin };
+		const float pitch{ camera.totalPitch };
+		const float yaw{ camera.totalYaw };
+
+		CameraPath path{};
+		path.AddKeyframe({ 0.f, start, pitch, yaw });
+		path.AddKeyframe({ 1.25f, start + Vector3{ 2.f, 0.f, 0.f }, pitch - 15.f, yaw });
+		path.AddKeyframe({ 2.5f, start + Vector3{ 0.f, 1.f, 2.f }, pitch, yaw + 10.f });
+		path.AddKeyframe({ 3.75f, start + Vector3{ -2.f, 0.f, 0.f }, pitch + 15.f, yaw });
+		path.AddKeyframe({ 5.f, start, pitch, yaw });
+		return path;
+	}
+#pragma endregion
+
+#pragma region Benchmark
+	Benchmark::Benchmark(const BenchmarkSettings& settings, const CameraPath& cameraPath) :
+		m_Settings(settings),
+		m_CameraPath(cameraPath)
+	{
+	}
+
+	void Benchmark::Run(Scene* pScene, Renderer* pRenderer, Timer* pTimer)
+	{
+		using Clock = std::chrono::steady_clock;
+		const auto toMilliseconds{ [](Clock::duration duration) { return std::chrono::duration<float, std::milli>(duration).count(); } };
+
+		Camera& camera{ pScene->GetCamera() };
+		camera.isInputEnabled = false;
+		pScene->SetExecutor(pRenderer->GetExecutor());
+
+		pTimer->SetFixedTimestep(m_Settings.timestep);
+		pTimer->Reset();
+
+		m_Frames.clear();
+		m_Frames.reserve(m_Settings.numFrames);
+		m_ImageHash = 14695981039346656037ull;
+		m_RayStats = RayStatsFrame{};
+
+		for (int frame{ -m_Settings.numWarmupFrames }; frame < m_Settings.numFrames; ++frame)
+		{
+			//Warmup frames render the first frame of the path, so recording starts with warm caches at time 0
+			const float time{ static_cast<float>(std::max(frame, 0)) * m_Settings.timestep };
+			m_CameraPath.Apply(time, camera);
+
+			PROFILE_SCOPE_ARG("Frame", frame);
+			const AllocationTracker::Counts allocationsStart{ AllocationTracker::GetCounts() };
+			const auto frameStart{ Clock::now() };
+			{
+				PROFILE_SCOPE("Scene::Update");
+				ALLOCATION_CHECK_SCOPE("Scene::Update");
+				pScene->Update(pTimer);
+			}
+			const auto updateEnd{ Clock::now() };
+			pRenderer->Render(pScene);
+			const auto frameEnd{ Clock::now() };
+
+			//Warmup frames don't advance the (fixed) time
+			if (frame >= 0)
+				pTimer->Update();
+			else
+				continue;
+
+			const FrameStats& stats{ pRenderer->GetFrameStats() };
+			FrameRecord record{};
+			record.frameTime = toMilliseconds(frameEnd - frameStart);
+			record.updateTime = toMilliseconds(updateEnd - frameStart);
+			record.traceTime = stats.traceTime;
+			record.denoiseTime = stats.denoiseTime;
+			record.resolveTime = stats.resolveTime;
+			record.presentTime = stats.presentTime;
+			record.numRays = stats.numRays;
+			record.numAllocations = AllocationTracker::GetCounts().numAllocations - allocationsStart.numAllocations;
+			m_Frames.push_back(record);
+
+			const RayStatsFrame& rayStats{ pRenderer->GetRayStats() };
+			for (int i{ 0 }; i < static_cast<int>(RayCounter::Count); ++i)
+			{
+				m_RayStats.counters[i] += rayStats.counters[i];
+			}
+
+			m_ImageHash = (m_ImageHash ^ pRenderer->GetImageHash()) * 1099511628211ull;
+		}
+
+		pTimer->Stop();
+		pTimer->SetFixedTimestep(0.f);
+		camera.isInputEnabled = true;
+
+		m_SortedFrameTimes.clear();
+		for (const FrameRecord& record : m_Frames)
+		{
+			m_SortedFrameTimes.push_back(record.frameTime);
+		}
+		std::sort(m_SortedFrameTimes.begin(), m_SortedFrameTimes.end());
+	}
+
+	float Benchmark::GetPercentile(float percentile) const
+	{
+		if (m_SortedFrameTimes.empty())
+			return 0.f;
+
+		const size_t rank{ static_cast<size_t>(std::ceil(percentile / 100.f * m_SortedFrameTimes.size())) };
+		return m_SortedFrameTimes[std::clamp(rank, size_t{ 1 }, m_SortedFrameTimes.size()) - 1];
+	}
+
+	float Benchmark::GetMeanFrameTime() const
+	{
+		float totalTime{ 0.f };
+		for (const FrameRecord& record : m_Frames)
+		{
+			totalTime += record.frameTime;
+		}
+		return m_Frames.empty() ? 0.f : totalTime / static_cast<float>(m_Frames.size());
+	}
+
+	float Benchmark::GetRaysPerSecond() const
+	{
+		uint64_t numRays{ 0 };
+		float totalTime{ 0.f };
+		for (const FrameRecord& record : m_Frames)
+		{
+			numRays += record.numRays;
+			totalTime += record.traceTime;
+		}
+
+		return totalTime > 0.f ? static_cast<float>(numRays) / (totalTime * 0.001f) : 0.f;
+	}
+
+	float Benchmark::GetAllocationsPerFrame() const
+	{
+		if (m_Frames.empty())
+			return 0.f;
+
+		uint64_t numAllocations{ 0 };
+		for (const FrameRecord& record : m_Frames)
+		{
+			numAllocations += record.numAllocations;
+		}
+		return static_cast<float>(numAllocations) / static_cast<float>(m_Frames.size());
+	}
+
+	void Benchmark::PrintSummary() const
+	{
+		if (m_SortedFrameTimes.empty())
+			return;
+
+		std::cout << "**BENCHMARK FINISHED**" << std::endl;
+		std::cout << ">> Frames: " << m_Frames.size() << std::endl;
+		std::cout << ">> p50: " << GetPercentile(50.f) << " ms" << std::endl;
+		std::cout << ">> p95: " << GetPercentile(95.f) << " ms" << std::endl;
+		std::cout << ">> p99: " << GetPercentile(99.f) << " ms" << std::endl;
+		std::cout << ">> Rays/sec: " << GetRaysPerSecond() << std::endl;
+		if (ALLOCATION_TRACKING_ENABLED)
+			std::cout << ">> Allocations/frame: " << GetAllocationsPerFrame() << std::endl;
+		std::cout << ">> Image hash: " << std::hex << m_ImageHash << std::dec << std::endl;
+	}
+
+	bool Benchmark::WriteJson(const Renderer* pRenderer) const
+	{
+		std::ofstream file{ m_Settings.outputPath };
+		if (!file)
+			return false;
+
+		FrameRecord average{};
+		for (const FrameRecord& record : m_Frames)
+		{
+			average.updateTime += record.updateTime;
+			average.traceTime += record.traceTime;
+			average.denoiseTime += record.denoiseTime;
+			average.resolveTime += record.resolveTime;
+			average.presentTime += record.presentTime;
+			average.numRays += record.numRays;
+		}
+
+		const float frameWeight{ m_Frames.empty() ? 0.f : 1.f / static_cast<float>(m_Frames.size()) };
+		const Executor* pExecutor{ pRenderer->GetExecutor() };
+
+		file << "{\n";
+		file << "\t\"scene\": \"" << m_Settings.sceneName << "\",\n";
+		file << "\t\"backend\": \"" << pExecutor->GetName() << "\",\n";
+		file << "\t\"threads\": " << pExecutor->GetNumThreads() << ",\n";
+		file << "\t\"frames\": " << m_Settings.numFrames << ",\n";
+		file << "\t\"warmupFrames\": " << m_Settings.numWarmupFrames << ",\n";
+		file << "\t\"timestep\": " << m_Settings.timestep << ",\n";
+		file << "\t\"imageHash\": \"" << std::hex << m_ImageHash << std::dec << "\",\n";
+		file << "\t\"frameTime\": {\n";
+		file << "\t\t\"min\": " << (m_SortedFrameTimes.empty() ? 0.f : m_SortedFrameTimes.front()) << ",\n";
+		file << "\t\t\"max\": " << (m_SortedFrameTimes.empty() ? 0.f : m_SortedFrameTimes.back()) << ",\n";
+		file << "\t\t\"mean\": " << GetMeanFrameTime() << ",\n";
+		file << "\t\t\"p50\": " << GetPercentile(50.f) << ",\n";
+		file << "\t\t\"p95\": " << GetPercentile(95.f) << ",\n";
+		file << "\t\t\"p99\": " << GetPercentile(99.f) << "\n";
+		file << "\t},\n";
+		file << "\t\"raysPerFrame\": " << static_cast<float>(average.numRays) * frameWeight << ",\n";
+		file << "\t\"raysPerSecond\": " << GetRaysPerSecond() << ",\n";
+		file << "\t\"rayStats\": " << RayStats::ToJson(m_RayStats) << ",\n";
+		//null when the allocation counting is compiled out
+		if (ALLOCATION_TRACKING_ENABLED)
+			file << "\t\"allocationsPerFrame\": " << GetAllocationsPerFrame() << ",\n";
+		else
+			file << "\t\"allocationsPerFrame\": null,\n";
+		file << "\t\"phases\": {\n";
+		file << "\t\t\"update\": " << average.updateTime * frameWeight << ",\n";
+		file << "\t\t\"trace\": " << average.traceTime * frameWeight << ",\n";
+		file << "\t\t\"denoise\": " << average.denoiseTime * frameWeight << ",\n";
+		file << "\t\t\"resolve\": " << average.resolveTime * frameWeight << ",\n";
+		file << "\t\t\"present\": " << average.presentTime * frameWeight << "\n";
+		file << "\t},\n";
+		file << "\t\"frameTimes\": [";
+		for (size_t i{ 0 }; i < m_Frames.size(); ++i)
+		{
+			file << (i == 0 ? "" : ", ") << m_Frames[i].frameTime;
+		}
+		file << "]\n";
+		file << "}\n";
+
+		return file.good();
+	}
+#pragma endregion
+
+#pragma region ScalingSweep
+	ScalingSweep::ScalingSweep(const SweepSettings& settings) :
+		m_Settings(settings)
+	{
+	}
+
+	void ScalingSweep::Run(Renderer* pRenderer, Timer* pTimer)
+	{
+		m_Results.clear();
+
+		uint32_t value{ m_Settings.start };
+		for (int step{ 0 }; step < m_Settings.numSteps; ++step, value *= 2)
+		{
+			StressSceneSettings sceneSettings{ m_Settings.scene };
+			switch (m_Settings.parameter)
+			{
+			case SweepParameter::Spheres:
+				sceneSettings.numSpheres = value;
+				break;
+			case SweepParameter::Lights:
+				sceneSettings.numLights = value;
+				break;
+			case SweepParameter::MeshInstances:
+				sceneSettings.numMeshInstances = value;
+				break;
+			case SweepParameter::TerrainResolution:
+				sceneSettings.terrainResolution = static_cast<int>(value);
+				break;
+			}
+
+			Scene_Stress scene{ sceneSettings };
+			scene.Initialize();
+
+			Benchmark benchmark{ m_Settings.benchmark, CameraPath::CreateDefault(scene.GetCamera()) };
+			benchmark.Run(&scene, pRenderer, pTimer);
+
+			StepResult result{};
+			result.value = value;
+			result.numTriangles = scene.GetNumTriangles();
+			result.geometryBytes = scene.GetGeometryMemory();
+			result.processBytes = GetProcessMemory();
+			result.meanFrameTime = benchmark.GetMeanFrameTime();
+			result.p50FrameTime = benchmark.GetPercentile(50.f);
+			result.p95FrameTime = benchmark.GetPercentile(95.f);
+			result.raysPerSecond = benchmark.GetRaysPerSecond();
+			m_Results.push_back(result);
+
+			std::cout << GetParameterName(m_Settings.parameter) << " " << value << ": p50 " << result.p50FrameTime << " ms, "
+				<< result.numTriangles << " triangles, " << result.geometryBytes / 1024 << " KiB geometry" << std::endl;
+		}
+	}
+
+	void ScalingSweep::PrintSummary() const
+	{
+		std::cout << "**SWEEP FINISHED**" << std::endl;
+		std::cout << GetParameterName(m_Settings.parameter) << "\ttriangles\tp50 (ms)\tp95 (ms)\tgeometry (KiB)\tprocess (KiB)" << std::endl;
+		for (const StepResult& result : m_Results)
+		{
+			std::cout << result.value << "\t" << result.numTriangles << "\t" << result.p50FrameTime << "\t" << result.p95FrameTime << "\t"
+				<< result.geometryBytes / 1024 << "\t" << result.processBytes / 1024 << std::endl;
+		}
+	}
+
+	bool ScalingSweep::WriteJson(const Renderer* pRenderer) const
+	{
+		std::ofstream file{ m_Settings.outputPath };
+		if (!file)
+			return false;
+
+		const Executor* pExecutor{ pRenderer->GetExecutor() };
+
+		file << "{\n";
+		file << "\t\"parameter\": \"" << GetParameterName(m_Settings.parameter) << "\",\n";
+		file << "\t\"seed\": " << m_Settings.scene.seed << ",\n";
+		file << "\t\"backend\": \"" << pExecutor->GetName() << "\",\n";
+		file << "\t\"threads\": " << pExecutor->GetNumThreads() << ",\n";
+		file << "\t\"framesPerStep\": " << m_Settings.benchmark.numFrames << ",\n";
+		file << "\t\"steps\": [\n";
+		for (size_t i{ 0 }; i < m_Results.size(); ++i)
+		{
+			const StepResult& result{ m_Results[i] };
+			file << "\t\t{\"value\": " << result.value
+				<< ", \"triangles\": " << result.numTriangles
+				<< ", \"geometryBytes\": " << result.geometryBytes
+				<< ", \"processBytes\": " << result.processBytes
+				<< ", \"meanFrameTime\": " << result.meanFrameTime
+				<< ", \"p50FrameTime\": " << result.p50FrameTime
+				<< ", \"p95FrameTime\": " << result.p95FrameTime
+				<< ", \"raysPerSecond\": " << result.raysPerSecond
+				<< "}" << (i + 1 < m_Results.size() ? "," : "") << "\n";
+		}
+		file << "\t]\n";
+		file << "}\n";
+
+		return file.good();
+	}
+
+	const char* ScalingSweep::GetParameterName(SweepParameter parameter)
+	{
+		switch (parameter)
+		{
+		case SweepParameter::Spheres:
+			return "spheres";
+		case SweepParameter::Lights:
+			return "lights";
+		case SweepParameter::MeshInstances:
+			return "instances";
+		case SweepParameter::TerrainResolution:
+		default:
+			return "terrain";
+		}
+	}
+#pragma endregion
+
+#pragma region ThreadScalingBenchmark
+	ThreadScalingBenchmark::ThreadScalingBenchmark(const ThreadScalingSettings& settings) :
+		m_Settings(settings)
+	{
+	}
+
+	bool ThreadScalingBenchmark::Run(Renderer* pRenderer, Timer* pTimer)
+	{
+		m_Results.clear();
+
+		const uint32_t maxThreads{ m_Settings.maxThreads > 0 ? m_Settings.maxThreads : std::max(std::thread::hardware_concurrency(), 1u) };
+
+		//1, 2, 4 ... and maxThreads itself when it isn't a power of two
+		std::vector<uint32_t> threadCounts{};
+		for (uint32_t numThreads{ 1 }; numThreads < maxThreads; numThreads *= 2)
+		{
+			threadCounts.push_back(numThreads);
+		}
+		threadCounts.push_back(maxThreads);
+
+		BenchmarkSettings benchmarkSettings{ m_Settings.benchmark };
+		benchmarkSettings.sceneName = m_Settings.sceneName;
+
+		for (const uint32_t numThreads : threadCounts)
+		{
+			Scene* pScene{ CreateScene(m_Settings.sceneName) };
+			if (!pScene)
+				return false;
+			pScene->Initialize();
+
+			pRenderer->SetExecutionBackend(ExecutionBackend::ThreadPool, numThreads, m_Settings.pinThreads);
+			Executor* pExecutor{ pRenderer->GetExecutor() };
+			pExecutor->ResetBusyTimes();
+
+			Benchmark benchmark{ benchmarkSettings, CameraPath::CreateDefault(pScene->GetCamera()) };
+			const auto start{ std::chrono::steady_clock::now() };
+			benchmark.Run(pScene, pRenderer, pTimer);
+			const auto end{ std::chrono::steady_clock::now() };
+
+			StepResult result{};
+			result.numThreads = numThreads;
+			result.meanFrameTime = benchmark.GetMeanFrameTime();
+			result.p50FrameTime = benchmark.GetPercentile(50.f);
+			result.p95FrameTime = benchmark.GetPercentile(95.f);
+			result.wallTime = std::chrono::duration<float, std::milli>(end - start).count();
+			result.imageHash = benchmark.GetImageHash();
+
+			std::vector<uint64_t> busyNanoseconds{};
+			pExecutor->GetBusyTimes(busyNanoseconds);
+			for (const uint64_t busy : busyNanoseconds)
+			{
+				result.busyTimes.push_back(static_cast<float>(busy) * 1e-6f);
+			}
+
+			const float baseFrameTime{ m_Results.empty() ? result.meanFrameTime : m_Results.front().meanFrameTime };
+			result.speedup = result.meanFrameTime > 0.f ? baseFrameTime / result.meanFrameTime : 0.f;
+			result.efficiency = result.speedup / static_cast<float>(numThreads);
+			m_Results.push_back(result);
+
+			std::cout << numThreads << " threads: mean " << result.meanFrameTime << " ms, speedup " << result.speedup << std::endl;
+
+			delete pScene;
+		}
+
+		return true;
+	}
+
+	void ThreadScalingBenchmark::PrintSummary() const
+	{
+		std::cout << "**THREAD SCALING FINISHED** (" << m_Settings.sceneName << (m_Settings.pinThreads ? ", pinned" : "") << ")" << std::endl;
+		std::cout << "threads\tmean (ms)\tp95 (ms)\tspeedup\tefficiency\tbusy min/avg/max (%)" << std::endl;
+		for (const StepResult& result : m_Results)
+		{
+			float minBusy{ FLT_MAX };
+			float maxBusy{ 0.f };
+			float totalBusy{ 0.f };
+			for (const float busy : result.busyTimes)
+			{
+				minBusy = std::min(minBusy, busy);
+				maxBusy = std::max(maxBusy, busy);
+				totalBusy += busy;
+			}
+			const float toPercent{ result.wallTime > 0.f ? 100.f / result.wallTime : 0.f };
+			const float averageBusy{ result.busyTimes.empty() ? 0.f : totalBusy / static_cast<float>(result.busyTimes.size()) };
+
+			std::cout << result.numThreads << "\t" << result.meanFrameTime << "\t" << result.p95FrameTime << "\t"
+				<< result.speedup << "\t" << result.efficiency * 100.f << "%\t"
+				<< minBusy * toPercent << "/" << averageBusy * toPercent << "/" << maxBusy * toPercent << std::endl;
+		}
+
+		//Every thread count has to render the same images
+		for (const StepResult& result : m_Results)
+		{
+			if (result.imageHash != m_Results.front().imageHash)
+				std::cout << "WARNING: " << result.numThreads << " threads rendered different images than 1 thread" << std::endl;
+		}
+	}
+
+	bool ThreadScalingBenchmark::WriteJson() const
+	{
+		std::ofstream file{ m_Settings.outputPath };
+		if (!file)
+			return false;
+
+		file << "{\n";
+		file << "\t\"scene\": \"" << m_Settings.sceneName << "\",\n";
+		file << "\t\"pinned\": " << (m_Settings.pinThreads ? "true" : "false") << ",\n";
+		file << "\t\"framesPerStep\": " << m_Settings.benchmark.numFrames << ",\n";
+		file << "\t\"steps\": [\n";
+		for (size_t i{ 0 }; i < m_Results.size(); ++i)
+		{
+			const StepResult& result{ m_Results[i] };
+			file << "\t\t{\"threads\": " << result.numThreads
+				<< ", \"meanFrameTime\": " << result.meanFrameTime
+				<< ", \"p50FrameTime\": " << result.p50FrameTime
+				<< ", \"p95FrameTime\": " << result.p95FrameTime
+				<< ", \"speedup\": " << result.speedup
+				<< ", \"efficiency\": " << result.efficiency
+				<< ", \"wallTime\": " << result.wallTime
+				<< ", \"imageHash\": \"" << std::hex << result.imageHash << std::dec << "\""
+				<< ", \"busyTimes\": [";
+			for (size_t thread{ 0 }; thread < result.busyTimes.size(); ++thread)
+			{
+				file << (thread == 0 ? "" : ", ") << result.busyTimes[thread];
+			}
+			file << "]}" << (i + 1 < m_Results.size() ? "," : "") << "\n";
+		}
+		file << "\t]\n";
+		file << "}\n";
+
+		return file.good();
+	}
+#pragma endregion
+}
@@ -0,0 +1,219 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Math.h"
+#include "RayStats.h"
+#include "Scene.h"
+
+namespace dae
+{
+	class Renderer;
+	class Timer;
+	struct Camera;
+
+	struct CameraKeyframe
+	{
+		float time{};
+		Vector3 origin{};
+		float totalPitch{};
+		float totalYaw{};
+	};
+
+	//Camera animation without any input, linearly interpolated between keyframes and looping after the last one
+	class CameraPath final
+	{
+	public:
+		CameraPath() = default;
+		~CameraPath() = default;
+
+		CameraPath(const CameraPath&) = default;
+		CameraPath(CameraPath&&) noexcept = default;
+		CameraPath& operator=(const CameraPath&) = default;
+		CameraPath& operator=(CameraPath&&) noexcept = default;
+
+		//Keyframes have to be added in increasing time
+		void AddKeyframe(const CameraKeyframe& keyframe) { m_Keyframes.push_back(keyframe); }
+		void Apply(float time, Camera& camera) const;
+		float GetDuration() const { return m_Keyframes.empty() ? 0.f : m_Keyframes.back().time; }
+
+		//Orbit-like sweep around the start position of the camera
+		static CameraPath CreateDefault(const Camera& camera);
+
+	private:
+		std::vector<CameraKeyframe> m_Keyframes{};
+	};
+
+	struct BenchmarkSettings
+	{
+		std::string sceneName{};
+		std::string outputPath{ "benchmark.json" };
+		int numFrames{ 300 };
+		//Rendered before recording starts, not part of the results
+		int numWarmupFrames{ 10 };
+		float timestep{ 1.f / 60.f };
+	};
+
+	//Renders a fixed number of frames along a camera path with a fixed timestep, so every run renders the same images
+	class Benchmark final
+	{
+	public:
+		Benchmark(const BenchmarkSettings& settings, const CameraPath& cameraPath);
+		~Benchmark() = default;
+
+		Benchmark(const Benchmark&) = delete;
+		Benchmark(Benchmark&&) noexcept = delete;
+		Benchmark& operator=(const Benchmark&) = delete;
+		Benchmark& operator=(Benchmark&&) noexcept = delete;
+
+		/**
+		 * \brief Renders all frames, takes over the camera and the timer of the scene
+		 * \param pScene Initialized scene
+		 */
+		void Run(Scene* pScene, Renderer* pRenderer, Timer* pTimer);
+
+		void PrintSummary() const;
+		//Writes the settings, every frame time, the percentiles and the per-phase averages
+		bool WriteJson(const Renderer* pRenderer) const;
+
+		//Nearest-rank percentile of the recorded frame times (ms)
+		float GetPercentile(float percentile) const;
+		float GetMeanFrameTime() const;
+		float GetRaysPerSecond() const;
+		//Heap allocations of all threads during a recorded frame, 0 when built without ALLOCATION_TRACKING_ENABLED
+		float GetAllocationsPerFrame() const;
+		uint64_t GetImageHash() const { return m_ImageHash; }
+
+	private:
+		struct FrameRecord
+		{
+			float frameTime{};
+			float updateTime{};
+			float traceTime{};
+			float denoiseTime{};
+			float resolveTime{};
+			float presentTime{};
+			uint64_t numRays{};
+			uint64_t numAllocations{};
+		};
+
+		BenchmarkSettings m_Settings{};
+		CameraPath m_CameraPath{};
+
+		std::vector<FrameRecord> m_Frames{};
+		//Frame times, sorted after the run
+		std::vector<float> m_SortedFrameTimes{};
+		//Summed over all recorded frames
+		RayStatsFrame m_RayStats{};
+		uint64_t m_ImageHash{};
+	};
+
+	enum class SweepParameter
+	{
+		Spheres,
+		Lights,
+		MeshInstances,
+		TerrainResolution
+	};
+
+	struct SweepSettings
+	{
+		SweepParameter parameter{ SweepParameter::Spheres };
+		//Value of the first step, every next step doubles it
+		uint32_t start{ 16 };
+		int numSteps{ 6 };
+		//Scene of every step, with the swept parameter overwritten
+		StressSceneSettings scene{};
+		BenchmarkSettings benchmark{ "Stress", "", 20, 2 };
+		std::string outputPath{ "sweep.json" };
+	};
+
+	//Benchmarks the stress scene for a doubling scene parameter, to get frame time and memory scaling curves
+	class ScalingSweep final
+	{
+	public:
+		ScalingSweep(const SweepSettings& settings);
+		~ScalingSweep() = default;
+
+		ScalingSweep(const ScalingSweep&) = delete;
+		ScalingSweep(ScalingSweep&&) noexcept = delete;
+		ScalingSweep& operator=(const ScalingSweep&) = delete;
+		ScalingSweep& operator=(ScalingSweep&&) noexcept = delete;
+
+		void Run(Renderer* pRenderer, Timer* pTimer);
+
+		void PrintSummary() const;
+		bool WriteJson(const Renderer* pRenderer) const;
+
+		static const char* GetParameterName(SweepParameter parameter);
+
+	private:
+		struct StepResult
+		{
+			uint32_t value{};
+			uint64_t numTriangles{};
+			size_t geometryBytes{};
+			//Resident memory of the process after the step, 0 when unknown on this platform
+			size_t processBytes{};
+			float meanFrameTime{};
+			float p50FrameTime{};
+			float p95FrameTime{};
+			float raysPerSecond{};
+		};
+
+		SweepSettings m_Settings{};
+		std::vector<StepResult> m_Results{};
+	};
+
+	struct ThreadScalingSettings
+	{
+		std::string sceneName{ "W4_Reference" };
+		//Highest thread count, 0 uses the hardware concurrency
+		uint32_t maxThreads{ 0 };
+		bool pinThreads{ true };
+		BenchmarkSettings benchmark{ "", "", 60, 5 };
+		std::string outputPath{ "scaling.json" };
+	};
+
+	//Runs the benchmark on the ThreadPool with 1, 2, 4 ... maxThreads threads and reports speedup, efficiency and the busy time of every thread
+	class ThreadScalingBenchmark final
+	{
+	public:
+		ThreadScalingBenchmark(const ThreadScalingSettings& settings);
+		~ThreadScalingBenchmark() = default;
+
+		ThreadScalingBenchmark(const ThreadScalingBenchmark&) = delete;
+		ThreadScalingBenchmark(ThreadScalingBenchmark&&) noexcept = delete;
+		ThreadScalingBenchmark& operator=(const ThreadScalingBenchmark&) = delete;
+		ThreadScalingBenchmark& operator=(ThreadScalingBenchmark&&) noexcept = delete;
+
+		/**
+		 * \brief Renders a fresh copy of the scene for every thread count, changes the execution backend of the renderer
+		 * \return false when the scene name is unknown
+		 */
+		bool Run(Renderer* pRenderer, Timer* pTimer);
+
+		void PrintSummary() const;
+		bool WriteJson() const;
+
+	private:
+		struct StepResult
+		{
+			uint32_t numThreads{};
+			float meanFrameTime{};
+			float p50FrameTime{};
+			float p95FrameTime{};
+			float speedup{};
+			float efficiency{};
+			//Wall time of the whole run, warmup included (ms)
+			float wallTime{};
+			//Time every thread spent in jobs (ms), index 0 is the main thread
+			std::vector<float> busyTimes{};
+			uint64_t imageHash{};
+		};
+
+		ThreadScalingSettings m_Settings{};
+		std::vector<StepResult> m_Results{};
+	};
+}
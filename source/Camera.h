@@ -35,6 +35,9 @@ namespace dae
 		bool isLeftHeld{ false };
 		bool isRightHeld{ false };
 
+		//Disabled for scripted cameras, Update then only rebuilds the orientation from totalPitch/totalYaw
+		bool isInputEnabled{ true };
+
 		Matrix cameraToWorld{};
 
 
@@ -52,8 +55,21 @@ namespace dae
 			return Matrix { right4, up4, forward4, position };
 		}
 
+		void UpdateForward()
+		{
+			Matrix finalRot{ Matrix::CreateRotation(totalYaw, totalPitch, 1) };
+			forward = finalRot.TransformVector(Vector3::UnitZ);
+			forward.Normalize();
+		}
+
 		void Update(Timer* pTimer)
 		{
+			if (!isInputEnabled)
+			{
+				UpdateForward();
+				return;
+			}
+
 			const float deltaTime = pTimer->GetElapsed();
 
 			//Mouse Input
@@ -79,7 +95,6 @@ namespace dae
 
 			//reset totalPitch to 0 degrees if it reaches a full spin(360 deg)
 			if (totalPitch > 350 || totalPitch < -360) totalPitch = 0;
-			Matrix finalRot{ Matrix::CreateRotation(totalYaw, totalPitch, 1) };
 
 			//Keyboard Input
 			const uint8_t* pKeyboardState = SDL_GetKeyboardState(nullptr);
@@ -100,8 +115,7 @@ namespace dae
 			totalPitch > 159.f || totalPitch < -159.f ? origin += pKeyboardState[SDL_SCANCODE_LEFT] * sideSpeed : origin -= pKeyboardState[SDL_SCANCODE_LEFT] * sideSpeed;
 
 
-			forward = finalRot.TransformVector(Vector3::UnitZ);
-			forward.Normalize();
+			UpdateForward();
 		}
 	};
 }
@@ -0,0 +1,315 @@
+#include "Checkpoint.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <type_traits>
+
+#include "Deflate.h"
+#include "Profiler.h"
+
+namespace dae {
+	namespace
+	{
+		//Values are stored as they are in memory, little-endian on every platform the renderer builds for
+		constexpr char Magic[4]{ 'R', 'T', 'C', 'K' };
+		constexpr uint32_t Version{ 3 };
+		//Accumulated, albedo, normal and depth
+		constexpr size_t PixelSize{ sizeof(ColorRGB) * 2 + sizeof(Vector3) + sizeof(float) };
+
+		template<typename T>
+		void Append(std::vector<uint8_t>& file, const T* pValues, size_t count)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			const uint8_t* const pBytes{ reinterpret_cast<const uint8_t*>(pValues) };
+			file.insert(file.end(), pBytes, pBytes + sizeof(T) * count);
+		}
+
+		template<typename T>
+		void Append(std::vector<uint8_t>& file, const T& value)
+		{
+			Append(file, &value, 1);
+		}
+
+		/**
+		 * \brief Appends the values with their bytes split into planes, byte b of every 32 bit word goes to plane b.
+		 * Neighbouring pixels mostly share the sign and exponent bytes of their floats, which deflate only finds once they are next to each other
+		 */
+		template<typename T>
+		void AppendShuffled(std::vector<uint8_t>& payload, const T* pValues, size_t count)
+		{
+			static_assert(std::is_trivially_copyable_v<T> && sizeof(T) % sizeof(uint32_t) == 0);
+			const uint8_t* const pBytes{ reinterpret_cast<const uint8_t*>(pValues) };
+			const size_t numWords{ count * sizeof(T) / sizeof(uint32_t) };
+			const size_t offset{ payload.size() };
+			payload.resize(offset + numWords * sizeof(uint32_t));
+			for (size_t plane{ 0 }; plane < sizeof(uint32_t); ++plane)
+			{
+				uint8_t* const pPlane{ payload.data() + offset + plane * numWords };
+				for (size_t word{ 0 }; word < numWords; ++word)
+				{
+					pPlane[word] = pBytes[word * sizeof(uint32_t) + plane];
+				}
+			}
+		}
+
+		//Undoes AppendShuffled, returns the bytes after the values
+		template<typename T>
+		const uint8_t* ReadShuffled(const uint8_t* pPayload, T* pValues, size_t count)
+		{
+			static_assert(std::is_trivially_copyable_v<T> && sizeof(T) % sizeof(uint32_t) == 0);
+			uint8_t* const pBytes{ reinterpret_cast<uint8_t*>(pValues) };
+			const size_t numWords{ count * sizeof(T) / sizeof(uint32_t) };
+			for (size_t plane{ 0 }; plane < sizeof(uint32_t); ++plane)
+			{
+				const uint8_t* const pPlane{ pPayload + plane * numWords };
+				for (size_t word{ 0 }; word < numWords; ++word)
+				{
+					pBytes[word * sizeof(uint32_t) + plane] = pPlane[word];
+				}
+			}
+			return pPayload + numWords * sizeof(uint32_t);
+		}
+
+		//Reads values back in the order Append wrote them, fails instead of reading past the end
+		class ByteReader final
+		{
+		public:
+			ByteReader(const uint8_t* pData, size_t size) :
+				m_pData(pData),
+				m_Size(size)
+			{
+			}
+
+			template<typename T>
+			bool Read(T* pValues, size_t count)
+			{
+				static_assert(std::is_trivially_copyable_v<T>);
+				const size_t numBytes{ sizeof(T) * count };
+				if (m_Size - m_Position < numBytes)
+					return false;
+
+				std::memcpy(pValues, m_pData + m_Position, numBytes);
+				m_Position += numBytes;
+				return true;
+			}
+
+			template<typename T>
+			bool Read(T& value)
+			{
+				return Read(&value, 1);
+			}
+
+			size_t GetPosition() const { return m_Position; }
+
+		private:
+			const uint8_t* m_pData{};
+			size_t m_Size{};
+			size_t m_Position{};
+		};
+	}
+
+	CheckpointWriter::CheckpointWriter(const std::string& path) :
+		m_Path(path)
+	{
+		m_Thread = std::thread{ &CheckpointWriter::WriteLoop, this };
+	}
+
+	CheckpointWriter::~CheckpointWriter()
+	{
+		{
+			const std::lock_guard lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_StateChanged.notify_all();
+		if (m_Thread.joinable())
+			m_Thread.join();
+	}
+
+	bool CheckpointWriter::Read(const std::string& path, RenderCheckpoint& checkpoint)
+	{
+		PROFILE_SCOPE("ReadCheckpoint");
+		std::ifstream stream{ path, std::ios::binary };
+		if (!stream)
+			return false;
+		const std::vector<uint8_t> file{ std::istreambuf_iterator<char>{ stream }, std::istreambuf_iterator<char>{} };
+
+		//The CRC of everything before it closes the file
+		uint32_t crc{};
+		if (file.size() < sizeof(Magic) + sizeof(crc))
+			return false;
+		const size_t dataSize{ file.size() - sizeof(crc) };
+		std::memcpy(&crc, file.data() + dataSize, sizeof(crc));
+		if (crc != Deflate::Crc32(file.data(), dataSize))
+			return false;
+
+		ByteReader reader{ file.data(), dataSize };
+		char magic[4]{};
+		uint32_t version{};
+		uint32_t nameSize{};
+		if (!reader.Read(magic, 4) || std::memcmp(magic, Magic, sizeof(Magic)) != 0 || !reader.Read(version) || version != Version
+			|| !reader.Read(nameSize) || nameSize > dataSize)
+			return false;
+
+		checkpoint.sceneName.resize(nameSize);
+		float cameraToWorld[16]{};
+		//Read as a byte, any other value than 0 or 1 in a bool is undefined
+		uint8_t areShadowsEnabled{};
+		const bool isHeaderRead{ reader.Read(checkpoint.sceneName.data(), nameSize) && reader.Read(checkpoint.frameIndex)
+			&& reader.Read(checkpoint.width) && reader.Read(checkpoint.height) && reader.Read(checkpoint.seed)
+			&& reader.Read(checkpoint.accumulatedSamples) && reader.Read(checkpoint.pixelSubset) && reader.Read(checkpoint.lightingMode)
+			&& reader.Read(areShadowsEnabled) && reader.Read(cameraToWorld, 16) && reader.Read(checkpoint.fov)
+			&& reader.Read(checkpoint.geometryHash) };
+		if (!isHeaderRead || checkpoint.width <= 0 || checkpoint.height <= 0 || checkpoint.pixelSubset >= RenderCheckpoint::NumPixelSubsets
+			|| checkpoint.lightingMode >= RenderCheckpoint::NumLightingModes || areShadowsEnabled > 1)
+			return false;
+		checkpoint.areShadowsEnabled = areShadowsEnabled != 0;
+
+		for (int row{ 0 }; row < 4; ++row)
+		{
+			checkpoint.cameraToWorld[row] = { cameraToWorld[row * 4], cameraToWorld[row * 4 + 1], cameraToWorld[row * 4 + 2], cameraToWorld[row * 4 + 3] };
+		}
+
+		//The deflated pixels fill the rest of the file. Checked against what that many bytes can hold before the buffers are sized,
+		//so a corrupt size can't allocate much more than the file could decompress to
+		const size_t numPixels{ static_cast<size_t>(checkpoint.width) * checkpoint.height };
+		const size_t compressedSize{ dataSize - reader.GetPosition() };
+		if (numPixels > compressedSize * Deflate::MaxRatio / PixelSize)
+			return false;
+
+		std::vector<uint8_t> payload(numPixels * PixelSize);
+		if (!Deflate::DecompressZlib(file.data() + reader.GetPosition(), compressedSize, payload.data(), payload.size()))
+			return false;
+
+		checkpoint.accumulation.resize(numPixels);
+		checkpoint.albedo.resize(numPixels);
+		checkpoint.normals.resize(numPixels);
+		checkpoint.depths.resize(numPixels);
+		const uint8_t* pPayload{ payload.data() };
+		pPayload = ReadShuffled(pPayload, checkpoint.accumulation.data(), numPixels);
+		pPayload = ReadShuffled(pPayload, checkpoint.albedo.data(), numPixels);
+		pPayload = ReadShuffled(pPayload, checkpoint.normals.data(), numPixels);
+		ReadShuffled(pPayload, checkpoint.depths.data(), numPixels);
+		return true;
+	}
+
+	bool CheckpointWriter::IsIdle() const
+	{
+		const std::lock_guard lock{ m_Mutex };
+		return !m_IsWriting;
+	}
+
+	void CheckpointWriter::Write(RenderCheckpoint& checkpoint)
+	{
+		{
+			std::unique_lock lock{ m_Mutex };
+			m_StateChanged.wait(lock, [this] { return !m_IsWriting; });
+			std::swap(m_Checkpoint, checkpoint);
+			m_IsWriting = true;
+		}
+		m_StateChanged.notify_all();
+	}
+
+	void CheckpointWriter::Flush()
+	{
+		std::unique_lock lock{ m_Mutex };
+		m_StateChanged.wait(lock, [this] { return !m_IsWriting; });
+	}
+
+	uint32_t CheckpointWriter::GetNumSaved() const
+	{
+		const std::lock_guard lock{ m_Mutex };
+		return m_NumSaved;
+	}
+
+	uint32_t CheckpointWriter::GetNumFailed() const
+	{
+		const std::lock_guard lock{ m_Mutex };
+		return m_NumFailed;
+	}
+
+	void CheckpointWriter::WriteLoop()
+	{
+		Profiler::SetThreadName("CheckpointWriter");
+		while (true)
+		{
+			{
+				//The queued checkpoint is still written after Stop
+				std::unique_lock lock{ m_Mutex };
+				m_StateChanged.wait(lock, [this] { return m_IsWriting || m_IsStopping; });
+				if (!m_IsWriting)
+					return;
+			}
+
+			const bool isSaved{ WriteFile() };
+			{
+				const std::lock_guard lock{ m_Mutex };
+				++(isSaved ? m_NumSaved : m_NumFailed);
+				m_IsWriting = false;
+			}
+			m_StateChanged.notify_all();
+		}
+	}
+
+	bool CheckpointWriter::WriteFile()
+	{
+		PROFILE_SCOPE("WriteCheckpoint");
+		const RenderCheckpoint& checkpoint{ m_Checkpoint };
+		const size_t numPixels{ static_cast<size_t>(checkpoint.width) * checkpoint.height };
+		if (checkpoint.accumulation.size() != numPixels || checkpoint.albedo.size() != numPixels
+			|| checkpoint.normals.size() != numPixels || checkpoint.depths.size() != numPixels)
+			return false;
+
+		float cameraToWorld[16]{};
+		for (int row{ 0 }; row < 4; ++row)
+		{
+			for (int column{ 0 }; column < 4; ++column)
+			{
+				cameraToWorld[row * 4 + column] = checkpoint.cameraToWorld[row][column];
+			}
+		}
+
+		//Cleared, not freed, so the buffers are reused by the next checkpoint
+		std::vector<uint8_t>& payload{ m_Payload };
+		payload.clear();
+		AppendShuffled(payload, checkpoint.accumulation.data(), numPixels);
+		AppendShuffled(payload, checkpoint.albedo.data(), numPixels);
+		AppendShuffled(payload, checkpoint.normals.data(), numPixels);
+		AppendShuffled(payload, checkpoint.depths.data(), numPixels);
+
+		std::vector<uint8_t>& file{ m_File };
+		file.clear();
+		Append(file, Magic, sizeof(Magic));
+		Append(file, Version);
+		Append(file, static_cast<uint32_t>(checkpoint.sceneName.size()));
+		Append(file, checkpoint.sceneName.data(), checkpoint.sceneName.size());
+		Append(file, checkpoint.frameIndex);
+		Append(file, checkpoint.width);
+		Append(file, checkpoint.height);
+		Append(file, checkpoint.seed);
+		Append(file, checkpoint.accumulatedSamples);
+		Append(file, checkpoint.pixelSubset);
+		Append(file, checkpoint.lightingMode);
+		Append(file, static_cast<uint8_t>(checkpoint.areShadowsEnabled));
+		Append(file, cameraToWorld, 16);
+		Append(file, checkpoint.fov);
+		Append(file, checkpoint.geometryHash);
+		Deflate::CompressZlib(payload.data(), payload.size(), file);
+		Append(file, Deflate::Crc32(file.data(), file.size()));
+
+		//Replaces the last checkpoint only once the new one is complete
+		const std::string temporaryPath{ m_Path + ".tmp" };
+		{
+			std::ofstream stream{ temporaryPath, std::ios::binary };
+			stream.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+			stream.close();
+			if (!stream)
+				return false;
+		}
+
+		std::error_code error{};
+		std::filesystem::rename(temporaryPath, m_Path, error);
+		return !error;
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Math.h"
+#include "ColorRGB.h"
+
+namespace dae
+{
+	//State of a progressive render, enough to continue it in another process. See Renderer::GetCheckpoint
+	struct RenderCheckpoint
+	{
+		//Values of PixelSubset and of the lighting modes of the renderer, a checkpoint holding any other is rejected
+		static constexpr uint8_t NumPixelSubsets{ 3 };
+		static constexpr uint8_t NumLightingModes{ 5 };
+
+		//Filled in by the caller, a checkpoint is only resumed in the scene it was taken in
+		std::string sceneName{};
+		uint64_t frameIndex{};
+
+		int width{};
+		int height{};
+		//Sample i of every pixel is seeded with seed + i, so these two are the whole random state
+		uint32_t seed{};
+		uint32_t accumulatedSamples{};
+		uint8_t pixelSubset{};
+		uint8_t lightingMode{};
+		bool areShadowsEnabled{};
+		//View the samples were traced with, accumulation restarts if the resumed render doesn't match it
+		Matrix cameraToWorld{};
+		float fov{};
+		//Scene::GetContentHash of the geometry the samples were traced with, a checkpoint is only restored into the same content
+		uint64_t geometryHash{};
+
+		//Sum of the samples of every pixel, and the guides of its first sample that the denoiser and the pixel fill read
+		std::vector<ColorRGB> accumulation{};
+		std::vector<ColorRGB> albedo{};
+		std::vector<Vector3> normals{};
+		std::vector<float> depths{};
+	};
+
+	/**
+	 * \brief Saves checkpoints on a thread of its own, so a long render keeps tracing while they are written.
+	 * A checkpoint goes to a temporary file first and then replaces the last one, so a job killed halfway
+	 * through a write still leaves the previous checkpoint behind. The pixel buffers are deflated, the header isn't.
+	 */
+	class CheckpointWriter final
+	{
+	public:
+		explicit CheckpointWriter(const std::string& path);
+		//Finishes the checkpoint being written
+		~CheckpointWriter();
+
+		CheckpointWriter(const CheckpointWriter&) = delete;
+		CheckpointWriter(CheckpointWriter&&) noexcept = delete;
+		CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+		CheckpointWriter& operator=(CheckpointWriter&&) noexcept = delete;
+
+		/**
+		 * \brief Reads and verifies a checkpoint written by this class
+		 * \return false when the file is missing, truncated or corrupt, checkpoint is undefined then
+		 */
+		static bool Read(const std::string& path, RenderCheckpoint& checkpoint);
+
+		//False while a checkpoint is being written
+		bool IsIdle() const;
+		/**
+		 * \brief Queues the checkpoint and returns right away, waits first if the last one is still being written.
+		 * The checkpoint is swapped with the one written before, so its buffers are reused instead of allocated again
+		 */
+		void Write(RenderCheckpoint& checkpoint);
+		//Waits until the queued checkpoint was written
+		void Flush();
+
+		const std::string& GetPath() const { return m_Path; }
+		uint32_t GetNumSaved() const;
+		uint32_t GetNumFailed() const;
+
+	private:
+		void WriteLoop();
+		bool WriteFile();
+
+		std::string m_Path{};
+		//Only touched by the writer thread while m_IsWriting is set
+		RenderCheckpoint m_Checkpoint{};
+		std::vector<uint8_t> m_Payload{};
+		std::vector<uint8_t> m_File{};
+
+		mutable std::mutex m_Mutex{};
+		std::condition_variable m_StateChanged{};
+		//Guarded by m_Mutex
+		bool m_IsWriting{ false };
+		bool m_IsStopping{ false };
+		uint32_t m_NumSaved{};
+		uint32_t m_NumFailed{};
+
+		std::thread m_Thread{};
+	};
+}
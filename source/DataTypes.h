@@ -1,18 +1,23 @@
 #pragma once
 #include <cassert>
+#include <cstdint>
 
 #include "Math.h"
+#include "Profiler.h"
 #include "vector"
 
 namespace dae
 {
+	//Index into Scene::GetMaterials
+	using MaterialId = uint32_t;
+
 #pragma region GEOMETRY
 	struct Sphere
 	{
 		Vector3 origin{};
 		float radius{};
 
-		unsigned char materialIndex{ 0 };
+		MaterialId materialIndex{ 0 };
 	};
 
 	struct Plane
@@ -20,7 +25,7 @@ namespace dae
 		Vector3 origin{};
 		Vector3 normal{};
 
-		unsigned char materialIndex{ 0 };
+		MaterialId materialIndex{ 0 };
 	};
 
 	enum class TriangleCullMode
@@ -51,7 +56,7 @@ namespace dae
 		Vector3 normal{};
 
 		TriangleCullMode cullMode{};
-		unsigned char materialIndex{};
+		MaterialId materialIndex{};
 	};
 
 	struct TriangleMesh
@@ -76,7 +81,7 @@ namespace dae
 		std::vector<Vector3> positions{};
 		std::vector<Vector3> normals{};
 		std::vector<int> indices{};
-		unsigned char materialIndex{};
+		MaterialId materialIndex{};
 
 		TriangleCullMode cullMode{TriangleCullMode::BackFaceCulling};
 
@@ -94,19 +99,33 @@ namespace dae
 		std::vector<Vector3> transformedPositions{};
 		std::vector<Vector3> transformedNormals{};
 
+		//Set when a transform is pending or the vertices were edited, UpdateAABB and UpdateTransforms do nothing while it is clear
+		bool isDirty{ true };
+		//Increased every time the vertices change, caches built from the mesh compare it to know when to rebuild
+		uint32_t version{};
+
 		void Translate(const Vector3& translation)
 		{
 			translationTransform = Matrix::CreateTranslation(translation);
+			isDirty = true;
 		}
 
 		void RotateY(float yaw)
 		{
 			rotationTransform = Matrix::CreateRotationY(yaw);
+			isDirty = true;
 		}
 
 		void Scale(const Vector3& scale)
 		{
 			scaleTransform = Matrix::CreateScale(scale);
+			isDirty = true;
+		}
+
+		//Call after editing positions, normals or indices directly
+		void MarkDirty()
+		{
+			isDirty = true;
 		}
 
 		void AppendTriangle(const Triangle& triangle, bool ignoreTransformUpdate = false)
@@ -122,6 +141,7 @@ namespace dae
 			indices.push_back(++startIndex);
 
 			normals.push_back(triangle.normal);
+			isDirty = true;
 
 			//Not ideal, but making sure all vertices are updated
 			if(!ignoreTransformUpdate)
@@ -141,9 +161,9 @@ namespace dae
 			}
 		}
 
-		void UpdateTransforms()
+		//Combines the pending translate, rotate and scale into the transform for the vertices and clears them
+		Matrix ConsumePendingTransform()
 		{
-			//Calculate Final Transform
 			totalTranslation += translationTransform.GetTranslation();
 			Matrix totalTrans = Matrix::CreateTranslation(totalTranslation);
 			Matrix totalTransNegative = Matrix::CreateTranslation(-totalTranslation);
@@ -151,26 +171,39 @@ namespace dae
 			//bring the object back to its original position, apply the transform, then bring it back to the new position
 			const Matrix finalTransform{ totalTransNegative * scaleTransform * rotationTransform * translationTransform * totalTrans };
 
-			
-			for (int i{0}; i < positions.size(); i++)
-			{
-				positions[i] = finalTransform.TransformPoint(positions[i]);
-			}
-
-			for (int i{0}; i < normals.size(); i++)
-			{
-				normals[i] = finalTransform.TransformVector(normals[i]);
-			}
-
 			scaleTransform = Matrix{};
 			rotationTransform = Matrix{};
 			translationTransform = Matrix{};
+			return finalTransform;
+		}
+
+		void UpdateTransforms()
+		{
+			if (!isDirty)
+				return;
 
+			PROFILE_SCOPE("UpdateTransforms");
+			const Matrix finalTransform{ ConsumePendingTransform() };
+			finalTransform.TransformPoints(positions.data(), positions.data(), positions.size());
+			finalTransform.TransformVectors(normals.data(), normals.data(), normals.size());
+
+			FinishTransformUpdate(finalTransform);
+		}
+
+		//Last step of UpdateTransforms, for callers that transformed the vertices themselves
+		void FinishTransformUpdate(const Matrix& finalTransform)
+		{
 			UpdateTransformedAABB(finalTransform);
+			isDirty = false;
+			++version;
 		}
 
 		#pragma region AABB
 		void UpdateAABB() {
+			if (!isDirty)
+				return;
+
+			PROFILE_SCOPE("UpdateAABB");
 			size_t size{ positions.size() };
 			if (size > 0) {
 				minAABB = positions[0];
@@ -185,6 +218,7 @@ namespace dae
 		}
 
 		void UpdateTransformedAABB(const Matrix& finalTransform) {
+			PROFILE_SCOPE("UpdateTransformedAABB");
 			Vector3 tMinAABB{ finalTransform.TransformPoint(minAABB) };
 			Vector3 tMaxAABB{ tMinAABB };
 
@@ -256,7 +290,38 @@ namespace dae
 		float t = FLT_MAX;
 
 		bool didHit{ false };
-		unsigned char materialIndex{ 0 };
+		MaterialId materialIndex{ 0 };
+	};
+
+	//Convex volume, the points on the inner side of every plane (Dot(normal, p) >= distance). Without planes it holds everything
+	struct Frustum
+	{
+		static constexpr int MaxPlanes{ 6 };
+
+		Vector3 normals[MaxPlanes]{};
+		float distances[MaxPlanes]{};
+		int numPlanes{};
+
+		//normal points into the volume
+		void AddPlane(const Vector3& normal, const Vector3& point)
+		{
+			assert(numPlanes < MaxPlanes && "Too many frustum planes");
+			normals[numPlanes] = normal.Normalized();
+			distances[numPlanes] = Vector3::Dot(normals[numPlanes], point);
+			++numPlanes;
+		}
+
+		static Frustum FromBox(const Vector3& min, const Vector3& max)
+		{
+			Frustum frustum{};
+			frustum.AddPlane(Vector3::UnitX, min);
+			frustum.AddPlane(-Vector3::UnitX, max);
+			frustum.AddPlane(Vector3::UnitY, min);
+			frustum.AddPlane(-Vector3::UnitY, max);
+			frustum.AddPlane(Vector3::UnitZ, min);
+			frustum.AddPlane(-Vector3::UnitZ, max);
+			return frustum;
+		}
 	};
 #pragma endregion
 }
\ No newline at end of file
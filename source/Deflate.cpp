@@ -0,0 +1,482 @@
+#include "Deflate.h"
+
+#include <algorithm>
+
+#include "Executor.h"
+#include "Profiler.h"
+
+namespace dae {
+	namespace
+	{
+		constexpr int WindowSize{ 32 * 1024 };
+		constexpr int HashBits{ 15 };
+		constexpr int MinMatch{ 3 };
+		constexpr int MaxMatch{ 258 };
+		//Candidates compared per position, trades ratio for speed
+		constexpr int MaxChainLength{ 32 };
+
+		constexpr uint16_t LengthBase[29]{ 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		constexpr uint8_t LengthExtraBits[29]{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		constexpr uint16_t DistanceBase[30]{ 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		constexpr uint8_t DistanceExtraBits[30]{ 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		uint32_t ReverseBits(uint32_t code, int numBits)
+		{
+			uint32_t reversed{ 0 };
+			for (int i{ 0 }; i < numBits; ++i)
+			{
+				reversed = (reversed << 1) | ((code >> i) & 1);
+			}
+			return reversed;
+		}
+
+		//Fixed Huffman codes (RFC 1951, 3.2.6), bit reversed because deflate writes Huffman codes starting at their top bit
+		struct FixedCodes
+		{
+			uint16_t literalCodes[288]{};
+			uint8_t literalLengths[288]{};
+			uint16_t distanceCodes[30]{};
+			//Length code (257-285) of every match length
+			uint16_t lengthSymbols[MaxMatch + 1]{};
+
+			FixedCodes()
+			{
+				for (uint32_t symbol{ 0 }; symbol < 288; ++symbol)
+				{
+					uint32_t code{};
+					int numBits{};
+					if (symbol < 144) { code = 0x30 + symbol; numBits = 8; }
+					else if (symbol < 256) { code = 0x190 + symbol - 144; numBits = 9; }
+					else if (symbol < 280) { code = symbol - 256; numBits = 7; }
+					else { code = 0xc0 + symbol - 280; numBits = 8; }
+					literalCodes[symbol] = static_cast<uint16_t>(ReverseBits(code, numBits));
+					literalLengths[symbol] = static_cast<uint8_t>(numBits);
+				}
+				for (uint32_t symbol{ 0 }; symbol < 30; ++symbol)
+				{
+					distanceCodes[symbol] = static_cast<uint16_t>(ReverseBits(symbol, 5));
+				}
+				for (int code{ 0 }; code < 29; ++code)
+				{
+					const int lastLength{ code == 28 ? MaxMatch : LengthBase[code] + (1 << LengthExtraBits[code]) - 1 };
+					for (int length{ LengthBase[code] }; length <= lastLength; ++length)
+					{
+						lengthSymbols[length] = static_cast<uint16_t>(257 + code);
+					}
+				}
+			}
+		};
+
+		const FixedCodes& GetFixedCodes()
+		{
+			static const FixedCodes codes{};
+			return codes;
+		}
+
+		//Writes bits starting at the lowest bit of every byte, as deflate packs them
+		class BitWriter final
+		{
+		public:
+			explicit BitWriter(std::vector<uint8_t>& out) :
+				m_Out(out)
+			{
+			}
+
+			void Write(uint32_t value, int numBits)
+			{
+				m_Bits |= static_cast<uint64_t>(value) << m_NumBits;
+				m_NumBits += numBits;
+				while (m_NumBits >= 8)
+				{
+					m_Out.push_back(static_cast<uint8_t>(m_Bits));
+					m_Bits >>= 8;
+					m_NumBits -= 8;
+				}
+			}
+
+			void AlignToByte()
+			{
+				if (m_NumBits > 0)
+					Write(0, 8 - m_NumBits);
+			}
+
+		private:
+			std::vector<uint8_t>& m_Out;
+			uint64_t m_Bits{};
+			int m_NumBits{};
+		};
+
+		//Reads bits starting at the lowest bit of every byte, past the end it reads zeros and marks the stream as overrun
+		class BitReader final
+		{
+		public:
+			BitReader(const uint8_t* pData, size_t size) :
+				m_pData(pData),
+				m_Size(size)
+			{
+			}
+
+			uint32_t Read(int numBits)
+			{
+				uint32_t value{ 0 };
+				for (int i{ 0 }; i < numBits; ++i)
+				{
+					value |= ReadBit() << i;
+				}
+				return value;
+			}
+
+			//Huffman codes are packed starting at their top bit
+			uint32_t ReadCode(uint32_t code, int numBits)
+			{
+				for (int i{ 0 }; i < numBits; ++i)
+				{
+					code = (code << 1) | ReadBit();
+				}
+				return code;
+			}
+
+			void AlignToByte()
+			{
+				if (m_BitIndex > 0)
+				{
+					m_BitIndex = 0;
+					++m_Position;
+				}
+			}
+
+			//Only valid on a byte boundary
+			bool ReadBytes(uint8_t* pOut, size_t count)
+			{
+				if (m_Size - std::min(m_Position, m_Size) < count)
+				{
+					m_IsOverrun = true;
+					return false;
+				}
+				std::copy_n(m_pData + m_Position, count, pOut);
+				m_Position += count;
+				return true;
+			}
+
+			size_t GetPosition() const { return m_Position; }
+			bool IsOverrun() const { return m_IsOverrun; }
+
+		private:
+			uint32_t ReadBit()
+			{
+				if (m_Position >= m_Size)
+				{
+					m_IsOverrun = true;
+					return 0;
+				}
+				const uint32_t bit{ (m_pData[m_Position] >> m_BitIndex) & 1u };
+				if (++m_BitIndex == 8)
+				{
+					m_BitIndex = 0;
+					++m_Position;
+				}
+				return bit;
+			}
+
+			const uint8_t* m_pData{};
+			size_t m_Size{};
+			size_t m_Position{};
+			int m_BitIndex{};
+			bool m_IsOverrun{ false };
+		};
+
+		//Decodes a literal/length symbol of the fixed codes, the code lengths tell the symbol ranges apart
+		uint32_t ReadFixedSymbol(BitReader& reader)
+		{
+			const uint32_t code7{ reader.ReadCode(0, 7) };
+			if (code7 < 0x18)
+				return 256 + code7;
+			const uint32_t code8{ reader.ReadCode(code7, 1) };
+			if (code8 < 0xc0)
+				return code8 - 0x30;
+			if (code8 < 0xc8)
+				return 280 + code8 - 0xc0;
+			return 144 + reader.ReadCode(code8, 1) - 0x190;
+		}
+
+		uint32_t Hash(const uint8_t* p)
+		{
+			const uint32_t value{ static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) };
+			return (value * 2654435761u) >> (32 - HashBits);
+		}
+
+		//Hash chains of a stripe, reused by the thread so compressing doesn't allocate once they are big enough
+		struct MatchFinder
+		{
+			std::vector<int32_t> head{};
+			std::vector<int32_t> previous{};
+		};
+		thread_local MatchFinder t_MatchFinder{};
+
+		struct ZlibJob
+		{
+			const uint8_t* pData{};
+			size_t size{};
+			size_t stripeSize{};
+			std::vector<std::vector<uint8_t>>* pStripes{};
+		};
+	}
+
+	uint32_t Deflate::Crc32(const uint8_t* pData, size_t size, uint32_t crc)
+	{
+		static const auto table{ [] {
+			std::vector<uint32_t> values(256);
+			for (uint32_t i{ 0 }; i < 256; ++i)
+			{
+				uint32_t value{ i };
+				for (int bit{ 0 }; bit < 8; ++bit)
+				{
+					value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+				}
+				values[i] = value;
+			}
+			return values;
+		}() };
+
+		crc = ~crc;
+		for (size_t i{ 0 }; i < size; ++i)
+		{
+			crc = table[(crc ^ pData[i]) & 0xff] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	uint32_t Deflate::Adler32(const uint8_t* pData, size_t size, uint32_t adler)
+	{
+		//Largest block whose sums can't overflow before the modulo
+		constexpr size_t BlockSize{ 5552 };
+		constexpr uint32_t Modulo{ 65521 };
+
+		uint32_t a{ adler & 0xffff };
+		uint32_t b{ adler >> 16 };
+		while (size > 0)
+		{
+			const size_t blockSize{ std::min(size, BlockSize) };
+			for (size_t i{ 0 }; i < blockSize; ++i)
+			{
+				a += pData[i];
+				b += a;
+			}
+			a %= Modulo;
+			b %= Modulo;
+			pData += blockSize;
+			size -= blockSize;
+		}
+		return (b << 16) | a;
+	}
+
+	void Deflate::CompressStripe(const uint8_t* pData, size_t size, bool isLast, std::vector<uint8_t>& out)
+	{
+		const FixedCodes& codes{ GetFixedCodes() };
+		BitWriter writer{ out };
+
+		//A single block with the fixed codes
+		writer.Write(isLast ? 1 : 0, 1);
+		writer.Write(1, 2);
+
+		MatchFinder& finder{ t_MatchFinder };
+		finder.head.assign(size_t{ 1 } << HashBits, -1);
+		if (finder.previous.size() < size)
+			finder.previous.resize(size);
+
+		const int numBytes{ static_cast<int>(size) };
+		const auto insert{ [&finder, pData, numBytes](int position) {
+			if (position + MinMatch > numBytes)
+				return;
+			const uint32_t hash{ Hash(pData + position) };
+			finder.previous[position] = finder.head[hash];
+			finder.head[hash] = position;
+		} };
+
+		for (int position{ 0 }; position < numBytes;)
+		{
+			int bestLength{ 0 };
+			int bestDistance{ 0 };
+			if (position + MinMatch <= numBytes)
+			{
+				const int maxLength{ std::min(MaxMatch, numBytes - position) };
+				int candidate{ finder.head[Hash(pData + position)] };
+				for (int chain{ 0 }; candidate >= 0 && position - candidate <= WindowSize && chain < MaxChainLength; ++chain)
+				{
+					int length{ 0 };
+					while (length < maxLength && pData[candidate + length] == pData[position + length])
+					{
+						++length;
+					}
+					if (length > bestLength)
+					{
+						bestLength = length;
+						bestDistance = position - candidate;
+						if (length == maxLength)
+							break;
+					}
+					candidate = finder.previous[candidate];
+				}
+			}
+
+			if (bestLength < MinMatch)
+			{
+				writer.Write(codes.literalCodes[pData[position]], codes.literalLengths[pData[position]]);
+				insert(position);
+				++position;
+				continue;
+			}
+
+			const uint16_t lengthSymbol{ codes.lengthSymbols[bestLength] };
+			const int lengthCode{ lengthSymbol - 257 };
+			writer.Write(codes.literalCodes[lengthSymbol], codes.literalLengths[lengthSymbol]);
+			writer.Write(static_cast<uint32_t>(bestLength - LengthBase[lengthCode]), LengthExtraBits[lengthCode]);
+
+			int distanceCode{ 29 };
+			while (DistanceBase[distanceCode] > bestDistance)
+			{
+				--distanceCode;
+			}
+			writer.Write(codes.distanceCodes[distanceCode], 5);
+			writer.Write(static_cast<uint32_t>(bestDistance - DistanceBase[distanceCode]), DistanceExtraBits[distanceCode]);
+
+			for (int i{ 0 }; i < bestLength; ++i)
+			{
+				insert(position + i);
+			}
+			position += bestLength;
+		}
+
+		//End of block
+		writer.Write(codes.literalCodes[256], codes.literalLengths[256]);
+
+		//An empty stored block aligns the stripe to a byte, like a zlib sync flush
+		if (!isLast)
+		{
+			writer.Write(0, 3);
+			writer.AlignToByte();
+			out.insert(out.end(), { 0x00, 0x00, 0xff, 0xff });
+		}
+		writer.AlignToByte();
+	}
+
+	void Deflate::CompressZlib(const uint8_t* pData, size_t size, std::vector<uint8_t>& out, Executor* pExecutor, size_t stripeSize)
+	{
+		PROFILE_SCOPE("CompressZlib");
+		const size_t numStripes{ std::max<size_t>((size + stripeSize - 1) / stripeSize, 1) };
+		std::vector<std::vector<uint8_t>> stripes(numStripes);
+
+		ZlibJob job{ pData, size, stripeSize, &stripes };
+		const auto compressStripe{ [&job](uint32_t stripeIndex) {
+			const size_t first{ stripeIndex * job.stripeSize };
+			const size_t stripeSize{ std::min(job.stripeSize, job.size - std::min(first, job.size)) };
+			const bool isLast{ stripeIndex + 1 == job.pStripes->size() };
+			CompressStripe(job.pData + first, stripeSize, isLast, (*job.pStripes)[stripeIndex]);
+		} };
+		if (pExecutor)
+		{
+			pExecutor->ParallelFor(static_cast<uint32_t>(numStripes), compressStripe);
+		}
+		else
+		{
+			for (uint32_t i{ 0 }; i < numStripes; ++i)
+			{
+				compressStripe(i);
+			}
+		}
+
+		//Deflate with a 32K window, no preset dictionary, the fastest compression level
+		out.push_back(0x78);
+		out.push_back(0x01);
+		for (const std::vector<uint8_t>& stripe : stripes)
+		{
+			out.insert(out.end(), stripe.begin(), stripe.end());
+		}
+
+		const uint32_t adler{ Adler32(pData, size) };
+		for (int shift{ 24 }; shift >= 0; shift -= 8)
+		{
+			out.push_back(static_cast<uint8_t>(adler >> shift));
+		}
+	}
+
+	bool Deflate::DecompressZlib(const uint8_t* pData, size_t size, uint8_t* pOut, size_t outSize)
+	{
+		PROFILE_SCOPE("DecompressZlib");
+		//Deflate with a window of at most 32K and no preset dictionary
+		constexpr size_t AdlerSize{ 4 };
+		if (size < 2 + AdlerSize || (pData[0] & 0x0f) != 8 || (pData[0] >> 4) > 7 || (pData[1] & 0x20) != 0
+			|| ((pData[0] << 8) | pData[1]) % 31 != 0)
+			return false;
+
+		BitReader reader{ pData + 2, size - 2 - AdlerSize };
+		size_t written{ 0 };
+		bool isLast{ false };
+		while (!isLast)
+		{
+			isLast = reader.Read(1) != 0;
+			const uint32_t blockType{ reader.Read(2) };
+			if (reader.IsOverrun())
+				return false;
+
+			if (blockType == 0)
+			{
+				reader.AlignToByte();
+				uint8_t lengths[4]{};
+				if (!reader.ReadBytes(lengths, 4))
+					return false;
+				const uint32_t length{ lengths[0] | (static_cast<uint32_t>(lengths[1]) << 8) };
+				const uint32_t lengthComplement{ lengths[2] | (static_cast<uint32_t>(lengths[3]) << 8) };
+				if ((length ^ 0xffff) != lengthComplement || outSize - written < length || !reader.ReadBytes(pOut + written, length))
+					return false;
+				written += length;
+				continue;
+			}
+			if (blockType != 1)
+				return false;
+
+			while (true)
+			{
+				const uint32_t symbol{ ReadFixedSymbol(reader) };
+				if (reader.IsOverrun())
+					return false;
+				if (symbol < 256)
+				{
+					if (written == outSize)
+						return false;
+					pOut[written++] = static_cast<uint8_t>(symbol);
+					continue;
+				}
+				if (symbol == 256)
+					break;
+
+				//Symbols 286 and 287 and distance codes 30 and 31 don't occur in valid data
+				const uint32_t lengthCode{ symbol - 257 };
+				if (lengthCode >= 29)
+					return false;
+				const size_t length{ LengthBase[lengthCode] + reader.Read(LengthExtraBits[lengthCode]) };
+				const uint32_t distanceCode{ reader.ReadCode(0, 5) };
+				if (distanceCode >= 30)
+					return false;
+				const size_t distance{ DistanceBase[distanceCode] + reader.Read(DistanceExtraBits[distanceCode]) };
+				if (reader.IsOverrun() || distance > written || outSize - written < length)
+					return false;
+
+				//Byte by byte, a match may overlap the bytes it copies
+				for (size_t i{ 0 }; i < length; ++i, ++written)
+				{
+					pOut[written] = pOut[written - distance];
+				}
+			}
+		}
+
+		//Nothing but the checksum may follow the last block
+		reader.AlignToByte();
+		if (written != outSize || reader.GetPosition() != size - 2 - AdlerSize)
+			return false;
+		const uint8_t* const pAdler{ pData + size - AdlerSize };
+		const uint32_t adler{ (static_cast<uint32_t>(pAdler[0]) << 24) | (static_cast<uint32_t>(pAdler[1]) << 16)
+			| (static_cast<uint32_t>(pAdler[2]) << 8) | pAdler[3] };
+		return adler == Adler32(pOut, outSize);
+	}
+}
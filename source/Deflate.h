@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dae
+{
+	class Executor;
+
+	//Minimal deflate (RFC 1951) encoder for the image writers and checkpoints: LZ77 with fixed Huffman codes, no dependencies
+	namespace Deflate
+	{
+		constexpr size_t DefaultStripeSize{ 64 * 1024 };
+		//Most bytes a single deflate bit can stand for, bounds what a stream of a given size can decompress to
+		constexpr size_t MaxRatio{ 1032 };
+
+		uint32_t Crc32(const uint8_t* pData, size_t size, uint32_t crc = 0);
+		uint32_t Adler32(const uint8_t* pData, size_t size, uint32_t adler = 1);
+
+		/**
+		 * \brief Appends the raw deflate data of one stripe to out. Stripes don't reference each other and end on a byte boundary,
+		 * so stripes compressed in parallel can be concatenated into a single stream
+		 * \param isLast Ends the stream, only the last stripe may set it
+		 */
+		void CompressStripe(const uint8_t* pData, size_t size, bool isLast, std::vector<uint8_t>& out);
+
+		/**
+		 * \brief Appends a zlib stream (RFC 1950) of the data to out
+		 * \param pExecutor Compresses the stripes in parallel, nullptr compresses them on the calling thread
+		 */
+		void CompressZlib(const uint8_t* pData, size_t size, std::vector<uint8_t>& out, Executor* pExecutor = nullptr, size_t stripeSize = DefaultStripeSize);
+
+		/**
+		 * \brief Decompresses a zlib stream written by CompressZlib, only stored and fixed Huffman blocks are read
+		 * \param pOut Receives exactly outSize bytes, a stream holding more or less is rejected
+		 * \return false when the stream is corrupt, uses dynamic Huffman blocks or fails its checksum
+		 */
+		bool DecompressZlib(const uint8_t* pData, size_t size, uint8_t* pOut, size_t outSize);
+	}
+}
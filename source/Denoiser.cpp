@@ -0,0 +1,133 @@
+#include "Denoiser.h"
+
+#include <cmath>
+
+#include "Utils.h"
+
+namespace dae {
+	namespace
+	{
+		//B3 spline kernel
+		constexpr float Kernel[5]{ 1.f / 16.f, 1.f / 4.f, 3.f / 8.f, 1.f / 4.f, 1.f / 16.f };
+		constexpr float MinAlbedo{ 0.001f };
+
+		float Luminance(const ColorRGB& color)
+		{
+			return 0.2126f * color.r + 0.7152f * color.g + 0.0722f * color.b;
+		}
+
+		ColorRGB ClampAlbedo(const ColorRGB& albedo)
+		{
+			return { std::max(albedo.r, MinAlbedo), std::max(albedo.g, MinAlbedo), std::max(albedo.b, MinAlbedo) };
+		}
+	}
+
+	Denoiser::Denoiser(int tileSize) :
+		m_TileSize(tileSize)
+	{
+	}
+
+	void Denoiser::Resize(int width, int height)
+	{
+		m_Width = width;
+		m_Height = height;
+
+		m_Buffers[0].resize(static_cast<size_t>(width) * height);
+		m_Buffers[1].resize(static_cast<size_t>(width) * height);
+	}
+
+	void Denoiser::SetGuides(const ColorRGB* pAlbedo, const Vector3* pNormal, const float* pDepth)
+	{
+		m_pAlbedo = pAlbedo;
+		m_pNormal = pNormal;
+		m_pDepth = pDepth;
+	}
+
+	void Denoiser::DemodulateTile(const ColorRGB* pColor, float colorScale, uint32_t tileIndex)
+	{
+		const TileUtils::TileRect tile{ TileUtils::GetTileRect(tileIndex, m_Width, m_Height, m_TileSize) };
+
+		for (int y{ tile.y }; y < tile.y + tile.height; ++y)
+		{
+			for (int x{ tile.x }; x < tile.x + tile.width; ++x)
+			{
+				const int pixelIndex{ x + y * m_Width };
+				const ColorRGB color{ pColor[pixelIndex] * colorScale };
+				const ColorRGB albedo{ ClampAlbedo(m_pAlbedo[pixelIndex]) };
+
+				m_Buffers[0][pixelIndex] = { color.r / albedo.r, color.g / albedo.g, color.b / albedo.b };
+			}
+		}
+	}
+
+	void Denoiser::FilterTile(int pass, uint32_t tileIndex)
+	{
+		const TileUtils::TileRect tile{ TileUtils::GetTileRect(tileIndex, m_Width, m_Height, m_TileSize) };
+
+		const std::vector<ColorRGB>& source{ m_Buffers[pass % 2] };
+		std::vector<ColorRGB>& destination{ m_Buffers[(pass + 1) % 2] };
+
+		const int step{ 1 << pass };
+		//Color tolerance shrinks every pass, the coarse passes should only smooth what is left of the noise
+		const float colorPhi{ m_ColorPhi / static_cast<float>(step) };
+		const float depthPhi{ m_DepthPhi * static_cast<float>(step) };
+
+		for (int y{ tile.y }; y < tile.y + tile.height; ++y)
+		{
+			for (int x{ tile.x }; x < tile.x + tile.width; ++x)
+			{
+				const int pixelIndex{ x + y * m_Width };
+				const ColorRGB& centerColor{ source[pixelIndex] };
+				const Vector3& centerNormal{ m_pNormal[pixelIndex] };
+				const float centerDepth{ m_pDepth[pixelIndex] };
+				const float centerLuminance{ Luminance(centerColor) };
+
+				ColorRGB colorSum{};
+				float weightSum{};
+
+				for (int ky{ -2 }; ky <= 2; ++ky)
+				{
+					const int sampleY{ y + ky * step };
+					if (sampleY < 0 || sampleY >= m_Height) {
+						continue;
+					}
+
+					for (int kx{ -2 }; kx <= 2; ++kx)
+					{
+						const int sampleX{ x + kx * step };
+						if (sampleX < 0 || sampleX >= m_Width) {
+							continue;
+						}
+
+						const int sampleIndex{ sampleX + sampleY * m_Width };
+						const ColorRGB& sampleColor{ source[sampleIndex] };
+
+						float weight{ Kernel[kx + 2] * Kernel[ky + 2] };
+						if (sampleIndex != pixelIndex)
+						{
+							const float normalWeight{ powf(std::max(0.f, Vector3::Dot(centerNormal, m_pNormal[sampleIndex])), m_NormalPhi) };
+							const float depthWeight{ expf(-std::abs(centerDepth - m_pDepth[sampleIndex]) / depthPhi) };
+							const float colorWeight{ expf(-std::abs(centerLuminance - Luminance(sampleColor)) / colorPhi) };
+							weight *= normalWeight * depthWeight * colorWeight;
+						}
+
+						colorSum += sampleColor * weight;
+						weightSum += weight;
+					}
+				}
+
+				destination[pixelIndex] = colorSum * (1.f / weightSum);
+			}
+		}
+	}
+
+	ColorRGB Denoiser::GetPixel(int pixelIndex) const
+	{
+		return m_Buffers[m_NumPasses % 2][pixelIndex] * ClampAlbedo(m_pAlbedo[pixelIndex]);
+	}
+
+	uint32_t Denoiser::GetNumTiles() const
+	{
+		return TileUtils::GetNumTiles(m_Width, m_Height, m_TileSize);
+	}
+}
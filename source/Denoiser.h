@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	//Edge-aware a-trous wavelet denoiser, guided by the albedo, normal and depth of the first hit.
+	//Every pass is split in screen tiles so it can run on the same workers as the renderer.
+	class Denoiser final
+	{
+	public:
+		Denoiser(int tileSize);
+		~Denoiser() = default;
+
+		Denoiser(const Denoiser&) = delete;
+		Denoiser(Denoiser&&) noexcept = delete;
+		Denoiser& operator=(const Denoiser&) = delete;
+		Denoiser& operator=(Denoiser&&) noexcept = delete;
+
+		void Resize(int width, int height);
+		void SetGuides(const ColorRGB* pAlbedo, const Vector3* pNormal, const float* pDepth);
+
+		/**
+		 * \brief Divides the albedo out of the noisy color, so texture detail is not blurred by the filter
+		 * \param pColor Noisy color buffer (e.g. accumulated samples)
+		 * \param colorScale Scale applied to every color (e.g. 1 / sample count)
+		 */
+		void DemodulateTile(const ColorRGB* pColor, float colorScale, uint32_t tileIndex);
+
+		//Runs a-trous pass 'pass' (step size 2^pass) over one tile, passes have to be run in order
+		void FilterTile(int pass, uint32_t tileIndex);
+
+		//Filtered color of a pixel, with the albedo applied again
+		ColorRGB GetPixel(int pixelIndex) const;
+
+		uint32_t GetNumTiles() const;
+		int GetNumPasses() const { return m_NumPasses; }
+
+	private:
+		int m_TileSize{};
+		int m_Width{};
+		int m_Height{};
+
+		int m_NumPasses{ 4 };
+		float m_ColorPhi{ 0.05f };
+		float m_NormalPhi{ 64.f };
+		float m_DepthPhi{ 0.1f };
+
+		const ColorRGB* m_pAlbedo{};
+		const Vector3* m_pNormal{};
+		const float* m_pDepth{};
+
+		//Ping-pong buffers holding the demodulated irradiance
+		std::vector<ColorRGB> m_Buffers[2]{};
+	};
+}
@@ -0,0 +1,238 @@
+#include "Executor.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <execution>
+#include <numeric>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+namespace dae {
+	namespace
+	{
+		void PinThreadToCore(std::thread& thread, uint32_t core)
+		{
+#if defined(_WIN32)
+			//Only the first processor group (64 cores) is used
+			SetThreadAffinityMask(thread.native_handle(), DWORD_PTR{ 1 } << (core % 64));
+#elif defined(__linux__)
+			cpu_set_t cpuSet{};
+			CPU_ZERO(&cpuSet);
+			CPU_SET(core % CPU_SETSIZE, &cpuSet);
+			pthread_setaffinity_np(thread.native_handle(), sizeof(cpuSet), &cpuSet);
+#else
+			(void)thread;
+			(void)core;
+#endif
+		}
+	}
+
+#pragma region Executor
+	Executor* Executor::Create(ExecutionBackend backend, uint32_t numThreads, bool pinThreads)
+	{
+		if (numThreads == 0)
+			numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+		switch (backend)
+		{
+		case ExecutionBackend::ThreadPool:
+			return new ThreadPool(numThreads, pinThreads);
+		case ExecutionBackend::StdExecution:
+			return new StdExecutionExecutor();
+		case ExecutionBackend::OpenMP:
+			return new OpenMPExecutor(numThreads);
+		case ExecutionBackend::Serial:
+		default:
+			return new SerialExecutor();
+		}
+	}
+
+	const char* Executor::GetBackendName(ExecutionBackend backend)
+	{
+		switch (backend)
+		{
+		case ExecutionBackend::ThreadPool:
+			return "ThreadPool";
+		case ExecutionBackend::StdExecution:
+			return "std::execution";
+		case ExecutionBackend::OpenMP:
+			return "OpenMP";
+		case ExecutionBackend::Serial:
+		default:
+			return "Serial";
+		}
+	}
+#pragma endregion
+
+#pragma region ThreadPool
+	ThreadPool::ThreadPool(uint32_t numThreads, bool pinThreads)
+	{
+		//The thread calling ParallelFor is one of the workers
+		const uint32_t numWorkers{ std::max(numThreads, 1u) - 1 };
+		m_WorkerStats = std::make_unique<WorkerStats[]>(numWorkers + 1);
+
+		m_Workers.reserve(numWorkers);
+		for (uint32_t i{ 0 }; i < numWorkers; ++i)
+		{
+			m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, i + 1);
+			if (pinThreads)
+				PinThreadToCore(m_Workers.back(), i + 1);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_WakeCondition.notify_all();
+
+		for (std::thread& worker : m_Workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job)
+	{
+		if (count == 0)
+			return;
+
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_pJob = &job;
+			m_JobCount = count;
+			m_NextJob = 0;
+			m_NumBusyWorkers = static_cast<uint32_t>(m_Workers.size());
+			++m_Generation;
+		}
+		m_WakeCondition.notify_all();
+
+		RunJobs(0);
+
+		std::unique_lock lock{ m_Mutex };
+		m_DoneCondition.wait(lock, [this] { return m_NumBusyWorkers == 0; });
+		m_pJob = nullptr;
+	}
+
+	void ThreadPool::WorkerLoop(uint32_t workerIndex)
+	{
+		uint64_t lastGeneration{ 0 };
+		while (true)
+		{
+			{
+				std::unique_lock lock{ m_Mutex };
+				m_WakeCondition.wait(lock, [this, lastGeneration] { return m_IsStopping || m_Generation != lastGeneration; });
+				if (m_IsStopping)
+					return;
+
+				lastGeneration = m_Generation;
+			}
+
+			RunJobs(workerIndex);
+
+			{
+				std::lock_guard lock{ m_Mutex };
+				if (--m_NumBusyWorkers == 0)
+					m_DoneCondition.notify_one();
+			}
+		}
+	}
+
+	void ThreadPool::RunJobs(uint32_t workerIndex)
+	{
+		uint64_t busyNanoseconds{ 0 };
+		for (uint32_t jobIndex{ m_NextJob.fetch_add(1) }; jobIndex < m_JobCount; jobIndex = m_NextJob.fetch_add(1))
+		{
+			const auto start{ std::chrono::steady_clock::now() };
+			(*m_pJob)(jobIndex);
+			busyNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		m_WorkerStats[workerIndex].busyNanoseconds.fetch_add(busyNanoseconds, std::memory_order_relaxed);
+	}
+
+	bool ThreadPool::GetBusyTimes(std::vector<uint64_t>& busyNanoseconds) const
+	{
+		busyNanoseconds.resize(GetNumThreads());
+		for (uint32_t i{ 0 }; i < busyNanoseconds.size(); ++i)
+		{
+			busyNanoseconds[i] = m_WorkerStats[i].busyNanoseconds.load(std::memory_order_relaxed);
+		}
+		return true;
+	}
+
+	void ThreadPool::ResetBusyTimes()
+	{
+		for (uint32_t i{ 0 }; i < GetNumThreads(); ++i)
+		{
+			m_WorkerStats[i].busyNanoseconds.store(0, std::memory_order_relaxed);
+		}
+	}
+#pragma endregion
+
+#pragma region StdExecution
+	void StdExecutionExecutor::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job)
+	{
+		if (m_Indices.size() < count)
+		{
+			m_Indices.resize(count);
+			std::iota(m_Indices.begin(), m_Indices.end(), 0u);
+		}
+
+		std::for_each(std::execution::par, m_Indices.begin(), m_Indices.begin() + count, [&job](uint32_t i) {
+			job(i);
+		});
+	}
+
+	uint32_t StdExecutionExecutor::GetNumThreads() const
+	{
+		//Thread count is up to the standard library
+		return std::max(std::thread::hardware_concurrency(), 1u);
+	}
+#pragma endregion
+
+#pragma region OpenMP
+	OpenMPExecutor::OpenMPExecutor(uint32_t numThreads) :
+		m_NumThreads(numThreads)
+	{
+#if !defined(_OPENMP)
+		m_NumThreads = 1;
+#endif
+	}
+
+	void OpenMPExecutor::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job)
+	{
+		//MSVC only supports OpenMP 2.0, which needs a signed loop index
+		const int numJobs{ static_cast<int>(count) };
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1) num_threads(static_cast<int>(m_NumThreads))
+#endif
+		for (int i = 0; i < numJobs; ++i)
+		{
+			job(static_cast<uint32_t>(i));
+		}
+	}
+#pragma endregion
+
+#pragma region Serial
+	void SerialExecutor::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job)
+	{
+		for (uint32_t i{ 0 }; i < count; ++i)
+		{
+			job(i);
+		}
+	}
+#pragma endregion
+}
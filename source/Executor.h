@@ -0,0 +1,165 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	enum class ExecutionBackend
+	{
+		ThreadPool,
+		StdExecution,
+		OpenMP,
+		Serial
+	};
+
+	//Runs batches of independent jobs (render tiles, denoiser passes, ...) on a parallel backend chosen at runtime
+	class Executor
+	{
+	public:
+		Executor() = default;
+		virtual ~Executor() = default;
+
+		Executor(const Executor&) = delete;
+		Executor(Executor&&) noexcept = delete;
+		Executor& operator=(const Executor&) = delete;
+		Executor& operator=(Executor&&) noexcept = delete;
+
+		/**
+		 * \brief Runs job(i) for every i in [0, count) and returns once all of them finished
+		 */
+		virtual void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job) = 0;
+
+		virtual const char* GetName() const = 0;
+		virtual uint32_t GetNumThreads() const = 0;
+
+		/**
+		 * \brief Time every thread spent running jobs since the last ResetBusyTimes
+		 * \return false when the backend doesn't track it
+		 */
+		virtual bool GetBusyTimes(std::vector<uint64_t>& /*busyNanoseconds*/) const { return false; }
+		virtual void ResetBusyTimes() {}
+
+		/**
+		 * \param numThreads Number of threads to use, 0 picks the hardware concurrency
+		 * \param pinThreads Pin every worker thread to its own core, only supported by the ThreadPool
+		 * \return new executor, owned by the caller
+		 */
+		static Executor* Create(ExecutionBackend backend, uint32_t numThreads = 0, bool pinThreads = false);
+		static const char* GetBackendName(ExecutionBackend backend);
+	};
+
+	//Persistent workers, woken up per ParallelFor call. The calling thread takes jobs as well.
+	class ThreadPool final : public Executor
+	{
+	public:
+		/**
+		 * \param pinThreads Pin worker i to core i, the calling thread (worker 0) is left to the scheduler
+		 */
+		ThreadPool(uint32_t numThreads, bool pinThreads = false);
+		~ThreadPool() override;
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job) override;
+
+		const char* GetName() const override { return GetBackendName(ExecutionBackend::ThreadPool); }
+		uint32_t GetNumThreads() const override { return static_cast<uint32_t>(m_Workers.size()) + 1; }
+
+		bool GetBusyTimes(std::vector<uint64_t>& busyNanoseconds) const override;
+		void ResetBusyTimes() override;
+
+	private:
+		//One per thread, on its own cache line so the counters don't bounce between cores
+		struct alignas(64) WorkerStats
+		{
+			std::atomic<uint64_t> busyNanoseconds{};
+		};
+
+		void WorkerLoop(uint32_t workerIndex);
+		void RunJobs(uint32_t workerIndex);
+
+		std::vector<std::thread> m_Workers{};
+		//Index 0 is the thread calling ParallelFor
+		std::unique_ptr<WorkerStats[]> m_WorkerStats{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_WakeCondition{};
+		std::condition_variable m_DoneCondition{};
+
+		const std::function<void(uint32_t)>* m_pJob{};
+		uint32_t m_JobCount{};
+		std::atomic<uint32_t> m_NextJob{};
+
+		uint64_t m_Generation{};
+		uint32_t m_NumBusyWorkers{};
+		bool m_IsStopping{ false };
+	};
+
+	//std::for_each with std::execution::par over the job indices
+	class StdExecutionExecutor final : public Executor
+	{
+	public:
+		StdExecutionExecutor() = default;
+		~StdExecutionExecutor() override = default;
+
+		StdExecutionExecutor(const StdExecutionExecutor&) = delete;
+		StdExecutionExecutor(StdExecutionExecutor&&) noexcept = delete;
+		StdExecutionExecutor& operator=(const StdExecutionExecutor&) = delete;
+		StdExecutionExecutor& operator=(StdExecutionExecutor&&) noexcept = delete;
+
+		void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job) override;
+
+		const char* GetName() const override { return GetBackendName(ExecutionBackend::StdExecution); }
+		uint32_t GetNumThreads() const override;
+
+	private:
+		//Index range the algorithm iterates over, only grows
+		std::vector<uint32_t> m_Indices{};
+	};
+
+	class OpenMPExecutor final : public Executor
+	{
+	public:
+		OpenMPExecutor(uint32_t numThreads);
+		~OpenMPExecutor() override = default;
+
+		OpenMPExecutor(const OpenMPExecutor&) = delete;
+		OpenMPExecutor(OpenMPExecutor&&) noexcept = delete;
+		OpenMPExecutor& operator=(const OpenMPExecutor&) = delete;
+		OpenMPExecutor& operator=(OpenMPExecutor&&) noexcept = delete;
+
+		void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job) override;
+
+		const char* GetName() const override { return GetBackendName(ExecutionBackend::OpenMP); }
+		uint32_t GetNumThreads() const override { return m_NumThreads; }
+
+	private:
+		uint32_t m_NumThreads{};
+	};
+
+	class SerialExecutor final : public Executor
+	{
+	public:
+		SerialExecutor() = default;
+		~SerialExecutor() override = default;
+
+		SerialExecutor(const SerialExecutor&) = delete;
+		SerialExecutor(SerialExecutor&&) noexcept = delete;
+		SerialExecutor& operator=(const SerialExecutor&) = delete;
+		SerialExecutor& operator=(SerialExecutor&&) noexcept = delete;
+
+		void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& job) override;
+
+		const char* GetName() const override { return GetBackendName(ExecutionBackend::Serial); }
+		uint32_t GetNumThreads() const override { return 1; }
+	};
+}
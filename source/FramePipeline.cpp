@@ -0,0 +1,142 @@
+#include "FramePipeline.h"
+
+#include <algorithm>
+
+#include "Renderer.h"
+#include "Profiler.h"
+
+namespace dae {
+	FramePipeline::FramePipeline(Renderer* pRenderer, uint32_t depth) :
+		m_pRenderer(pRenderer),
+		m_Depth(std::clamp(depth, 1u, MaxDepth))
+	{
+		if (m_Depth == 1)
+			return;
+
+		const size_t numPixels{ static_cast<size_t>(pRenderer->GetWidth()) * pRenderer->GetHeight() };
+		for (uint32_t i{ 0 }; i < m_Depth; ++i)
+		{
+			m_Frames.push_back(std::make_unique<Frame>());
+			m_Frames.back()->pixels.resize(numPixels);
+		}
+
+		m_RenderThread = std::thread{ &FramePipeline::RenderLoop, this };
+		m_PresentThread = std::thread{ &FramePipeline::PresentLoop, this };
+	}
+
+	FramePipeline::~FramePipeline()
+	{
+		Flush();
+		{
+			const std::lock_guard lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_StateChanged.notify_all();
+
+		if (m_RenderThread.joinable())
+			m_RenderThread.join();
+		if (m_PresentThread.joinable())
+			m_PresentThread.join();
+	}
+
+	void FramePipeline::Submit(Scene& scene, Clock::time_point startTime)
+	{
+		if (m_Depth == 1)
+		{
+			m_pRenderer->Render(&scene);
+			AddLatency(startTime);
+			return;
+		}
+
+		Frame& frame{ *m_Frames[m_NextSubmit] };
+		{
+			PROFILE_SCOPE("WaitForFreeFrame");
+			WaitForState(frame, FrameState::Free);
+		}
+
+		//The frame is free, neither of the other stages touches it until it is submitted
+		frame.scene.CopyRenderState(scene);
+		frame.startTime = startTime;
+		SetState(frame, FrameState::Submitted);
+		m_NextSubmit = (m_NextSubmit + 1) % m_Depth;
+	}
+
+	void FramePipeline::Flush()
+	{
+		PROFILE_SCOPE("FlushPipeline");
+		std::unique_lock lock{ m_Mutex };
+		m_StateChanged.wait(lock, [this] {
+			return std::all_of(m_Frames.begin(), m_Frames.end(), [](const std::unique_ptr<Frame>& pFrame) { return pFrame->state == FrameState::Free; });
+		});
+	}
+
+	FrameLatency FramePipeline::ConsumeLatency()
+	{
+		const std::lock_guard lock{ m_Mutex };
+		FrameLatency latency{};
+		latency.numFrames = m_NumLatencies;
+		latency.average = m_NumLatencies > 0 ? m_LatencySum / static_cast<float>(m_NumLatencies) : 0.f;
+		latency.max = m_LatencyMax;
+
+		m_LatencySum = 0.f;
+		m_LatencyMax = 0.f;
+		m_NumLatencies = 0;
+		return latency;
+	}
+
+	void FramePipeline::RenderLoop()
+	{
+		Profiler::SetThreadName("Render");
+		while (true)
+		{
+			Frame& frame{ *m_Frames[m_NextRender] };
+			if (!WaitForState(frame, FrameState::Submitted))
+				return;
+
+			m_pRenderer->RenderFrame(&frame.scene, frame.pixels.data());
+			SetState(frame, FrameState::Rendered);
+			m_NextRender = (m_NextRender + 1) % m_Depth;
+		}
+	}
+
+	void FramePipeline::PresentLoop()
+	{
+		Profiler::SetThreadName("Present");
+		while (true)
+		{
+			Frame& frame{ *m_Frames[m_NextPresent] };
+			if (!WaitForState(frame, FrameState::Rendered))
+				return;
+
+			m_pRenderer->Present(frame.pixels.data());
+			AddLatency(frame.startTime);
+			SetState(frame, FrameState::Free);
+			m_NextPresent = (m_NextPresent + 1) % m_Depth;
+		}
+	}
+
+	bool FramePipeline::WaitForState(const Frame& frame, FrameState state)
+	{
+		std::unique_lock lock{ m_Mutex };
+		m_StateChanged.wait(lock, [this, &frame, state] { return frame.state == state || m_IsStopping; });
+		return frame.state == state;
+	}
+
+	void FramePipeline::SetState(Frame& frame, FrameState state)
+	{
+		{
+			const std::lock_guard lock{ m_Mutex };
+			frame.state = state;
+		}
+		m_StateChanged.notify_all();
+	}
+
+	void FramePipeline::AddLatency(Clock::time_point startTime)
+	{
+		const float latency{ std::chrono::duration<float, std::milli>(Clock::now() - startTime).count() };
+		const std::lock_guard lock{ m_Mutex };
+		m_LatencySum += latency;
+		m_LatencyMax = std::max(m_LatencyMax, latency);
+		++m_NumLatencies;
+	}
+}
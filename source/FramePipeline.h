@@ -0,0 +1,118 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Scene.h"
+
+namespace dae
+{
+	class Renderer;
+
+	//Copy of a scene for one frame in flight, filled by Scene::CopyRenderState. Never initialized or updated itself
+	class SceneSnapshot final : public Scene
+	{
+	public:
+		SceneSnapshot() = default;
+		~SceneSnapshot() override = default;
+
+		SceneSnapshot(const SceneSnapshot&) = delete;
+		SceneSnapshot(SceneSnapshot&&) noexcept = delete;
+		SceneSnapshot& operator=(const SceneSnapshot&) = delete;
+		SceneSnapshot& operator=(SceneSnapshot&&) noexcept = delete;
+
+		void Initialize() override {}
+		void Update(Timer* /*pTimer*/) override {}
+	};
+
+	//Frames presented since the last ConsumeLatency, measured from the start of the frame to the end of its Present (ms)
+	struct FrameLatency
+	{
+		float average{};
+		float max{};
+		uint32_t numFrames{};
+	};
+
+	/**
+	 * \brief Renders and presents frames on threads of their own, so the calling thread can update the next frame meanwhile.
+	 * Every frame in flight renders from its own scene snapshot into its own framebuffer.
+	 */
+	class FramePipeline final
+	{
+	public:
+		static constexpr uint32_t MaxDepth{ 3 };
+
+		/**
+		 * \param depth Frames in flight, clamped to [1, MaxDepth]. 1 renders and presents the live scene inside Submit,
+		 * 2 renders a frame while the next one is updated, 3 also presents a frame while the next one renders
+		 */
+		FramePipeline(Renderer* pRenderer, uint32_t depth);
+		~FramePipeline();
+
+		FramePipeline(const FramePipeline&) = delete;
+		FramePipeline(FramePipeline&&) noexcept = delete;
+		FramePipeline& operator=(const FramePipeline&) = delete;
+		FramePipeline& operator=(FramePipeline&&) noexcept = delete;
+
+		/**
+		 * \brief Snapshots the scene and queues it for rendering, waits while every frame is in flight
+		 * \param startTime When the frame started, before input and the scene update, latency is measured from here
+		 */
+		void Submit(Scene& scene, std::chrono::steady_clock::time_point startTime);
+		//Waits until every submitted frame was presented. Renderer settings may only be changed while the pipeline is flushed
+		void Flush();
+
+		uint32_t GetDepth() const { return m_Depth; }
+		FrameLatency ConsumeLatency();
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		enum class FrameState
+		{
+			Free,
+			Submitted,
+			Rendered
+		};
+
+		struct Frame
+		{
+			SceneSnapshot scene{};
+			std::vector<uint32_t> pixels{};
+			Clock::time_point startTime{};
+			FrameState state{ FrameState::Free };
+		};
+
+		void RenderLoop();
+		void PresentLoop();
+		//Blocks until frame is in state or the pipeline stops, false when it stopped
+		bool WaitForState(const Frame& frame, FrameState state);
+		void SetState(Frame& frame, FrameState state);
+		void AddLatency(Clock::time_point startTime);
+
+		Renderer* m_pRenderer{};
+		uint32_t m_Depth{};
+
+		//Used round robin by every stage, empty for a depth of 1
+		std::vector<std::unique_ptr<Frame>> m_Frames{};
+		uint32_t m_NextSubmit{};
+		uint32_t m_NextRender{};
+		uint32_t m_NextPresent{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_StateChanged{};
+		bool m_IsStopping{ false };
+
+		std::thread m_RenderThread{};
+		std::thread m_PresentThread{};
+
+		//Guarded by m_Mutex
+		float m_LatencySum{};
+		float m_LatencyMax{};
+		uint32_t m_NumLatencies{};
+	};
+}
@@ -0,0 +1,255 @@
+#include "FrameStream.h"
+
+#include <algorithm>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "Profiler.h"
+
+namespace dae {
+	namespace
+	{
+		const char* const Y4MFrameHeader{ "FRAME\n" };
+		constexpr size_t Y4MFrameHeaderSize{ 6 };
+
+		//Splits packed pixels into channel planes. Shifts are passed by value so the loop stays vectorizable
+		void UnpackRow(const uint32_t* pPixels, int width, uint32_t redShift, uint32_t greenShift, uint32_t blueShift, uint8_t* pRed, uint8_t* pGreen, uint8_t* pBlue)
+		{
+			for (int x{ 0 }; x < width; ++x)
+			{
+				pRed[x] = static_cast<uint8_t>(pPixels[x] >> redShift);
+				pGreen[x] = static_cast<uint8_t>(pPixels[x] >> greenShift);
+				pBlue[x] = static_cast<uint8_t>(pPixels[x] >> blueShift);
+			}
+		}
+
+		//Full range BT.601 in 8 bit fixed point, as JPEG uses it
+		void ConvertLumaRow(const uint8_t* pRed, const uint8_t* pGreen, const uint8_t* pBlue, int width, uint8_t* pLuma)
+		{
+			for (int x{ 0 }; x < width; ++x)
+			{
+				pLuma[x] = static_cast<uint8_t>((77 * pRed[x] + 150 * pGreen[x] + 29 * pBlue[x] + 128) >> 8);
+			}
+		}
+
+		int AverageBlock(const uint8_t* pTop, const uint8_t* pBottom, int left, int right)
+		{
+			return (pTop[left] + pTop[right] + pBottom[left] + pBottom[right] + 2) >> 2;
+		}
+
+		//Chroma of the average of a 2x2 block, the offset keeps the sums positive before the shift
+		void ConvertChroma(int red, int green, int blue, uint8_t& u, uint8_t& v)
+		{
+			u = static_cast<uint8_t>(std::min((-43 * red - 85 * green + 128 * blue + 32896) >> 8, 255));
+			v = static_cast<uint8_t>(std::min((128 * red - 107 * green - 21 * blue + 32896) >> 8, 255));
+		}
+	}
+
+	FrameStream::FrameStream(const std::string& path, StreamFormat format, int width, int height, const PixelShifts& shifts, int framesPerSecond, uint32_t queueDepth) :
+		m_IsStdout(path == "-"),
+		m_Format(format),
+		m_Width(width),
+		m_Height(height),
+		m_Shifts(shifts)
+	{
+		if (m_IsStdout)
+		{
+#ifdef _WIN32
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+			m_pFile = stdout;
+		}
+		else
+		{
+			//Blocks until a reader opens a named pipe
+			m_pFile = std::fopen(path.c_str(), "wb");
+		}
+		if (!m_pFile)
+			return;
+
+		const size_t numPixels{ static_cast<size_t>(width) * height };
+		m_Frames.resize(std::max(queueDepth, 1u));
+		for (std::vector<uint32_t>& frame : m_Frames)
+		{
+			frame.resize(numPixels);
+		}
+
+		if (format == StreamFormat::Y4M)
+		{
+			const size_t numChromaPixels{ static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2) };
+			m_Output.resize(Y4MFrameHeaderSize + numPixels + numChromaPixels * 2);
+			std::copy(Y4MFrameHeader, Y4MFrameHeader + Y4MFrameHeaderSize, m_Output.begin());
+			m_Rows.resize(static_cast<size_t>(width) * 6);
+			std::fprintf(m_pFile, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XYSCSS=420JPEG\n", width, height, framesPerSecond);
+		}
+		else
+		{
+			m_Output.resize(numPixels * 3);
+		}
+
+		m_Thread = std::thread{ &FrameStream::WriteLoop, this };
+	}
+
+	FrameStream::~FrameStream()
+	{
+		if (!m_pFile)
+			return;
+
+		{
+			const std::lock_guard lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_StateChanged.notify_all();
+		if (m_Thread.joinable())
+			m_Thread.join();
+
+		if (m_IsStdout)
+			std::fflush(m_pFile);
+		else
+			std::fclose(m_pFile);
+		m_pFile = nullptr;
+	}
+
+	bool FrameStream::HasFailed() const
+	{
+		const std::lock_guard lock{ m_Mutex };
+		return m_HasFailed;
+	}
+
+	uint64_t FrameStream::GetNumWrittenFrames() const
+	{
+		const std::lock_guard lock{ m_Mutex };
+		return m_NumWritten;
+	}
+
+	void FrameStream::Push(const uint32_t* pPixels)
+	{
+		if (!m_pFile)
+			return;
+
+		{
+			PROFILE_SCOPE("WaitForFrameStream");
+			std::unique_lock lock{ m_Mutex };
+			m_StateChanged.wait(lock, [this] { return m_NumQueued < m_Frames.size(); });
+		}
+
+		//The writer is done with this frame, it only reads the frames counted in m_NumQueued
+		std::vector<uint32_t>& frame{ m_Frames[m_NextPush] };
+		std::copy(pPixels, pPixels + frame.size(), frame.begin());
+		m_NextPush = (m_NextPush + 1) % static_cast<uint32_t>(m_Frames.size());
+
+		{
+			const std::lock_guard lock{ m_Mutex };
+			++m_NumQueued;
+		}
+		m_StateChanged.notify_all();
+	}
+
+	void FrameStream::WriteLoop()
+	{
+		Profiler::SetThreadName("FrameStream");
+		while (true)
+		{
+			{
+				//Queued frames are still written after the stream is stopped
+				std::unique_lock lock{ m_Mutex };
+				m_StateChanged.wait(lock, [this] { return m_NumQueued > 0 || m_IsStopping; });
+				if (m_NumQueued == 0)
+					return;
+			}
+
+			{
+				PROFILE_SCOPE("ConvertFrame");
+				const uint32_t* pPixels{ m_Frames[m_NextWrite].data() };
+				if (m_Format == StreamFormat::Y4M)
+					ConvertY4M(pPixels);
+				else
+					ConvertRawRGB(pPixels);
+			}
+			m_NextWrite = (m_NextWrite + 1) % static_cast<uint32_t>(m_Frames.size());
+
+			//The frame is converted, Push may refill it while the output is written
+			bool hasFailed{};
+			{
+				const std::lock_guard lock{ m_Mutex };
+				--m_NumQueued;
+				hasFailed = m_HasFailed;
+			}
+			m_StateChanged.notify_all();
+			if (hasFailed)
+				continue;
+
+			PROFILE_SCOPE("WriteFrame");
+			const bool isWritten{ std::fwrite(m_Output.data(), 1, m_Output.size(), m_pFile) == m_Output.size() && std::fflush(m_pFile) == 0 };
+			const std::lock_guard lock{ m_Mutex };
+			if (isWritten)
+				++m_NumWritten;
+			else
+				m_HasFailed = true;
+		}
+	}
+
+	void FrameStream::ConvertY4M(const uint32_t* pPixels)
+	{
+		const int width{ m_Width };
+		const int chromaWidth{ (m_Width + 1) / 2 };
+		const int chromaHeight{ (m_Height + 1) / 2 };
+		uint8_t* const pLuma{ m_Output.data() + Y4MFrameHeaderSize };
+		uint8_t* const pU{ pLuma + static_cast<size_t>(m_Width) * m_Height };
+		uint8_t* const pV{ pU + static_cast<size_t>(chromaWidth) * chromaHeight };
+
+		//Red, green and blue of the top row, then of the bottom row
+		uint8_t* const pTop{ m_Rows.data() };
+		uint8_t* const pBottom{ pTop + width * 3 };
+
+		for (int chromaY{ 0 }; chromaY < chromaHeight; ++chromaY)
+		{
+			//An odd last row pairs up with itself
+			const int topY{ chromaY * 2 };
+			const int bottomY{ std::min(topY + 1, m_Height - 1) };
+			UnpackRow(pPixels + static_cast<size_t>(topY) * width, width, m_Shifts.red, m_Shifts.green, m_Shifts.blue, pTop, pTop + width, pTop + width * 2);
+			UnpackRow(pPixels + static_cast<size_t>(bottomY) * width, width, m_Shifts.red, m_Shifts.green, m_Shifts.blue, pBottom, pBottom + width, pBottom + width * 2);
+
+			ConvertLumaRow(pTop, pTop + width, pTop + width * 2, width, pLuma + static_cast<size_t>(topY) * width);
+			ConvertLumaRow(pBottom, pBottom + width, pBottom + width * 2, width, pLuma + static_cast<size_t>(bottomY) * width);
+
+			uint8_t* const pURow{ pU + static_cast<size_t>(chromaY) * chromaWidth };
+			uint8_t* const pVRow{ pV + static_cast<size_t>(chromaY) * chromaWidth };
+			//Pairs of columns, then an odd last column paired with itself
+			const uint8_t* const pTopGreen{ pTop + width };
+			const uint8_t* const pTopBlue{ pTop + width * 2 };
+			const uint8_t* const pBottomGreen{ pBottom + width };
+			const uint8_t* const pBottomBlue{ pBottom + width * 2 };
+			const int numPairs{ width / 2 };
+			for (int chromaX{ 0 }; chromaX < numPairs; ++chromaX)
+			{
+				const int left{ chromaX * 2 };
+				ConvertChroma(AverageBlock(pTop, pBottom, left, left + 1), AverageBlock(pTopGreen, pBottomGreen, left, left + 1),
+					AverageBlock(pTopBlue, pBottomBlue, left, left + 1), pURow[chromaX], pVRow[chromaX]);
+			}
+			if (numPairs < chromaWidth)
+			{
+				const int left{ width - 1 };
+				ConvertChroma(AverageBlock(pTop, pBottom, left, left), AverageBlock(pTopGreen, pBottomGreen, left, left),
+					AverageBlock(pTopBlue, pBottomBlue, left, left), pURow[numPairs], pVRow[numPairs]);
+			}
+		}
+	}
+
+	void FrameStream::ConvertRawRGB(const uint32_t* pPixels)
+	{
+		const uint32_t redShift{ m_Shifts.red };
+		const uint32_t greenShift{ m_Shifts.green };
+		const uint32_t blueShift{ m_Shifts.blue };
+		uint8_t* const pOut{ m_Output.data() };
+		const size_t numPixels{ static_cast<size_t>(m_Width) * m_Height };
+		for (size_t i{ 0 }; i < numPixels; ++i)
+		{
+			pOut[i * 3] = static_cast<uint8_t>(pPixels[i] >> redShift);
+			pOut[i * 3 + 1] = static_cast<uint8_t>(pPixels[i] >> greenShift);
+			pOut[i * 3 + 2] = static_cast<uint8_t>(pPixels[i] >> blueShift);
+		}
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	enum class StreamFormat
+	{
+		//YUV4MPEG2, 4:2:0 full range BT.601, understood by ffmpeg and most encoders
+		Y4M,
+		//Headerless 8 bit RGB, the reader has to be told the size
+		RawRGB
+	};
+
+	//Bit offset of every channel in a packed 32 bit pixel of the window surface
+	struct PixelShifts
+	{
+		uint8_t red{ 16 };
+		uint8_t green{ 8 };
+		uint8_t blue{ 0 };
+	};
+
+	/**
+	 * \brief Writes every pushed frame to a file, a named pipe or stdout, converted and written on a thread of its own.
+	 * At most queueDepth frames wait for the writer, Push blocks while they do, so a slow reader slows down the renderer
+	 * instead of frames being dropped. Nothing is allocated after construction.
+	 */
+	class FrameStream final
+	{
+	public:
+		/**
+		 * \param path File or named pipe to write to, "-" for stdout
+		 * \param framesPerSecond Frame rate stored in the Y4M header
+		 */
+		FrameStream(const std::string& path, StreamFormat format, int width, int height, const PixelShifts& shifts, int framesPerSecond = 30, uint32_t queueDepth = 4);
+		//Writes the queued frames before it closes the output
+		~FrameStream();
+
+		FrameStream(const FrameStream&) = delete;
+		FrameStream(FrameStream&&) noexcept = delete;
+		FrameStream& operator=(const FrameStream&) = delete;
+		FrameStream& operator=(FrameStream&&) noexcept = delete;
+
+		//False when the output couldn't be opened, nothing is written then
+		bool IsOpen() const { return m_pFile != nullptr; }
+		//True once a write failed, e.g. because the reader closed the pipe. Later frames are dropped
+		bool HasFailed() const;
+		uint64_t GetNumWrittenFrames() const;
+
+		/**
+		 * \brief Copies the frame into the queue, waits while the queue is full
+		 * \param pPixels Width * height packed pixels of the window surface
+		 */
+		void Push(const uint32_t* pPixels);
+
+	private:
+		void WriteLoop();
+		void ConvertY4M(const uint32_t* pPixels);
+		void ConvertRawRGB(const uint32_t* pPixels);
+
+		std::FILE* m_pFile{};
+		bool m_IsStdout{};
+		StreamFormat m_Format{};
+		int m_Width{};
+		int m_Height{};
+		PixelShifts m_Shifts{};
+
+		//Ring of frames waiting for the writer
+		std::vector<std::vector<uint32_t>> m_Frames{};
+		uint32_t m_NextPush{};
+		uint32_t m_NextWrite{};
+		//Encoded frame, only touched by the writer thread
+		std::vector<uint8_t> m_Output{};
+		//Channels of two rows, for the chroma of a row pair
+		std::vector<uint8_t> m_Rows{};
+
+		mutable std::mutex m_Mutex{};
+		std::condition_variable m_StateChanged{};
+		//Guarded by m_Mutex
+		uint32_t m_NumQueued{};
+		uint64_t m_NumWritten{};
+		bool m_HasFailed{ false };
+		bool m_IsStopping{ false };
+
+		std::thread m_Thread{};
+	};
+}
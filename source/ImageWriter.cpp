@@ -0,0 +1,461 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include "Deflate.h"
+#include "Executor.h"
+#include "Profiler.h"
+
+namespace dae {
+	namespace
+	{
+		constexpr int PngRowsPerStripe{ 16 };
+		constexpr int ExrTileSize{ 64 };
+
+		void AppendUint32BigEndian(std::vector<uint8_t>& out, uint32_t value)
+		{
+			for (int shift{ 24 }; shift >= 0; shift -= 8)
+			{
+				out.push_back(static_cast<uint8_t>(value >> shift));
+			}
+		}
+
+		template<typename T>
+		void AppendLittleEndian(std::vector<uint8_t>& out, T value)
+		{
+			uint64_t bits{};
+			std::memcpy(&bits, &value, sizeof(T));
+			for (size_t i{ 0 }; i < sizeof(T); ++i)
+			{
+				out.push_back(static_cast<uint8_t>(bits >> (i * 8)));
+			}
+		}
+
+		void AppendString(std::vector<uint8_t>& out, const char* text)
+		{
+			out.insert(out.end(), text, text + std::strlen(text) + 1);
+		}
+
+		//Length, type, data and CRC of the type and data
+		void AppendPngChunk(std::vector<uint8_t>& file, const char* type, const uint8_t* pData, size_t size)
+		{
+			AppendUint32BigEndian(file, static_cast<uint32_t>(size));
+			const size_t typeStart{ file.size() };
+			file.insert(file.end(), type, type + 4);
+			file.insert(file.end(), pData, pData + size);
+			AppendUint32BigEndian(file, Deflate::Crc32(file.data() + typeStart, size + 4));
+		}
+
+		uint8_t PaethPredictor(int left, int up, int upLeft)
+		{
+			const int estimate{ left + up - upLeft };
+			const int leftDistance{ std::abs(estimate - left) };
+			const int upDistance{ std::abs(estimate - up) };
+			const int upLeftDistance{ std::abs(estimate - upLeft) };
+			if (leftDistance <= upDistance && leftDistance <= upLeftDistance)
+				return static_cast<uint8_t>(left);
+			return static_cast<uint8_t>(upDistance <= upLeftDistance ? up : upLeft);
+		}
+
+		//Round to nearest even, overflow goes to infinity
+		uint16_t FloatToHalf(float value)
+		{
+			uint32_t bits{};
+			std::memcpy(&bits, &value, sizeof(bits));
+			const uint32_t sign{ (bits >> 16) & 0x8000 };
+			const uint32_t floatExponent{ (bits >> 23) & 0xff };
+			uint32_t mantissa{ bits & 0x7fffff };
+
+			if (floatExponent == 0xff)
+				return static_cast<uint16_t>(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+
+			const int exponent{ static_cast<int>(floatExponent) - 127 + 15 };
+			if (exponent >= 31)
+				return static_cast<uint16_t>(sign | 0x7c00);
+
+			//Denormal half
+			if (exponent <= 0)
+			{
+				if (exponent < -10)
+					return static_cast<uint16_t>(sign);
+				mantissa |= 0x800000;
+				const uint32_t shift{ static_cast<uint32_t>(14 - exponent) };
+				uint32_t half{ mantissa >> shift };
+				const uint32_t remainder{ mantissa & ((1u << shift) - 1) };
+				const uint32_t halfway{ 1u << (shift - 1) };
+				if (remainder > halfway || (remainder == halfway && (half & 1)))
+					++half;
+				return static_cast<uint16_t>(sign | half);
+			}
+
+			//A carry out of the mantissa rounds up into the exponent
+			uint32_t half{ (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13) };
+			const uint32_t remainder{ mantissa & 0x1fff };
+			if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+				++half;
+			return static_cast<uint16_t>(sign | half);
+		}
+
+		struct PngJob
+		{
+			const ColorRGB* pPixels{};
+			int width{};
+			int height{};
+			std::vector<uint8_t>* pColors{};
+			std::vector<uint8_t>* pFiltered{};
+		};
+
+		//Filters row y of the 8 bit colors with the PNG filter (None, Sub, Up, Average, Paeth) of the smallest sum of absolute values
+		void FilterPngRow(const PngJob& job, int y)
+		{
+			const size_t rowSize{ static_cast<size_t>(job.width) * 3 };
+			const uint8_t* pRow{ job.pColors->data() + y * rowSize };
+			const uint8_t* pPrevious{ y > 0 ? pRow - rowSize : nullptr };
+			uint8_t* pOut{ job.pFiltered->data() + y * (rowSize + 1) };
+
+			uint8_t bestFilter{ 0 };
+			uint64_t bestSum{ UINT64_MAX };
+			for (uint8_t filter{ 0 }; filter < 5; ++filter)
+			{
+				uint64_t sum{ 0 };
+				for (size_t i{ 0 }; i < rowSize; ++i)
+				{
+					const int left{ i >= 3 ? pRow[i - 3] : 0 };
+					const int up{ pPrevious ? pPrevious[i] : 0 };
+					const int upLeft{ pPrevious && i >= 3 ? pPrevious[i - 3] : 0 };
+
+					uint8_t prediction{ 0 };
+					switch (filter)
+					{
+					case 1: prediction = static_cast<uint8_t>(left); break;
+					case 2: prediction = static_cast<uint8_t>(up); break;
+					case 3: prediction = static_cast<uint8_t>((left + up) / 2); break;
+					case 4: prediction = PaethPredictor(left, up, upLeft); break;
+					default: break;
+					}
+
+					const uint8_t filtered{ static_cast<uint8_t>(pRow[i] - prediction) };
+					pOut[i + 1] = filtered;
+					sum += static_cast<uint64_t>(std::abs(static_cast<int8_t>(filtered)));
+				}
+
+				if (sum < bestSum)
+				{
+					bestSum = sum;
+					bestFilter = filter;
+				}
+			}
+
+			//The loop left the last filter in the row, run the best one again unless that was it
+			pOut[0] = bestFilter;
+			if (bestFilter == 4)
+				return;
+			for (size_t i{ 0 }; i < rowSize; ++i)
+			{
+				const int left{ i >= 3 ? pRow[i - 3] : 0 };
+				const int up{ pPrevious ? pPrevious[i] : 0 };
+				uint8_t prediction{ 0 };
+				switch (bestFilter)
+				{
+				case 1: prediction = static_cast<uint8_t>(left); break;
+				case 2: prediction = static_cast<uint8_t>(up); break;
+				case 3: prediction = static_cast<uint8_t>((left + up) / 2); break;
+				default: break;
+				}
+				pOut[i + 1] = static_cast<uint8_t>(pRow[i] - prediction);
+			}
+		}
+
+		struct ExrJob
+		{
+			const ColorRGB* pPixels{};
+			int width{};
+			int height{};
+			int numTilesX{};
+			bool isHalf{};
+			std::vector<std::vector<uint8_t>>* pTiles{};
+		};
+
+		//Chunk of one tile: its coordinates, level and size, then the zip compressed channels, or the raw ones when that is smaller
+		void EncodeExrTile(const ExrJob& job, uint32_t tileIndex)
+		{
+			const int tileX{ static_cast<int>(tileIndex) % job.numTilesX };
+			const int tileY{ static_cast<int>(tileIndex) / job.numTilesX };
+			const int x0{ tileX * ExrTileSize };
+			const int y0{ tileY * ExrTileSize };
+			const int tileWidth{ std::min(ExrTileSize, job.width - x0) };
+			const int tileHeight{ std::min(ExrTileSize, job.height - y0) };
+
+			//Every row holds the B, G and R channels one after the other, in the alphabetical order of the channel list
+			std::vector<uint8_t> raw{};
+			for (int y{ y0 }; y < y0 + tileHeight; ++y)
+			{
+				const ColorRGB* pRow{ job.pPixels + static_cast<size_t>(y) * job.width };
+				for (int channel{ 0 }; channel < 3; ++channel)
+				{
+					for (int x{ x0 }; x < x0 + tileWidth; ++x)
+					{
+						const float value{ channel == 0 ? pRow[x].b : channel == 1 ? pRow[x].g : pRow[x].r };
+						if (job.isHalf)
+							AppendLittleEndian(raw, FloatToHalf(value));
+						else
+							AppendLittleEndian(raw, value);
+					}
+				}
+			}
+
+			//Zip compression splits the bytes into even and odd halves and stores the differences between neighbours before deflating
+			std::vector<uint8_t> predicted(raw.size());
+			const size_t half{ (raw.size() + 1) / 2 };
+			for (size_t i{ 0 }; i < raw.size(); ++i)
+			{
+				predicted[(i & 1) ? half + i / 2 : i / 2] = raw[i];
+			}
+			for (size_t i{ predicted.size() - 1 }; i > 0; --i)
+			{
+				predicted[i] = static_cast<uint8_t>(predicted[i] - predicted[i - 1] + 128);
+			}
+			std::vector<uint8_t> compressed{};
+			Deflate::CompressZlib(predicted.data(), predicted.size(), compressed);
+			const std::vector<uint8_t>& data{ compressed.size() < raw.size() ? compressed : raw };
+
+			std::vector<uint8_t>& chunk{ (*job.pTiles)[tileIndex] };
+			AppendLittleEndian(chunk, static_cast<int32_t>(tileX));
+			AppendLittleEndian(chunk, static_cast<int32_t>(tileY));
+			AppendLittleEndian(chunk, int32_t{ 0 });
+			AppendLittleEndian(chunk, int32_t{ 0 });
+			AppendLittleEndian(chunk, static_cast<int32_t>(data.size()));
+			chunk.insert(chunk.end(), data.begin(), data.end());
+		}
+	}
+
+	ImageWriter::ImageWriter(uint32_t numThreads)
+	{
+		if (numThreads == 0)
+			numThreads = std::max(std::thread::hardware_concurrency() / 4, 1u);
+		m_pExecutor = Executor::Create(ExecutionBackend::ThreadPool, numThreads);
+		m_Thread = std::thread{ &ImageWriter::WriteLoop, this };
+	}
+
+	ImageWriter::~ImageWriter()
+	{
+		{
+			const std::lock_guard lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_StateChanged.notify_all();
+		if (m_Thread.joinable())
+			m_Thread.join();
+
+		delete m_pExecutor;
+		m_pExecutor = nullptr;
+	}
+
+	void ImageWriter::Write(const std::string& path, ImageFormat format, int width, int height, std::vector<ColorRGB> pixels)
+	{
+		assert(pixels.size() == static_cast<size_t>(width) * height && "Image size doesn't match the pixels");
+		{
+			const std::lock_guard lock{ m_Mutex };
+			m_Jobs.push_back({ path, format, width, height, std::move(pixels) });
+		}
+		m_StateChanged.notify_all();
+	}
+
+	void ImageWriter::Flush()
+	{
+		std::unique_lock lock{ m_Mutex };
+		m_StateChanged.wait(lock, [this] { return m_Jobs.empty() && !m_IsWriting; });
+	}
+
+	bool ImageWriter::PopResult(ImageWriteResult& result)
+	{
+		const std::lock_guard lock{ m_Mutex };
+		if (m_Results.empty())
+			return false;
+
+		result = std::move(m_Results.front());
+		m_Results.pop_front();
+		return true;
+	}
+
+	ImageFormat ImageWriter::GetFormat(const std::string& path)
+	{
+		const std::string extension{ ".exr" };
+		const bool isExr{ path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0 };
+		return isExr ? ImageFormat::ExrHalf : ImageFormat::Png;
+	}
+
+	void ImageWriter::WriteLoop()
+	{
+		Profiler::SetThreadName("ImageWriter");
+		while (true)
+		{
+			Job job{};
+			{
+				//Queued jobs are still written after Stop
+				std::unique_lock lock{ m_Mutex };
+				m_StateChanged.wait(lock, [this] { return !m_Jobs.empty() || m_IsStopping; });
+				if (m_Jobs.empty())
+					return;
+
+				job = std::move(m_Jobs.front());
+				m_Jobs.pop_front();
+				m_IsWriting = true;
+			}
+
+			const bool isSaved{ WriteImage(job) };
+			{
+				const std::lock_guard lock{ m_Mutex };
+				m_Results.push_back({ job.path, isSaved });
+				m_IsWriting = false;
+			}
+			m_StateChanged.notify_all();
+		}
+	}
+
+	bool ImageWriter::WriteImage(const Job& job)
+	{
+		PROFILE_SCOPE("WriteImage");
+		std::vector<uint8_t> file{};
+		if (job.format == ImageFormat::Png)
+			EncodePng(job, file);
+		else
+			EncodeExr(job, file);
+
+		std::ofstream stream{ job.path, std::ios::binary };
+		stream.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+		return static_cast<bool>(stream);
+	}
+
+	void ImageWriter::EncodePng(const Job& job, std::vector<uint8_t>& file)
+	{
+		PROFILE_SCOPE("EncodePng");
+		const size_t rowSize{ static_cast<size_t>(job.width) * 3 };
+		std::vector<uint8_t> colors(rowSize * job.height);
+		//Every row starts with its filter type
+		std::vector<uint8_t> filtered((rowSize + 1) * job.height);
+
+		const PngJob pngJob{ job.pixels.data(), job.width, job.height, &colors, &filtered };
+		m_pExecutor->ParallelFor(static_cast<uint32_t>(job.height), [&pngJob](uint32_t y) {
+			//Clamped and truncated like Renderer::ResolveTile, so the file matches the window
+			const ColorRGB* pRow{ pngJob.pPixels + static_cast<size_t>(y) * pngJob.width };
+			uint8_t* pOut{ pngJob.pColors->data() + static_cast<size_t>(y) * pngJob.width * 3 };
+			for (int x{ 0 }; x < pngJob.width; ++x)
+			{
+				ColorRGB color{ pRow[x] };
+				color.MaxToOne();
+				pOut[x * 3] = static_cast<uint8_t>(color.r * 255);
+				pOut[x * 3 + 1] = static_cast<uint8_t>(color.g * 255);
+				pOut[x * 3 + 2] = static_cast<uint8_t>(color.b * 255);
+			}
+		});
+		m_pExecutor->ParallelFor(static_cast<uint32_t>(job.height), [&pngJob](uint32_t y) {
+			FilterPngRow(pngJob, static_cast<int>(y));
+		});
+
+		std::vector<uint8_t> compressed{};
+		Deflate::CompressZlib(filtered.data(), filtered.size(), compressed, m_pExecutor, (rowSize + 1) * PngRowsPerStripe);
+
+		constexpr uint8_t signature[8]{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+		file.insert(file.end(), signature, signature + 8);
+
+		//8 bit RGB, deflate, adaptive filtering, not interlaced
+		std::vector<uint8_t> header{};
+		AppendUint32BigEndian(header, static_cast<uint32_t>(job.width));
+		AppendUint32BigEndian(header, static_cast<uint32_t>(job.height));
+		header.insert(header.end(), { 8, 2, 0, 0, 0 });
+		AppendPngChunk(file, "IHDR", header.data(), header.size());
+		AppendPngChunk(file, "IDAT", compressed.data(), compressed.size());
+		AppendPngChunk(file, "IEND", nullptr, 0);
+	}
+
+	void ImageWriter::EncodeExr(const Job& job, std::vector<uint8_t>& file)
+	{
+		PROFILE_SCOPE("EncodeExr");
+		const bool isHalf{ job.format == ImageFormat::ExrHalf };
+		const int numTilesX{ (job.width + ExrTileSize - 1) / ExrTileSize };
+		const int numTilesY{ (job.height + ExrTileSize - 1) / ExrTileSize };
+		const uint32_t numTiles{ static_cast<uint32_t>(numTilesX * numTilesY) };
+
+		std::vector<std::vector<uint8_t>> tiles(numTiles);
+		const ExrJob exrJob{ job.pixels.data(), job.width, job.height, numTilesX, isHalf, &tiles };
+		m_pExecutor->ParallelFor(numTiles, [&exrJob](uint32_t tileIndex) {
+			EncodeExrTile(exrJob, tileIndex);
+		});
+
+		//Magic number, version 2 with the single part tiled flag
+		file.insert(file.end(), { 0x76, 0x2f, 0x31, 0x01, 0x02, 0x02, 0x00, 0x00 });
+
+		//Attributes: name, type, size and value
+		const auto appendAttribute{ [&file](const char* name, const char* type, const std::vector<uint8_t>& value) {
+			AppendString(file, name);
+			AppendString(file, type);
+			AppendLittleEndian(file, static_cast<int32_t>(value.size()));
+			file.insert(file.end(), value.begin(), value.end());
+		} };
+
+		std::vector<uint8_t> value{};
+		for (const char* channel : { "B", "G", "R" })
+		{
+			AppendString(value, channel);
+			//Pixel type (1 half, 2 float), linear flag and padding, x and y sampling
+			AppendLittleEndian(value, int32_t{ isHalf ? 1 : 2 });
+			value.insert(value.end(), { 0, 0, 0, 0 });
+			AppendLittleEndian(value, int32_t{ 1 });
+			AppendLittleEndian(value, int32_t{ 1 });
+		}
+		value.push_back(0);
+		appendAttribute("channels", "chlist", value);
+
+		//Zip, per tile
+		appendAttribute("compression", "compression", { 3 });
+
+		value.clear();
+		AppendLittleEndian(value, int32_t{ 0 });
+		AppendLittleEndian(value, int32_t{ 0 });
+		AppendLittleEndian(value, static_cast<int32_t>(job.width - 1));
+		AppendLittleEndian(value, static_cast<int32_t>(job.height - 1));
+		appendAttribute("dataWindow", "box2i", value);
+		appendAttribute("displayWindow", "box2i", value);
+
+		//Increasing y
+		appendAttribute("lineOrder", "lineOrder", { 0 });
+
+		value.clear();
+		AppendLittleEndian(value, 1.f);
+		appendAttribute("pixelAspectRatio", "float", value);
+
+		value.clear();
+		AppendLittleEndian(value, 0.f);
+		AppendLittleEndian(value, 0.f);
+		appendAttribute("screenWindowCenter", "v2f", value);
+
+		value.clear();
+		AppendLittleEndian(value, 1.f);
+		appendAttribute("screenWindowWidth", "float", value);
+
+		//Tile size, a single level rounded down
+		value.clear();
+		AppendLittleEndian(value, static_cast<uint32_t>(ExrTileSize));
+		AppendLittleEndian(value, static_cast<uint32_t>(ExrTileSize));
+		value.push_back(0);
+		appendAttribute("tiles", "tiledesc", value);
+		file.push_back(0);
+
+		//Offset of every tile in the file, row by row, then the tiles in the same order
+		uint64_t offset{ file.size() + numTiles * sizeof(uint64_t) };
+		for (const std::vector<uint8_t>& tile : tiles)
+		{
+			AppendLittleEndian(file, offset);
+			offset += tile.size();
+		}
+		for (const std::vector<uint8_t>& tile : tiles)
+		{
+			file.insert(file.end(), tile.begin(), tile.end());
+		}
+	}
+}
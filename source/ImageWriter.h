@@ -0,0 +1,91 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ColorRGB.h"
+
+namespace dae
+{
+	class Executor;
+
+	enum class ImageFormat
+	{
+		//8 bit RGB, clamped like the window
+		Png,
+		//Tiled, zip compressed, linear color
+		ExrHalf,
+		ExrFloat
+	};
+
+	//Outcome of a queued write, see ImageWriter::PopResult
+	struct ImageWriteResult
+	{
+		std::string path{};
+		bool isSaved{};
+	};
+
+	/**
+	 * \brief Encodes and saves images on an I/O thread of its own, so saving never stalls the frame loop.
+	 * The stripes of a PNG and the tiles of an EXR are compressed in parallel.
+	 */
+	class ImageWriter final
+	{
+	public:
+		/**
+		 * \param numThreads Threads compressing an image, the I/O thread included. 0 uses a quarter of the hardware threads,
+		 * so a write leaves most of them to rendering
+		 */
+		ImageWriter(uint32_t numThreads = 0);
+		//Finishes every queued write
+		~ImageWriter();
+
+		ImageWriter(const ImageWriter&) = delete;
+		ImageWriter(ImageWriter&&) noexcept = delete;
+		ImageWriter& operator=(const ImageWriter&) = delete;
+		ImageWriter& operator=(ImageWriter&&) noexcept = delete;
+
+		/**
+		 * \brief Queues the image for writing and returns right away
+		 * \param pixels Width * height linear colors, row by row from the top
+		 */
+		void Write(const std::string& path, ImageFormat format, int width, int height, std::vector<ColorRGB> pixels);
+		//Waits until every queued image was written
+		void Flush();
+		//Takes the result of the oldest finished write, false when there is none
+		bool PopResult(ImageWriteResult& result);
+
+		//Png, or ExrHalf for paths ending in .exr
+		static ImageFormat GetFormat(const std::string& path);
+
+	private:
+		struct Job
+		{
+			std::string path{};
+			ImageFormat format{};
+			int width{};
+			int height{};
+			std::vector<ColorRGB> pixels{};
+		};
+
+		void WriteLoop();
+		bool WriteImage(const Job& job);
+		void EncodePng(const Job& job, std::vector<uint8_t>& file);
+		void EncodeExr(const Job& job, std::vector<uint8_t>& file);
+
+		Executor* m_pExecutor{};
+		std::thread m_Thread{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_StateChanged{};
+		//Guarded by m_Mutex
+		std::deque<Job> m_Jobs{};
+		std::deque<ImageWriteResult> m_Results{};
+		bool m_IsWriting{ false };
+		bool m_IsStopping{ false };
+	};
+}
@@ -1,4 +1,6 @@
 #pragma once
+#include <algorithm>
+
 #include "Math.h"
 #include "DataTypes.h"
 #include "BRDFs.h"
@@ -26,6 +28,39 @@ namespace dae
 		 * \return color
 		 */
 		virtual ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) = 0;
+
+		/**
+		 * \brief Evaluates Shade for all lights reaching one hit at once
+		 * \param hitRecord current hitrecord
+		 * \param pL light directions, one per light
+		 * \param count number of lights
+		 * \param v view direction
+		 * \param pColors output, one color per light
+		 */
+		virtual void ShadeLights(const HitRecord& hitRecord, const Vector3* pL, int count, const Vector3& v, ColorRGB* pColors)
+		{
+			for (int i{ 0 }; i < count; ++i)
+			{
+				pColors[i] = Shade(hitRecord, pL[i], v);
+			}
+		}
+
+		/**
+		 * \brief Base color of the material, used as a guide buffer by the denoiser
+		 */
+		virtual ColorRGB GetAlbedo() const = 0;
+
+		/**
+		 * \brief Folds every parameter the material was constructed with into hash, see Scene::GetContentHash
+		 * \return hash after the parameters
+		 */
+		virtual uint64_t HashParameters(uint64_t hash) const = 0;
+
+	protected:
+		static uint64_t HashColor(uint64_t hash, const ColorRGB& color)
+		{
+			return HashFloat(HashFloat(HashFloat(hash, color.r), color.g), color.b);
+		}
 	};
 #pragma endregion
 
@@ -44,6 +79,16 @@ namespace dae
 			return m_Color;
 		}
 
+		ColorRGB GetAlbedo() const override
+		{
+			return m_Color;
+		}
+
+		uint64_t HashParameters(uint64_t hash) const override
+		{
+			return HashColor(hash, m_Color);
+		}
+
 	private:
 		ColorRGB m_Color{ colors::White };
 	};
@@ -56,16 +101,35 @@ namespace dae
 	{
 	public:
 		Material_Lambert(const ColorRGB& diffuseColor, float diffuseReflectance) :
-			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(diffuseReflectance) {}
+			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(diffuseReflectance),
+			m_Diffuse(BRDF::Lambert(diffuseReflectance, diffuseColor)) {}
 
 		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
 		{
-			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor);
+			return m_Diffuse;
+		}
+
+		void ShadeLights(const HitRecord& /*hitRecord*/, const Vector3* /*pL*/, int count, const Vector3& /*v*/, ColorRGB* pColors) override
+		{
+			std::fill(pColors, pColors + count, m_Diffuse);
+		}
+
+		ColorRGB GetAlbedo() const override
+		{
+			return m_DiffuseColor;
+		}
+
+		uint64_t HashParameters(uint64_t hash) const override
+		{
+			return HashFloat(HashColor(hash, m_DiffuseColor), m_DiffuseReflectance);
 		}
 
 	private:
 		ColorRGB m_DiffuseColor{ colors::White };
 		float m_DiffuseReflectance{ 1.f }; //kd
+
+		//Baked at construction
+		ColorRGB m_Diffuse{};
 	};
 #pragma endregion
 
@@ -77,13 +141,32 @@ namespace dae
 	public:
 		Material_LambertPhong(const ColorRGB& diffuseColor, float kd, float ks, float phongExponent) :
 			m_DiffuseColor(diffuseColor), m_DiffuseReflectance(kd), m_SpecularReflectance(ks),
-			m_PhongExponent(phongExponent)
+			m_PhongExponent(phongExponent),
+			m_Diffuse(BRDF::Lambert(kd, diffuseColor))
 		{
+			//Whole exponents skip powf
+			if (phongExponent >= 0.f && floorf(phongExponent) == phongExponent)
+				m_IntegerPhongExponent = static_cast<int>(phongExponent);
 		}
 
 		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
 		{
-			return BRDF::Lambert(m_DiffuseReflectance, m_DiffuseColor) + BRDF::Phong(m_SpecularReflectance, m_PhongExponent, l, -v, hitRecord.normal);
+			const ColorRGB& diffuse{ m_Diffuse };
+			if (m_IntegerPhongExponent >= 0)
+				return diffuse + BRDF::Phong(m_SpecularReflectance, m_IntegerPhongExponent, l, -v, hitRecord.normal);
+
+			return diffuse + BRDF::Phong(m_SpecularReflectance, m_PhongExponent, l, -v, hitRecord.normal);
+		}
+
+		ColorRGB GetAlbedo() const override
+		{
+			return m_DiffuseColor;
+		}
+
+		uint64_t HashParameters(uint64_t hash) const override
+		{
+			hash = HashFloat(HashColor(hash, m_DiffuseColor), m_DiffuseReflectance);
+			return HashFloat(HashFloat(hash, m_SpecularReflectance), m_PhongExponent);
 		}
 
 	private:
@@ -91,6 +174,10 @@ namespace dae
 		float m_DiffuseReflectance{ 0.5f }; //kd
 		float m_SpecularReflectance{ 0.5f }; //ks
 		float m_PhongExponent{ 1.f }; //Phong Exponent
+
+		//Baked at construction
+		ColorRGB m_Diffuse{};
+		int m_IntegerPhongExponent{ -1 };
 	};
 #pragma endregion
 
@@ -101,45 +188,128 @@ namespace dae
 	public:
 		Material_CookTorrence(const ColorRGB& albedo, float metalness, float roughness) :
 			m_Albedo(albedo), m_Metalness(metalness), m_Roughness(roughness)
-		{}
+		{
+			//Everything that only depends on the material parameters is baked here instead of per Shade call
+			const float a{ Square(m_Roughness) };
+			m_Alpha2 = Square(a);
+			m_K = BRDF::GetSchlickGGX_K(m_Alpha2);
+
+			//Determine F0 value (0.04, 0.04, 0.04) or Albedo based on Metalness
+			m_F0 = (m_Metalness <= 0.f) ? ColorRGB(0.04f, 0.04f, 0.04f) : albedo;
+			m_IsDielectric = m_Metalness == 0.f;
+			m_DiffuseAlbedo = albedo * INV_PI;
+		}
 
 		ColorRGB Shade(const HitRecord& hitRecord = {}, const Vector3& l = {}, const Vector3& v = {}) override
 		{
-			float a{ Square(m_Roughness) };
 			if (m_Roughness <= 0.f) return ColorRGB{1,0,0};
-			//Determine F0 value (0.04, 0.04, 0.04) or Albedo based on Metalness
-			ColorRGB f0 = (m_Metalness <= 0.f) ? ColorRGB(0.04f, 0.04f, 0.04f) : m_Albedo;
-			
+
 			//Calculate half vector between view direction and light direction
 			Vector3 halfVector{ (v + -l).Normalized() };
 
 			//Calculate Fresnel(F)
-			ColorRGB F{ BRDF::FresnelFunction_Schlick(halfVector, v, f0) };
+			const ColorRGB F{ BRDF::FresnelFunction_Schlick(halfVector, v, m_F0) };
 			
 			//Calculate Normal Distribution(D)
-			float D{ BRDF::NormalDistribution_GGX(-hitRecord.normal, halfVector, a) };
+			float D{ BRDF::NormalDistribution_GGX_Alpha2(-hitRecord.normal, halfVector, m_Alpha2) };
 
 			//Calculate Geometry(G)
-			float G{ BRDF::GeometryFunction_Smith(-hitRecord.normal, v, -l, a) };
+			float G{ BRDF::GeometryFunction_Smith_K(-hitRecord.normal, v, -l, m_K) };
 
 			//Calculate specular = > Cook - Torrance (DFG) / 4(dot(v, n)dot(l, n))
-			ColorRGB specular{ ColorRGB(D * F * G) / (4.f * Vector3::Dot(v, hitRecord.normal) * Vector3::Dot(-l, hitRecord.normal)) };
-
-			//Determine kd -> 1 - Fresnel, cancel out if its a metal(kd = 0)
-			ColorRGB kd{};
-			m_Metalness == 0 ? kd = ColorRGB(1,1,1) - F : kd = ColorRGB(0,0,0);
+			ColorRGB specular{ F * (D * G / (4.f * Vector3::Dot(v, hitRecord.normal) * Vector3::Dot(-l, hitRecord.normal))) };
 
-			//Calculate Diffuse = > BRDF::Lambert using the kd
-			ColorRGB diffuse{ BRDF::Lambert(kd, m_Albedo) };
+			//Calculate Diffuse = > Lambert with kd = 1 - Fresnel, cancel out if it's a metal(kd = 0)
+			ColorRGB diffuse{ m_IsDielectric ? (ColorRGB(1,1,1) - F) * m_DiffuseAlbedo : ColorRGB(0,0,0) };
 
 			//Return final color->diffuse + specular
 			return diffuse + specular;
 		}
 
+		//Same terms as Shade, evaluated for LaneCount lights at a time on structure-of-arrays data so the loop vectorizes
+		void ShadeLights(const HitRecord& hitRecord, const Vector3* pL, int count, const Vector3& v, ColorRGB* pColors) override
+		{
+			if (m_Roughness <= 0.f)
+			{
+				std::fill(pColors, pColors + count, ColorRGB{ 1,0,0 });
+				return;
+			}
+
+			const Vector3& n{ hitRecord.normal };
+			const ColorRGB& f0{ m_F0 };
+			const ColorRGB& diffuseAlbedo{ m_DiffuseAlbedo };
+
+			//View term of Smith is the same for every light
+			const float dotNV{ -Vector3::Dot(n, v) };
+			const float Gv{ dotNV < 0.f ? 0.f : dotNV / (dotNV * (1 - m_K) + m_K) };
+
+			for (int first{ 0 }; first < count; first += LaneCount)
+			{
+				const int lanes{ std::min(LaneCount, count - first) };
+				float fresnel[LaneCount];
+				float specular[LaneCount];
+
+				for (int i{ 0 }; i < lanes; ++i)
+				{
+					const Vector3& l{ pL[first + i] };
+
+					float hx{ v.x - l.x };
+					float hy{ v.y - l.y };
+					float hz{ v.z - l.z };
+					const float invLength{ 1.f / sqrtf(hx * hx + hy * hy + hz * hz) };
+					hx *= invLength;
+					hy *= invLength;
+					hz *= invLength;
+
+					//F (Schlick), the color part is applied below
+					const float x{ 1.f - (hx * v.x + hy * v.y + hz * v.z) };
+					const float x2{ x * x };
+					fresnel[i] = x2 * x2 * x;
+
+					//D (GGX)
+					const float dotNH{ -(n.x * hx + n.y * hy + n.z * hz) };
+					const float d{ dotNH * dotNH * (m_Alpha2 - 1.f) + 1.f };
+					const float D{ m_Alpha2 * INV_PI / (d * d) };
+
+					//G (Smith), light term
+					const float dotNL{ n.x * l.x + n.y * l.y + n.z * l.z };
+					const float Gl{ dotNL < 0.f ? 0.f : dotNL / (dotNL * (1.f - m_K) + m_K) };
+
+					specular[i] = D * Gv * Gl / (4.f * dotNV * dotNL);
+				}
+
+				for (int i{ 0 }; i < lanes; ++i)
+				{
+					const ColorRGB F{ f0 + (ColorRGB(1, 1, 1) - f0) * fresnel[i] };
+					const ColorRGB diffuse{ m_IsDielectric ? (ColorRGB(1, 1, 1) - F) * diffuseAlbedo : ColorRGB(0, 0, 0) };
+					pColors[first + i] = diffuse + F * specular[i];
+				}
+			}
+		}
+
+		ColorRGB GetAlbedo() const override
+		{
+			return m_Albedo;
+		}
+
+		uint64_t HashParameters(uint64_t hash) const override
+		{
+			return HashFloat(HashFloat(HashColor(hash, m_Albedo), m_Metalness), m_Roughness);
+		}
+
 	private:
 		ColorRGB m_Albedo{ 0.955f, 0.637f, 0.538f }; //Copper
 		float m_Metalness{ 1.0f };
 		float m_Roughness{ 0.1f }; // [1.0 > 0.0] >> [ROUGH > SMOOTH]
+
+		static constexpr int LaneCount{ 8 };
+
+		//Baked at construction
+		float m_Alpha2{}; //squared(squared(roughness))
+		float m_K{}; //Schlick GGX remapping of m_Alpha2
+		ColorRGB m_F0{};
+		ColorRGB m_DiffuseAlbedo{}; //albedo / PI
+		bool m_IsDielectric{ true };
 	};
 #pragma endregion
 
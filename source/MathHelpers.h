@@ -1,5 +1,7 @@
 #pragma once
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <limits>
 
 namespace dae
@@ -10,6 +12,7 @@ namespace dae
 	constexpr auto PI_DIV_4 = 0.785398163397448309616f;
 	constexpr auto PI_2 = 6.283185307179586476925f;
 	constexpr auto PI_4 = 12.56637061435917295385f;
+	constexpr auto INV_PI = 0.318309886183790671538f;
 
 	constexpr auto TO_DEGREES = (180.0f / PI);
 	constexpr auto TO_RADIANS(PI / 180.0f);
@@ -19,6 +22,19 @@ namespace dae
 		return a * a;
 	}
 
+	//x^exponent for a non-negative integer exponent, by repeated squaring
+	inline float PowInt(float x, int exponent)
+	{
+		float result{ 1.f };
+		while (exponent > 0)
+		{
+			if (exponent & 1) result *= x;
+			x *= x;
+			exponent >>= 1;
+		}
+		return result;
+	}
+
 	inline float Lerpf(float a, float b, float factor)
 	{
 		return ((1 - factor) * a) + (factor * b);
@@ -28,4 +44,34 @@ namespace dae
 	{
 		return abs(a - b) < epsilon;
 	}
+
+	//FNV-1a over 32 bit words, for content hashes that only have to match within the same build
+	constexpr uint64_t HashOffsetBasis{ 14695981039346656037ull };
+
+	inline uint64_t HashWord(uint64_t hash, uint32_t word)
+	{
+		return (hash ^ word) * 1099511628211ull;
+	}
+
+	inline uint64_t HashFloat(uint64_t hash, float value)
+	{
+		uint32_t word{};
+		std::memcpy(&word, &value, sizeof(word));
+		return HashWord(hash, word);
+	}
+
+	//PCG hash, used to seed and advance per-pixel random sequences
+	inline uint32_t PcgHash(uint32_t input)
+	{
+		const uint32_t state{ input * 747796405u + 2891336453u };
+		const uint32_t word{ ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u };
+		return (word >> 22u) ^ word;
+	}
+
+	//Returns a float in [0,1) and advances the seed
+	inline float RandomFloat(uint32_t& seed)
+	{
+		seed = PcgHash(seed);
+		return static_cast<float>(seed >> 8) * (1.f / 16777216.f);
+	}
 }
\ No newline at end of file
@@ -55,6 +55,40 @@ namespace dae {
 		};
 	}
 
+	void Matrix::TransformPoints(const Vector3* pIn, Vector3* pOut, size_t count) const
+	{
+		//Elements copied to locals so they can't alias pOut, which keeps the loop vectorizable
+		const float m00{ data[0].x }, m01{ data[0].y }, m02{ data[0].z };
+		const float m10{ data[1].x }, m11{ data[1].y }, m12{ data[1].z };
+		const float m20{ data[2].x }, m21{ data[2].y }, m22{ data[2].z };
+		const float m30{ data[3].x }, m31{ data[3].y }, m32{ data[3].z };
+		for (size_t i{ 0 }; i < count; ++i)
+		{
+			const float x{ pIn[i].x };
+			const float y{ pIn[i].y };
+			const float z{ pIn[i].z };
+			pOut[i].x = m00 * x + m10 * y + m20 * z + m30;
+			pOut[i].y = m01 * x + m11 * y + m21 * z + m31;
+			pOut[i].z = m02 * x + m12 * y + m22 * z + m32;
+		}
+	}
+
+	void Matrix::TransformVectors(const Vector3* pIn, Vector3* pOut, size_t count) const
+	{
+		const float m00{ data[0].x }, m01{ data[0].y }, m02{ data[0].z };
+		const float m10{ data[1].x }, m11{ data[1].y }, m12{ data[1].z };
+		const float m20{ data[2].x }, m21{ data[2].y }, m22{ data[2].z };
+		for (size_t i{ 0 }; i < count; ++i)
+		{
+			const float x{ pIn[i].x };
+			const float y{ pIn[i].y };
+			const float z{ pIn[i].z };
+			pOut[i].x = m00 * x + m10 * y + m20 * z;
+			pOut[i].y = m01 * x + m11 * y + m21 * z;
+			pOut[i].z = m02 * x + m12 * y + m22 * z;
+		}
+	}
+
 	const Matrix& Matrix::Transpose()
 	{
 		Matrix result{};
@@ -1,4 +1,6 @@
 #pragma once
+#include <cstddef>
+
 #include "Vector3.h"
 #include "Vector4.h"
 
@@ -24,6 +26,9 @@ namespace dae {
 		Vector3 TransformVector(float x, float y, float z) const;
 		Vector3 TransformPoint(const Vector3& p) const;
 		Vector3 TransformPoint(float x, float y, float z) const;
+		//Batched versions of TransformPoint and TransformVector, pIn and pOut may point to the same array
+		void TransformPoints(const Vector3* pIn, Vector3* pOut, size_t count) const;
+		void TransformVectors(const Vector3* pIn, Vector3* pOut, size_t count) const;
 		const Matrix& Transpose();
 
 		Vector3 GetAxisX() const;
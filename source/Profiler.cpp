@@ -0,0 +1,108 @@
+#include "Profiler.h"
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dae {
+	namespace
+	{
+		std::mutex g_RegistryMutex{};
+		std::vector<std::unique_ptr<Profiler::ThreadEvents>> g_ThreadEvents{};
+		//Guarded by g_RegistryMutex, every thread gets an id of its own even when it reuses the buffer of an exited one
+		uint32_t g_NumThreads{};
+		const std::chrono::steady_clock::time_point g_StartTime{ std::chrono::steady_clock::now() };
+
+		//Gives the event buffer back when its thread exits, its events can be written out until another thread takes it
+		struct ThreadEventsOwner
+		{
+			Profiler::ThreadEvents* pEvents{};
+
+			~ThreadEventsOwner()
+			{
+				std::lock_guard lock{ g_RegistryMutex };
+				pEvents->isInUse = false;
+			}
+		};
+	}
+
+	Profiler::ThreadEvents* Profiler::AcquireThreadEvents()
+	{
+		thread_local ThreadEventsOwner t_Owner{};
+
+		std::lock_guard lock{ g_RegistryMutex };
+		for (const std::unique_ptr<ThreadEvents>& pEvents : g_ThreadEvents)
+		{
+			if (!pEvents->isInUse)
+			{
+				t_Owner.pEvents = pEvents.get();
+				break;
+			}
+		}
+
+		if (!t_Owner.pEvents)
+		{
+			g_ThreadEvents.push_back(std::make_unique<ThreadEvents>());
+			t_Owner.pEvents = g_ThreadEvents.back().get();
+		}
+
+		//A reused buffer drops the name and events of the thread that had it, so they aren't attributed to this one
+		t_Owner.pEvents->threadId = ++g_NumThreads;
+		t_Owner.pEvents->threadName = "Worker " + std::to_string(t_Owner.pEvents->threadId);
+		t_Owner.pEvents->numWritten.store(0, std::memory_order_release);
+		t_Owner.pEvents->isInUse = true;
+		return t_Owner.pEvents;
+	}
+
+	uint64_t Profiler::GetTime()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_StartTime).count();
+	}
+
+	void Profiler::SetThreadName(const std::string& name)
+	{
+		ThreadEvents& thread{ GetThreadEvents() };
+
+		std::lock_guard lock{ g_RegistryMutex };
+		thread.threadName = name;
+	}
+
+	bool Profiler::WriteChromeTrace(const std::string& path)
+	{
+		std::ofstream file{ path };
+		if (!file)
+			return false;
+
+		std::lock_guard lock{ g_RegistryMutex };
+
+		//Timestamps are in microseconds
+		file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+		bool isFirst{ true };
+		for (const std::unique_ptr<ThreadEvents>& pEvents : g_ThreadEvents)
+		{
+			const ThreadEvents& thread{ *pEvents };
+
+			file << (isFirst ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": " << thread.threadId
+				<< ", \"args\": {\"name\": \"" << thread.threadName << "\"}}";
+			isFirst = false;
+
+			const uint64_t numWritten{ thread.numWritten.load(std::memory_order_acquire) };
+			const uint64_t first{ numWritten > ThreadEvents::Capacity ? numWritten - ThreadEvents::Capacity : 0 };
+			for (uint64_t i{ first }; i < numWritten; ++i)
+			{
+				const TraceEvent& event{ thread.events[i % ThreadEvents::Capacity] };
+				file << ",\n{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 0, \"tid\": " << thread.threadId
+					<< ", \"ts\": " << event.start / 1000 << "." << (event.start % 1000) / 100
+					<< ", \"dur\": " << event.duration / 1000 << "." << (event.duration % 1000) / 100;
+				if (event.argument >= 0)
+					file << ", \"args\": {\"index\": " << event.argument << "}";
+				file << "}";
+			}
+		}
+		file << "\n]}\n";
+
+		return file.good();
+	}
+}
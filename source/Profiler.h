@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+//Set to 0 to compile every profiler zone out
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+namespace dae
+{
+	namespace Profiler
+	{
+		struct TraceEvent
+		{
+			//Has to be a string literal, only the pointer is stored
+			const char* name{};
+			uint64_t start{};
+			uint64_t duration{};
+			int64_t argument{ -1 };
+		};
+
+		//Ring buffer of the zones of one thread, only written by that thread. Old events are overwritten.
+		struct ThreadEvents
+		{
+			static constexpr uint32_t Capacity{ 1 << 16 };
+
+			TraceEvent events[Capacity]{};
+			std::atomic<uint64_t> numWritten{};
+			uint32_t threadId{};
+			std::string threadName{};
+			bool isInUse{ false };
+		};
+
+		//Hands out a free event buffer, which goes back to the pool when the calling thread exits
+		ThreadEvents* AcquireThreadEvents();
+
+		inline ThreadEvents& GetThreadEvents()
+		{
+			thread_local ThreadEvents* t_pEvents{ AcquireThreadEvents() };
+			return *t_pEvents;
+		}
+
+		//Nanoseconds since the profiler started
+		uint64_t GetTime();
+		void SetThreadName(const std::string& name);
+
+		inline void AddEvent(const char* name, uint64_t start, uint64_t end, int64_t argument)
+		{
+			ThreadEvents& thread{ GetThreadEvents() };
+			const uint64_t index{ thread.numWritten.load(std::memory_order_relaxed) };
+			thread.events[index % ThreadEvents::Capacity] = { name, start, end - start, argument };
+			thread.numWritten.store(index + 1, std::memory_order_release);
+		}
+
+		//Zero length event, shown as a marker in the trace
+		inline void AddMarker(const char* name, int64_t argument)
+		{
+			const uint64_t time{ GetTime() };
+			AddEvent(name, time, time, argument);
+		}
+
+		/**
+		 * \brief Writes the recorded zones of all threads as Chrome trace JSON (chrome://tracing, ui.perfetto.dev)
+		 * Should be called while no zones are being recorded, e.g. between frames
+		 */
+		bool WriteChromeTrace(const std::string& path);
+
+		class ScopedZone final
+		{
+		public:
+			ScopedZone(const char* name, int64_t argument = -1) :
+				m_Name(name),
+				m_Argument(argument),
+				m_Start(GetTime())
+			{
+			}
+			~ScopedZone()
+			{
+				AddEvent(m_Name, m_Start, GetTime(), m_Argument);
+			}
+
+			ScopedZone(const ScopedZone&) = delete;
+			ScopedZone(ScopedZone&&) noexcept = delete;
+			ScopedZone& operator=(const ScopedZone&) = delete;
+			ScopedZone& operator=(ScopedZone&&) noexcept = delete;
+
+		private:
+			const char* m_Name{};
+			int64_t m_Argument{};
+			uint64_t m_Start{};
+		};
+	}
+}
+
+#define PROFILER_CONCAT_IMPL(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_IMPL(a, b)
+
+#if PROFILER_ENABLED
+#define PROFILE_SCOPE(name) ::dae::Profiler::ScopedZone PROFILER_CONCAT(profileZone, __LINE__){ name }
+#define PROFILE_SCOPE_ARG(name, argument) ::dae::Profiler::ScopedZone PROFILER_CONCAT(profileZone, __LINE__){ name, static_cast<int64_t>(argument) }
+#define PROFILE_MARKER(name, argument) ::dae::Profiler::AddMarker(name, static_cast<int64_t>(argument))
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_SCOPE_ARG(name, argument) ((void)0)
+#define PROFILE_MARKER(name, argument) ((void)0)
+#endif
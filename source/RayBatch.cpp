@@ -0,0 +1,108 @@
+#include "RayBatch.h"
+
+#include <algorithm>
+
+#include "Scene.h"
+#include "RayStats.h"
+
+namespace dae {
+	//Sort key layout: [light:11][octant:3][morton:30][rayIndex:20]
+	constexpr uint32_t RayIndexBits{ 20 };
+	constexpr uint64_t RayIndexMask{ (1ull << RayIndexBits) - 1 };
+	constexpr uint32_t MaxKeyLightIndex{ (1u << 11) - 1 };
+
+	void ShadowRayBatch::Clear()
+	{
+		m_Rays.clear();
+		m_Keys.clear();
+		m_MinOrigin = Vector3{ FLT_MAX, FLT_MAX, FLT_MAX };
+		m_MaxOrigin = Vector3{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	}
+
+	void ShadowRayBatch::Add(const Ray& ray, uint32_t hitIndex, uint32_t lightIndex, float observedArea)
+	{
+		assert(m_Rays.size() < RayIndexMask && "Too many shadow rays in a single batch");
+
+		m_Rays.push_back({ ray, hitIndex, lightIndex, observedArea, false });
+		m_MinOrigin = Vector3::Min(m_MinOrigin, ray.origin);
+		m_MaxOrigin = Vector3::Max(m_MaxOrigin, ray.origin);
+	}
+
+	void ShadowRayBatch::AddResolved(const Ray& ray, uint32_t hitIndex, uint32_t lightIndex, float observedArea, bool isOccluded)
+	{
+		assert(m_Rays.size() < RayIndexMask && "Too many shadow rays in a single batch");
+
+		ShadowRay& shadowRay{ m_Rays.emplace_back() };
+		shadowRay.ray = ray;
+		shadowRay.hitIndex = hitIndex;
+		shadowRay.lightIndex = lightIndex;
+		shadowRay.observedArea = observedArea;
+		shadowRay.isOccluded = isOccluded;
+		shadowRay.isResolved = true;
+	}
+
+	void ShadowRayBatch::Trace(const Scene* pScene, bool reorder, bool measureCost, const GeometryCandidates* pLightCandidates)
+	{
+		const auto doesHit{ [pScene, pLightCandidates](const ShadowRay& shadowRay) {
+			return pLightCandidates ? pScene->DoesHit(shadowRay.ray, pLightCandidates[shadowRay.lightIndex]) : pScene->DoesHit(shadowRay.ray);
+		} };
+		const auto traceRay{ [&doesHit, measureCost](ShadowRay& shadowRay) {
+			if (!measureCost)
+			{
+				shadowRay.isOccluded = doesHit(shadowRay);
+				return;
+			}
+
+			const uint64_t start{ RayStats::GetThreadCost() };
+			shadowRay.isOccluded = doesHit(shadowRay);
+			shadowRay.cost = static_cast<uint32_t>(RayStats::GetThreadCost() - start);
+		} };
+
+		if (!reorder)
+		{
+			for (ShadowRay& shadowRay : m_Rays)
+			{
+				if (!shadowRay.isResolved)
+					traceRay(shadowRay);
+			}
+			return;
+		}
+
+		//Rays that walk the same geometry run back to back, results are written back in place
+		//so the shading order (and the result) does not depend on the trace order
+		SortKeys();
+		for (const uint64_t key : m_Keys)
+		{
+			traceRay(m_Rays[key & RayIndexMask]);
+		}
+	}
+
+	void ShadowRayBatch::SortKeys()
+	{
+		const Vector3 extent{ m_MaxOrigin - m_MinOrigin };
+		const Vector3 invExtent{
+			extent.x > 0.f ? 1.f / extent.x : 0.f,
+			extent.y > 0.f ? 1.f / extent.y : 0.f,
+			extent.z > 0.f ? 1.f / extent.z : 0.f
+		};
+
+		m_Keys.clear();
+		for (uint32_t i{ 0 }; i < m_Rays.size(); ++i)
+		{
+			if (m_Rays[i].isResolved)
+				continue;
+
+			const Ray& ray{ m_Rays[i].ray };
+			const Vector3 relative{ ray.origin - m_MinOrigin };
+			const Vector3 normalized{ relative.x * invExtent.x, relative.y * invExtent.y, relative.z * invExtent.z };
+
+			const uint64_t light{ std::min(m_Rays[i].lightIndex, MaxKeyLightIndex) };
+			const uint64_t octant{ RayBatchUtils::GetOctant(ray.direction) };
+			const uint64_t morton{ RayBatchUtils::MortonCode(normalized) };
+
+			m_Keys.push_back((light << 53) | (octant << 50) | (morton << RayIndexBits) | i);
+		}
+
+		std::sort(m_Keys.begin(), m_Keys.end());
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+#include "DataTypes.h"
+
+namespace dae
+{
+	class Scene;
+	struct GeometryCandidates;
+
+	namespace RayBatchUtils
+	{
+		//Spread the lower 10 bits of v so there are 2 zero bits between each bit
+		inline uint32_t ExpandBits(uint32_t v)
+		{
+			v &= 0x3ff;
+			v = (v | (v << 16)) & 0x030000ff;
+			v = (v | (v << 8)) & 0x0300f00f;
+			v = (v | (v << 4)) & 0x030c30c3;
+			v = (v | (v << 2)) & 0x09249249;
+			return v;
+		}
+
+		/**
+		 * \param p Point, normalized to [0,1] on every axis
+		 * \return 30-bit Morton code (z-order curve) of the point
+		 */
+		inline uint32_t MortonCode(const Vector3& p)
+		{
+			const uint32_t x{ static_cast<uint32_t>(std::clamp(p.x * 1024.f, 0.f, 1023.f)) };
+			const uint32_t y{ static_cast<uint32_t>(std::clamp(p.y * 1024.f, 0.f, 1023.f)) };
+			const uint32_t z{ static_cast<uint32_t>(std::clamp(p.z * 1024.f, 0.f, 1023.f)) };
+			return (ExpandBits(x) << 2) | (ExpandBits(y) << 1) | ExpandBits(z);
+		}
+
+		//Octant of a direction, one bit per negative axis
+		inline uint32_t GetOctant(const Vector3& direction)
+		{
+			return (direction.x < 0.f ? 4u : 0u) | (direction.y < 0.f ? 2u : 0u) | (direction.z < 0.f ? 1u : 0u);
+		}
+	}
+
+	struct ShadowRay
+	{
+		Ray ray{};
+		uint32_t hitIndex{};
+		uint32_t lightIndex{};
+		float observedArea{};
+		bool isOccluded{ false };
+		//isOccluded is already known (e.g. from the shadow cache), Trace skips the ray
+		bool isResolved{ false };
+		//Intersection work of the trace, only measured on request (see RayStats::GetThreadCost)
+		uint32_t cost{};
+	};
+
+	//Collects the shadow rays of one render tile so they can be traced in a coherent order
+	class ShadowRayBatch final
+	{
+	public:
+		ShadowRayBatch() = default;
+		~ShadowRayBatch() = default;
+
+		ShadowRayBatch(const ShadowRayBatch&) = delete;
+		ShadowRayBatch(ShadowRayBatch&&) noexcept = delete;
+		ShadowRayBatch& operator=(const ShadowRayBatch&) = delete;
+		ShadowRayBatch& operator=(ShadowRayBatch&&) noexcept = delete;
+
+		void Clear();
+		void Add(const Ray& ray, uint32_t hitIndex, uint32_t lightIndex, float observedArea);
+		//Adds a ray whose result is known, so it is shaded in order with the traced ones
+		void AddResolved(const Ray& ray, uint32_t hitIndex, uint32_t lightIndex, float observedArea, bool isOccluded);
+
+		/**
+		 * \brief Traces every unresolved ray in the batch against the scene and stores the result in ShadowRay::isOccluded
+		 * \param reorder Trace the rays sorted by light, direction octant and Morton-coded origin instead of in insertion order
+		 * \param measureCost Store the cost of every ray in ShadowRay::cost
+		 * \param pLightCandidates Geometry the rays of every light can hit, indexed by ShadowRay::lightIndex. nullptr tests the whole scene
+		 */
+		void Trace(const Scene* pScene, bool reorder, bool measureCost = false, const GeometryCandidates* pLightCandidates = nullptr);
+
+		const std::vector<ShadowRay>& GetRays() const { return m_Rays; }
+
+	private:
+		void SortKeys();
+
+		std::vector<ShadowRay> m_Rays{};
+		std::vector<uint64_t> m_Keys{};
+
+		Vector3 m_MinOrigin{};
+		Vector3 m_MaxOrigin{};
+	};
+}
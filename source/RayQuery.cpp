@@ -0,0 +1,511 @@
+#include "RayQuery.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Executor.h"
+#include "RayStats.h"
+
+namespace dae {
+	//Rays of one packet, copied to the stack so the inner loops read contiguous, aligned lanes.
+	//Unused lanes of the last packet get an empty interval and never hit.
+	struct RayQueryScene::Packet
+	{
+		alignas(64) float originX[PacketSize];
+		alignas(64) float originY[PacketSize];
+		alignas(64) float originZ[PacketSize];
+		alignas(64) float directionX[PacketSize];
+		alignas(64) float directionY[PacketSize];
+		alignas(64) float directionZ[PacketSize];
+		alignas(64) float tMin[PacketSize];
+		alignas(64) float tMax[PacketSize];
+		uint32_t count{};
+	};
+
+	namespace
+	{
+		//Mesh AABB slab test of every lane, same rules as GeometryUtils::SlabTest_TriangleMesh
+		uint32_t SlabTestPacket(const Vector3& minAABB, const Vector3& maxAABB, const float* originX, const float* originY, const float* originZ,
+			const float* directionX, const float* directionY, const float* directionZ, uint32_t numLanes, uint32_t* pIsInside)
+		{
+			uint32_t numInside{};
+			for (uint32_t i{}; i < numLanes; ++i)
+			{
+				const float tx1{ (minAABB.x - originX[i]) / directionX[i] };
+				const float tx2{ (maxAABB.x - originX[i]) / directionX[i] };
+				float tNear{ std::min(tx1, tx2) };
+				float tFar{ std::max(tx1, tx2) };
+
+				const float ty1{ (minAABB.y - originY[i]) / directionY[i] };
+				const float ty2{ (maxAABB.y - originY[i]) / directionY[i] };
+				tNear = std::max(tNear, std::min(ty1, ty2));
+				tFar = std::min(tFar, std::max(ty1, ty2));
+
+				const float tz1{ (minAABB.z - originZ[i]) / directionZ[i] };
+				const float tz2{ (maxAABB.z - originZ[i]) / directionZ[i] };
+				tNear = std::max(tNear, std::min(tz1, tz2));
+				tFar = std::min(tFar, std::max(tz1, tz2));
+
+				pIsInside[i] = (tFar > 0.f) & (tFar >= tNear);
+				numInside += pIsInside[i];
+			}
+			return numInside;
+		}
+	}
+
+	uint32_t RayQueryScene::AddSphere(const Sphere& sphere)
+	{
+		m_SphereX.push_back(sphere.origin.x);
+		m_SphereY.push_back(sphere.origin.y);
+		m_SphereZ.push_back(sphere.origin.z);
+		m_SphereRadiusSquared.push_back(Square(sphere.radius));
+		m_SphereMaterials.push_back(sphere.materialIndex);
+		return static_cast<uint32_t>(m_SphereX.size()) - 1;
+	}
+
+	uint32_t RayQueryScene::AddPlane(const Plane& plane)
+	{
+		m_PlaneX.push_back(plane.origin.x);
+		m_PlaneY.push_back(plane.origin.y);
+		m_PlaneZ.push_back(plane.origin.z);
+		m_PlaneNormalX.push_back(plane.normal.x);
+		m_PlaneNormalY.push_back(plane.normal.y);
+		m_PlaneNormalZ.push_back(plane.normal.z);
+		m_PlaneMaterials.push_back(plane.materialIndex);
+		return static_cast<uint32_t>(m_PlaneX.size()) - 1;
+	}
+
+	uint32_t RayQueryScene::AddTriangleMesh(const TriangleMesh& mesh)
+	{
+		MeshRange range{};
+		range.minAABB = mesh.transformedMinAABB;
+		range.maxAABB = mesh.transformedMaxAABB;
+		range.firstTriangle = GetNumTriangles();
+		range.numTriangles = static_cast<uint32_t>(mesh.indices.size() / 3);
+		range.materialIndex = mesh.materialIndex;
+		switch (mesh.cullMode)
+		{
+		case TriangleCullMode::BackFaceCulling:
+			range.cullSign = 1.f;
+			break;
+		case TriangleCullMode::FrontFaceCulling:
+			range.cullSign = -1.f;
+			break;
+		default:
+			range.cullSign = 0.f;
+			break;
+		}
+
+		for (uint32_t i{}; i < range.numTriangles; ++i)
+		{
+			const Vector3& v0{ mesh.positions[mesh.indices[i * 3]] };
+			const Vector3 edge1{ mesh.positions[mesh.indices[i * 3 + 1]] - v0 };
+			const Vector3 edge2{ mesh.positions[mesh.indices[i * 3 + 2]] - v0 };
+
+			m_TriangleV0X.push_back(v0.x);
+			m_TriangleV0Y.push_back(v0.y);
+			m_TriangleV0Z.push_back(v0.z);
+			m_TriangleEdge1X.push_back(edge1.x);
+			m_TriangleEdge1Y.push_back(edge1.y);
+			m_TriangleEdge1Z.push_back(edge1.z);
+			m_TriangleEdge2X.push_back(edge2.x);
+			m_TriangleEdge2Y.push_back(edge2.y);
+			m_TriangleEdge2Z.push_back(edge2.z);
+		}
+
+		m_Meshes.push_back(range);
+		return static_cast<uint32_t>(m_Meshes.size()) - 1;
+	}
+
+	void RayQueryScene::Clear()
+	{
+		for (std::vector<float>* pArray : { &m_SphereX, &m_SphereY, &m_SphereZ, &m_SphereRadiusSquared,
+			&m_PlaneX, &m_PlaneY, &m_PlaneZ, &m_PlaneNormalX, &m_PlaneNormalY, &m_PlaneNormalZ,
+			&m_TriangleV0X, &m_TriangleV0Y, &m_TriangleV0Z, &m_TriangleEdge1X, &m_TriangleEdge1Y, &m_TriangleEdge1Z,
+			&m_TriangleEdge2X, &m_TriangleEdge2Y, &m_TriangleEdge2Z })
+		{
+			pArray->clear();
+		}
+		m_SphereMaterials.clear();
+		m_PlaneMaterials.clear();
+		m_Meshes.clear();
+	}
+
+	void RayQueryScene::IntersectClosest(const RayQueryBuffer& rays, QueryHit* pHits) const
+	{
+		PROFILE_SCOPE("IntersectClosest");
+		RAY_STAT_ADD(PrimaryRays, rays.count);
+		ForEachPacket(rays, [&](const Packet& packet, uint32_t first)
+			{
+				IntersectClosest(packet, first, pHits);
+			});
+	}
+
+	void RayQueryScene::IntersectAny(const RayQueryBuffer& rays, uint8_t* pOccluded) const
+	{
+		PROFILE_SCOPE("IntersectAny");
+		RAY_STAT_ADD(ShadowRays, rays.count);
+		ForEachPacket(rays, [&](const Packet& packet, uint32_t first)
+			{
+				IntersectAny(packet, first, pOccluded);
+			});
+	}
+
+	void RayQueryScene::ForEachPacket(const RayQueryBuffer& rays, const std::function<void(const Packet&, uint32_t)>& tracePacket) const
+	{
+		const uint32_t numPackets{ (rays.count + PacketSize - 1) / PacketSize };
+		const uint32_t numJobs{ (numPackets + PacketsPerJob - 1) / PacketsPerJob };
+
+		const auto job = [&](uint32_t jobIndex)
+			{
+				PROFILE_SCOPE_ARG("RayQueryJob", jobIndex);
+				Packet packet{};
+				const uint32_t lastPacket{ std::min((jobIndex + 1) * PacketsPerJob, numPackets) };
+				for (uint32_t packetIndex{ jobIndex * PacketsPerJob }; packetIndex < lastPacket; ++packetIndex)
+				{
+					const uint32_t first{ packetIndex * PacketSize };
+					packet.count = std::min(PacketSize, rays.count - first);
+					for (uint32_t i{}; i < PacketSize; ++i)
+					{
+						if (i < packet.count)
+						{
+							const uint32_t ray{ first + i };
+							packet.originX[i] = rays.originX[ray];
+							packet.originY[i] = rays.originY[ray];
+							packet.originZ[i] = rays.originZ[ray];
+							packet.directionX[i] = rays.directionX[ray];
+							packet.directionY[i] = rays.directionY[ray];
+							packet.directionZ[i] = rays.directionZ[ray];
+							packet.tMin[i] = rays.tMin ? rays.tMin[ray] : Ray{}.min;
+							packet.tMax[i] = rays.tMax ? rays.tMax[ray] : Ray{}.max;
+						}
+						else
+						{
+							packet.originX[i] = packet.originY[i] = packet.originZ[i] = 0.f;
+							packet.directionX[i] = packet.directionY[i] = 0.f;
+							packet.directionZ[i] = 1.f;
+							packet.tMin[i] = 0.f;
+							packet.tMax[i] = 0.f;
+						}
+					}
+					tracePacket(packet, first);
+				}
+			};
+
+		if (m_pExecutor && numJobs > 1)
+			m_pExecutor->ParallelFor(numJobs, job);
+		else
+		{
+			for (uint32_t jobIndex{}; jobIndex < numJobs; ++jobIndex)
+				job(jobIndex);
+		}
+	}
+
+	void RayQueryScene::IntersectClosest(const Packet& packet, uint32_t first, QueryHit* pHits) const
+	{
+		//Lane state is kept in 32 bit so every array has the width of the float lanes
+		alignas(64) float closestT[PacketSize];
+		alignas(64) uint32_t closestType[PacketSize];
+		//Index of the sphere or plane, or of the triangle in the flat triangle arrays.
+		//Three selects per hit test at most, more stops the compiler from vectorizing the loops
+		alignas(64) uint32_t closestGeometry[PacketSize];
+		alignas(64) uint32_t isInside[PacketSize];
+		for (uint32_t i{}; i < PacketSize; ++i)
+		{
+			closestT[i] = packet.tMax[i];
+			closestType[i] = static_cast<uint32_t>(QueryGeometryType::None);
+			closestGeometry[i] = 0;
+		}
+
+		const uint32_t numSpheres{ static_cast<uint32_t>(m_SphereX.size()) };
+		for (uint32_t sphere{}; sphere < numSpheres; ++sphere)
+		{
+			const float sphereX{ m_SphereX[sphere] };
+			const float sphereY{ m_SphereY[sphere] };
+			const float sphereZ{ m_SphereZ[sphere] };
+			const float radiusSquared{ m_SphereRadiusSquared[sphere] };
+			for (uint32_t i{}; i < PacketSize; ++i)
+			{
+				const float toCenterX{ sphereX - packet.originX[i] };
+				const float toCenterY{ sphereY - packet.originY[i] };
+				const float toCenterZ{ sphereZ - packet.originZ[i] };
+				const float dp{ toCenterX * packet.directionX[i] + toCenterY * packet.directionY[i] + toCenterZ * packet.directionZ[i] };
+				const float odSquare{ toCenterX * toCenterX + toCenterY * toCenterY + toCenterZ * toCenterZ - dp * dp };
+				//NaN when the ray misses, which fails every comparison below
+				const float t{ dp - std::sqrt(radiusSquared - odSquare) };
+
+				const bool isHit = (odSquare <= radiusSquared) & (t > packet.tMin[i]) & (t < closestT[i]);
+				closestT[i] = isHit ? t : closestT[i];
+				closestType[i] = isHit ? static_cast<uint32_t>(QueryGeometryType::Sphere) : closestType[i];
+				closestGeometry[i] = isHit ? sphere : closestGeometry[i];
+			}
+		}
+
+		const uint32_t numPlanes{ static_cast<uint32_t>(m_PlaneX.size()) };
+		for (uint32_t plane{}; plane < numPlanes; ++plane)
+		{
+			const float planeX{ m_PlaneX[plane] };
+			const float planeY{ m_PlaneY[plane] };
+			const float planeZ{ m_PlaneZ[plane] };
+			const float normalX{ m_PlaneNormalX[plane] };
+			const float normalY{ m_PlaneNormalY[plane] };
+			const float normalZ{ m_PlaneNormalZ[plane] };
+			for (uint32_t i{}; i < PacketSize; ++i)
+			{
+				const float distance{ (planeX - packet.originX[i]) * normalX + (planeY - packet.originY[i]) * normalY + (planeZ - packet.originZ[i]) * normalZ };
+				const float t{ distance / (packet.directionX[i] * normalX + packet.directionY[i] * normalY + packet.directionZ[i] * normalZ) };
+
+				const bool isHit = (t > packet.tMin[i]) & (t < closestT[i]);
+				closestT[i] = isHit ? t : closestT[i];
+				closestType[i] = isHit ? static_cast<uint32_t>(QueryGeometryType::Plane) : closestType[i];
+				closestGeometry[i] = isHit ? plane : closestGeometry[i];
+			}
+		}
+
+		uint64_t numTriangleTests{};
+		const uint32_t numMeshes{ static_cast<uint32_t>(m_Meshes.size()) };
+		for (uint32_t meshIndex{}; meshIndex < numMeshes; ++meshIndex)
+		{
+			const MeshRange& mesh{ m_Meshes[meshIndex] };
+			const uint32_t numInside{ SlabTestPacket(mesh.minAABB, mesh.maxAABB, packet.originX, packet.originY, packet.originZ,
+				packet.directionX, packet.directionY, packet.directionZ, PacketSize, isInside) };
+			if (numInside == 0)
+				continue;
+
+			numTriangleTests += static_cast<uint64_t>(numInside) * mesh.numTriangles;
+			for (uint32_t triangle{}; triangle < mesh.numTriangles; ++triangle)
+			{
+				const uint32_t index{ mesh.firstTriangle + triangle };
+				const float v0X{ m_TriangleV0X[index] };
+				const float v0Y{ m_TriangleV0Y[index] };
+				const float v0Z{ m_TriangleV0Z[index] };
+				const float edge1X{ m_TriangleEdge1X[index] };
+				const float edge1Y{ m_TriangleEdge1Y[index] };
+				const float edge1Z{ m_TriangleEdge1Z[index] };
+				const float edge2X{ m_TriangleEdge2X[index] };
+				const float edge2Y{ m_TriangleEdge2Y[index] };
+				const float edge2Z{ m_TriangleEdge2Z[index] };
+				const float normalX{ edge1Y * edge2Z - edge1Z * edge2Y };
+				const float normalY{ edge1Z * edge2X - edge1X * edge2Z };
+				const float normalZ{ edge1X * edge2Y - edge1Y * edge2X };
+
+				//Moller Trumbore, as in GeometryUtils::HitTest_Triangle
+				for (uint32_t i{}; i < PacketSize; ++i)
+				{
+					const float hX{ packet.directionY[i] * edge2Z - packet.directionZ[i] * edge2Y };
+					const float hY{ packet.directionZ[i] * edge2X - packet.directionX[i] * edge2Z };
+					const float hZ{ packet.directionX[i] * edge2Y - packet.directionY[i] * edge2X };
+					const float f{ 1.f / (edge1X * hX + edge1Y * hY + edge1Z * hZ) };
+
+					const float sX{ packet.originX[i] - v0X };
+					const float sY{ packet.originY[i] - v0Y };
+					const float sZ{ packet.originZ[i] - v0Z };
+					const float u{ f * (sX * hX + sY * hY + sZ * hZ) };
+
+					const float qX{ sY * edge1Z - sZ * edge1Y };
+					const float qY{ sZ * edge1X - sX * edge1Z };
+					const float qZ{ sX * edge1Y - sY * edge1X };
+					const float v{ f * (packet.directionX[i] * qX + packet.directionY[i] * qY + packet.directionZ[i] * qZ) };
+					const float t{ f * (edge2X * qX + edge2Y * qY + edge2Z * qZ) };
+
+					const float facing{ normalX * packet.directionX[i] + normalY * packet.directionY[i] + normalZ * packet.directionZ[i] };
+
+					const bool isHit = (isInside[i] != 0) & (u >= 0.f) & (u <= 1.f) & (v >= 0.f) & (u + v <= 1.f)
+						& (t > packet.tMin[i]) & (t < closestT[i]) & (facing * mesh.cullSign <= 0.f);
+					closestT[i] = isHit ? t : closestT[i];
+					closestType[i] = isHit ? static_cast<uint32_t>(QueryGeometryType::Triangle) : closestType[i];
+					closestGeometry[i] = isHit ? index : closestGeometry[i];
+				}
+			}
+		}
+
+		RAY_STAT_ADD(SphereTests, static_cast<uint64_t>(packet.count) * numSpheres);
+		RAY_STAT_ADD(PlaneTests, static_cast<uint64_t>(packet.count) * numPlanes);
+		RAY_STAT_ADD(AABBTests, static_cast<uint64_t>(packet.count) * numMeshes);
+		RAY_STAT_ADD(TriangleTests, numTriangleTests);
+
+		for (uint32_t i{}; i < packet.count; ++i)
+		{
+			QueryHit& hit{ pHits[first + i] };
+			hit.type = static_cast<QueryGeometryType>(closestType[i]);
+			hit.geometryIndex = closestGeometry[i];
+			hit.primitiveIndex = 0;
+			switch (hit.type)
+			{
+			case QueryGeometryType::Sphere:
+				hit.materialIndex = m_SphereMaterials[hit.geometryIndex];
+				break;
+			case QueryGeometryType::Plane:
+				hit.materialIndex = m_PlaneMaterials[hit.geometryIndex];
+				break;
+			case QueryGeometryType::Triangle:
+			{
+				//Last mesh starting at or before the triangle
+				const auto meshIt{ std::upper_bound(m_Meshes.begin(), m_Meshes.end(), closestGeometry[i],
+					[](uint32_t triangle, const MeshRange& mesh) { return triangle < mesh.firstTriangle; }) - 1 };
+				hit.geometryIndex = static_cast<uint32_t>(meshIt - m_Meshes.begin());
+				hit.primitiveIndex = closestGeometry[i] - meshIt->firstTriangle;
+				hit.materialIndex = meshIt->materialIndex;
+				break;
+			}
+			default:
+				hit.materialIndex = 0;
+				break;
+			}
+			hit.t = hit.type == QueryGeometryType::None ? FLT_MAX : closestT[i];
+		}
+	}
+
+	void RayQueryScene::IntersectAny(const Packet& packet, uint32_t first, uint8_t* pOccluded) const
+	{
+		alignas(64) uint32_t isOccluded[PacketSize];
+		alignas(64) uint32_t isInside[PacketSize];
+		//Padding lanes count as occluded, so a packet is done once all of its real rays are
+		for (uint32_t i{}; i < PacketSize; ++i)
+			isOccluded[i] = i >= packet.count;
+
+		const auto countOccluded = [&]()
+			{
+				uint32_t numOccluded{};
+				for (uint32_t i{}; i < PacketSize; ++i)
+					numOccluded += isOccluded[i];
+				return numOccluded;
+			};
+
+		const auto writeResult = [&]()
+			{
+				for (uint32_t i{}; i < packet.count; ++i)
+					pOccluded[first + i] = static_cast<uint8_t>(isOccluded[i]);
+			};
+
+		const uint32_t numSpheres{ static_cast<uint32_t>(m_SphereX.size()) };
+		for (uint32_t sphere{}; sphere < numSpheres; ++sphere)
+		{
+			const float sphereX{ m_SphereX[sphere] };
+			const float sphereY{ m_SphereY[sphere] };
+			const float sphereZ{ m_SphereZ[sphere] };
+			const float radiusSquared{ m_SphereRadiusSquared[sphere] };
+			for (uint32_t i{}; i < PacketSize; ++i)
+			{
+				const float toCenterX{ sphereX - packet.originX[i] };
+				const float toCenterY{ sphereY - packet.originY[i] };
+				const float toCenterZ{ sphereZ - packet.originZ[i] };
+				const float dp{ toCenterX * packet.directionX[i] + toCenterY * packet.directionY[i] + toCenterZ * packet.directionZ[i] };
+				const float odSquare{ toCenterX * toCenterX + toCenterY * toCenterY + toCenterZ * toCenterZ - dp * dp };
+				//NaN when the ray misses, which fails every comparison below
+				const float t{ dp - std::sqrt(radiusSquared - odSquare) };
+
+				isOccluded[i] |= (odSquare <= radiusSquared) & (t > packet.tMin[i]) & (t < packet.tMax[i]);
+			}
+		}
+		RAY_STAT_ADD(SphereTests, static_cast<uint64_t>(packet.count) * numSpheres);
+		if (countOccluded() == PacketSize)
+		{
+			writeResult();
+			return;
+		}
+
+		const uint32_t numPlanes{ static_cast<uint32_t>(m_PlaneX.size()) };
+		for (uint32_t plane{}; plane < numPlanes; ++plane)
+		{
+			const float planeX{ m_PlaneX[plane] };
+			const float planeY{ m_PlaneY[plane] };
+			const float planeZ{ m_PlaneZ[plane] };
+			const float normalX{ m_PlaneNormalX[plane] };
+			const float normalY{ m_PlaneNormalY[plane] };
+			const float normalZ{ m_PlaneNormalZ[plane] };
+			for (uint32_t i{}; i < PacketSize; ++i)
+			{
+				const float distance{ (planeX - packet.originX[i]) * normalX + (planeY - packet.originY[i]) * normalY + (planeZ - packet.originZ[i]) * normalZ };
+				const float t{ distance / (packet.directionX[i] * normalX + packet.directionY[i] * normalY + packet.directionZ[i] * normalZ) };
+
+				isOccluded[i] |= (t > packet.tMin[i]) & (t < packet.tMax[i]);
+			}
+		}
+		RAY_STAT_ADD(PlaneTests, static_cast<uint64_t>(packet.count) * numPlanes);
+		if (countOccluded() == PacketSize)
+		{
+			writeResult();
+			return;
+		}
+
+		const uint32_t numMeshes{ static_cast<uint32_t>(m_Meshes.size()) };
+		for (uint32_t meshIndex{}; meshIndex < numMeshes; ++meshIndex)
+		{
+			const MeshRange& mesh{ m_Meshes[meshIndex] };
+			RAY_STAT_ADD(AABBTests, packet.count);
+			SlabTestPacket(mesh.minAABB, mesh.maxAABB, packet.originX, packet.originY, packet.originZ,
+				packet.directionX, packet.directionY, packet.directionZ, PacketSize, isInside);
+
+			//Rays that are already occluded don't need this mesh either
+			uint32_t numActive{};
+			for (uint32_t i{}; i < PacketSize; ++i)
+			{
+				isInside[i] &= isOccluded[i] ^ 1u;
+				numActive += isInside[i];
+			}
+			if (numActive == 0)
+				continue;
+
+			//Same flip of the cull mode as for shadow rays in GeometryUtils::HitTest_Triangle
+			const float cullSign{ -mesh.cullSign };
+			uint32_t triangle{};
+			for (; triangle < mesh.numTriangles; ++triangle)
+			{
+				const uint32_t index{ mesh.firstTriangle + triangle };
+				const float v0X{ m_TriangleV0X[index] };
+				const float v0Y{ m_TriangleV0Y[index] };
+				const float v0Z{ m_TriangleV0Z[index] };
+				const float edge1X{ m_TriangleEdge1X[index] };
+				const float edge1Y{ m_TriangleEdge1Y[index] };
+				const float edge1Z{ m_TriangleEdge1Z[index] };
+				const float edge2X{ m_TriangleEdge2X[index] };
+				const float edge2Y{ m_TriangleEdge2Y[index] };
+				const float edge2Z{ m_TriangleEdge2Z[index] };
+				const float normalX{ edge1Y * edge2Z - edge1Z * edge2Y };
+				const float normalY{ edge1Z * edge2X - edge1X * edge2Z };
+				const float normalZ{ edge1X * edge2Y - edge1Y * edge2X };
+
+				for (uint32_t i{}; i < PacketSize; ++i)
+				{
+					const float hX{ packet.directionY[i] * edge2Z - packet.directionZ[i] * edge2Y };
+					const float hY{ packet.directionZ[i] * edge2X - packet.directionX[i] * edge2Z };
+					const float hZ{ packet.directionX[i] * edge2Y - packet.directionY[i] * edge2X };
+					const float f{ 1.f / (edge1X * hX + edge1Y * hY + edge1Z * hZ) };
+
+					const float sX{ packet.originX[i] - v0X };
+					const float sY{ packet.originY[i] - v0Y };
+					const float sZ{ packet.originZ[i] - v0Z };
+					const float u{ f * (sX * hX + sY * hY + sZ * hZ) };
+
+					const float qX{ sY * edge1Z - sZ * edge1Y };
+					const float qY{ sZ * edge1X - sX * edge1Z };
+					const float qZ{ sX * edge1Y - sY * edge1X };
+					const float v{ f * (packet.directionX[i] * qX + packet.directionY[i] * qY + packet.directionZ[i] * qZ) };
+					const float t{ f * (edge2X * qX + edge2Y * qY + edge2Z * qZ) };
+
+					const float facing{ normalX * packet.directionX[i] + normalY * packet.directionY[i] + normalZ * packet.directionZ[i] };
+
+					isOccluded[i] |= (isInside[i] != 0) & (u >= 0.f) & (u <= 1.f) & (v >= 0.f) & (u + v <= 1.f)
+						& (t > packet.tMin[i]) & (t < packet.tMax[i]) & (facing * cullSign <= 0.f);
+				}
+
+				//Checked once per packet width of triangles, to keep the reduction out of the hot loop
+				if ((triangle + 1) % PacketSize == 0 && countOccluded() == PacketSize)
+				{
+					++triangle;
+					break;
+				}
+			}
+			RAY_STAT_ADD(TriangleTests, static_cast<uint64_t>(numActive) * triangle);
+
+			if (countOccluded() == PacketSize)
+			{
+				writeResult();
+				return;
+			}
+		}
+
+		writeResult();
+	}
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <cfloat>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "DataTypes.h"
+
+namespace dae
+{
+	class Executor;
+
+	//Rays as one array per component (structure of arrays), every array holds count elements
+	struct RayQueryBuffer
+	{
+		const float* originX{};
+		const float* originY{};
+		const float* originZ{};
+		const float* directionX{};
+		const float* directionY{};
+		const float* directionZ{};
+		//Optional, the defaults of Ray are used when null
+		const float* tMin{};
+		const float* tMax{};
+		uint32_t count{};
+	};
+
+	enum class QueryGeometryType : uint8_t
+	{
+		None,
+		Sphere,
+		Plane,
+		Triangle
+	};
+
+	//Closest hit of one ray, type is None on a miss
+	struct QueryHit
+	{
+		float t{ FLT_MAX };
+		//Index of the sphere, plane or mesh in the order they were added
+		uint32_t geometryIndex{};
+		//Triangle within the mesh, 0 for spheres and planes
+		uint32_t primitiveIndex{};
+		MaterialId materialIndex{};
+		QueryGeometryType type{ QueryGeometryType::None };
+	};
+
+	/**
+	 * \brief Geometry copied into flat arrays for batched ray queries. Has no rendering dependencies.
+	 * Rays are traced in packets, every primitive is tested against all rays of a packet in a branchless loop the compiler can vectorize.
+	 * Uses the same hit rules as Scene: the cull mode of a mesh is flipped for any-hit queries, like for shadow rays.
+	 */
+	class RayQueryScene final
+	{
+	public:
+		RayQueryScene() = default;
+		~RayQueryScene() = default;
+
+		RayQueryScene(const RayQueryScene&) = delete;
+		RayQueryScene(RayQueryScene&&) noexcept = delete;
+		RayQueryScene& operator=(const RayQueryScene&) = delete;
+		RayQueryScene& operator=(RayQueryScene&&) noexcept = delete;
+
+		//Geometry is copied, changes to the source afterwards need a Clear and a rebuild
+		uint32_t AddSphere(const Sphere& sphere);
+		uint32_t AddPlane(const Plane& plane);
+		uint32_t AddTriangleMesh(const TriangleMesh& mesh);
+		void Clear();
+
+		//Not owned, queries run on the calling thread when null
+		void SetExecutor(Executor* pExecutor) { m_pExecutor = pExecutor; }
+
+		/**
+		 * \brief Finds the closest hit of every ray
+		 * \param pHits Receives rays.count records
+		 */
+		void IntersectClosest(const RayQueryBuffer& rays, QueryHit* pHits) const;
+		/**
+		 * \brief Checks every ray for any hit, stops testing a packet once all of its rays are occluded
+		 * \param pOccluded Receives rays.count values, 1 when the ray hit something
+		 */
+		void IntersectAny(const RayQueryBuffer& rays, uint8_t* pOccluded) const;
+
+		uint32_t GetNumTriangles() const { return static_cast<uint32_t>(m_TriangleV0X.size()); }
+
+	private:
+		static constexpr uint32_t PacketSize{ 64 };
+		static constexpr uint32_t PacketsPerJob{ 16 };
+
+		struct Packet;
+
+		struct MeshRange
+		{
+			Vector3 minAABB{};
+			Vector3 maxAABB{};
+			uint32_t firstTriangle{};
+			uint32_t numTriangles{};
+			//A triangle is skipped when Dot(normal, direction) * cullSign > 0
+			float cullSign{};
+			MaterialId materialIndex{};
+		};
+
+		//Splits the rays into packets and traces them on the executor, tracePacket gets the packet and the index of its first ray
+		void ForEachPacket(const RayQueryBuffer& rays, const std::function<void(const Packet&, uint32_t)>& tracePacket) const;
+		void IntersectClosest(const Packet& packet, uint32_t first, QueryHit* pHits) const;
+		void IntersectAny(const Packet& packet, uint32_t first, uint8_t* pOccluded) const;
+
+		Executor* m_pExecutor{};
+
+		std::vector<float> m_SphereX{};
+		std::vector<float> m_SphereY{};
+		std::vector<float> m_SphereZ{};
+		std::vector<float> m_SphereRadiusSquared{};
+		std::vector<MaterialId> m_SphereMaterials{};
+
+		std::vector<float> m_PlaneX{};
+		std::vector<float> m_PlaneY{};
+		std::vector<float> m_PlaneZ{};
+		std::vector<float> m_PlaneNormalX{};
+		std::vector<float> m_PlaneNormalY{};
+		std::vector<float> m_PlaneNormalZ{};
+		std::vector<MaterialId> m_PlaneMaterials{};
+
+		//Triangles of all meshes, stored as v0 and the edges v0->v1 and v0->v2
+		std::vector<float> m_TriangleV0X{};
+		std::vector<float> m_TriangleV0Y{};
+		std::vector<float> m_TriangleV0Z{};
+		std::vector<float> m_TriangleEdge1X{};
+		std::vector<float> m_TriangleEdge1Y{};
+		std::vector<float> m_TriangleEdge1Z{};
+		std::vector<float> m_TriangleEdge2X{};
+		std::vector<float> m_TriangleEdge2Y{};
+		std::vector<float> m_TriangleEdge2Z{};
+		std::vector<MeshRange> m_Meshes{};
+	};
+}
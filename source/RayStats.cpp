@@ -0,0 +1,125 @@
+#include "RayStats.h"
+
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace dae {
+	namespace
+	{
+		std::mutex g_RegistryMutex{};
+		std::vector<std::unique_ptr<RayStats::ThreadCounters>> g_ThreadCounters{};
+		//Totals at the previous CollectFrame, counters are never reset so other threads can keep writing
+		RayStatsFrame g_PreviousTotals{};
+
+		//Gives the counter block back when its thread exits, the counts stay in the totals
+		struct ThreadCountersOwner
+		{
+			RayStats::ThreadCounters* pCounters{};
+
+			~ThreadCountersOwner()
+			{
+				std::lock_guard lock{ g_RegistryMutex };
+				pCounters->isInUse = false;
+			}
+		};
+	}
+
+	RayStats::ThreadCounters* RayStats::AcquireThreadCounters()
+	{
+		thread_local ThreadCountersOwner t_Owner{};
+
+		std::lock_guard lock{ g_RegistryMutex };
+		for (const std::unique_ptr<ThreadCounters>& pCounters : g_ThreadCounters)
+		{
+			if (!pCounters->isInUse)
+			{
+				t_Owner.pCounters = pCounters.get();
+				break;
+			}
+		}
+
+		if (!t_Owner.pCounters)
+		{
+			g_ThreadCounters.push_back(std::make_unique<ThreadCounters>());
+			t_Owner.pCounters = g_ThreadCounters.back().get();
+		}
+
+		t_Owner.pCounters->isInUse = true;
+		return t_Owner.pCounters;
+	}
+
+	RayStatsFrame RayStats::CollectFrame()
+	{
+		RayStatsFrame totals{};
+
+		std::lock_guard lock{ g_RegistryMutex };
+		for (const std::unique_ptr<ThreadCounters>& pCounters : g_ThreadCounters)
+		{
+			for (int i{ 0 }; i < static_cast<int>(RayCounter::Count); ++i)
+			{
+				totals.counters[i] += pCounters->counters[i].load(std::memory_order_relaxed);
+			}
+		}
+
+		RayStatsFrame frame{};
+		for (int i{ 0 }; i < static_cast<int>(RayCounter::Count); ++i)
+		{
+			frame.counters[i] = totals.counters[i] - g_PreviousTotals.counters[i];
+		}
+		g_PreviousTotals = totals;
+
+		return frame;
+	}
+
+	const char* RayStats::GetCounterName(RayCounter counter)
+	{
+		switch (counter)
+		{
+		case RayCounter::PrimaryRays:
+			return "primaryRays";
+		case RayCounter::ShadowRays:
+			return "shadowRays";
+		case RayCounter::SphereTests:
+			return "sphereTests";
+		case RayCounter::PlaneTests:
+			return "planeTests";
+		case RayCounter::TriangleTests:
+			return "triangleTests";
+		case RayCounter::AABBTests:
+			return "aabbTests";
+		case RayCounter::Hits:
+			return "hits";
+		case RayCounter::AABBEarlyOuts:
+			return "aabbEarlyOuts";
+		case RayCounter::ShadowEarlyOuts:
+			return "shadowEarlyOuts";
+		default:
+			return "unknown";
+		}
+	}
+
+	void RayStats::Print(const RayStatsFrame& stats)
+	{
+		std::cout << "Ray stats:";
+		for (int i{ 0 }; i < static_cast<int>(RayCounter::Count); ++i)
+		{
+			std::cout << " " << GetCounterName(RayCounter(i)) << "=" << stats.counters[i];
+		}
+		std::cout << std::endl;
+	}
+
+	std::string RayStats::ToJson(const RayStatsFrame& stats)
+	{
+		std::ostringstream json{};
+		json << "{";
+		for (int i{ 0 }; i < static_cast<int>(RayCounter::Count); ++i)
+		{
+			json << (i == 0 ? "" : ", ") << "\"" << GetCounterName(RayCounter(i)) << "\": " << stats.counters[i];
+		}
+		json << "}";
+		return json.str();
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+//Set to 0 to compile every ray counter out of the intersection code
+#ifndef RAY_STATS_ENABLED
+#define RAY_STATS_ENABLED 1
+#endif
+
+namespace dae
+{
+	enum class RayCounter
+	{
+		PrimaryRays,
+		ShadowRays,
+		SphereTests,
+		PlaneTests,
+		TriangleTests,
+		AABBTests,
+		//Primitive tests that returned a hit
+		Hits,
+		//Meshes skipped because the ray missed their AABB
+		AABBEarlyOuts,
+		//Shadow rays that stopped at the first occluder
+		ShadowEarlyOuts,
+
+		Count
+	};
+
+	struct RayStatsFrame
+	{
+		uint64_t counters[static_cast<int>(RayCounter::Count)]{};
+
+		uint64_t Get(RayCounter counter) const { return counters[static_cast<int>(counter)]; }
+	};
+
+	namespace RayStats
+	{
+		//Counters of one thread, only ever written by that thread so increments don't need atomic read-modify-writes.
+		//Cache line aligned so the threads don't share lines
+		struct alignas(64) ThreadCounters
+		{
+			std::atomic<uint64_t> counters[static_cast<int>(RayCounter::Count)]{};
+			bool isInUse{ false };
+		};
+
+		//Hands out a free counter block, which goes back to the pool when the calling thread exits
+		ThreadCounters* AcquireThreadCounters();
+
+		inline ThreadCounters& GetThreadCounters()
+		{
+			thread_local ThreadCounters* t_pCounters{ AcquireThreadCounters() };
+			return *t_pCounters;
+		}
+
+		inline void Increment(RayCounter counter, uint64_t amount = 1)
+		{
+			std::atomic<uint64_t>& value{ GetThreadCounters().counters[static_cast<int>(counter)] };
+			value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+		}
+
+		/**
+		 * \brief Intersection work done by the calling thread so far, the difference between two calls is the cost of the work in between
+		 * \return number of primitive and AABB tests, or nanoseconds when the counters are compiled out
+		 */
+		inline uint64_t GetThreadCost()
+		{
+#if RAY_STATS_ENABLED
+			const ThreadCounters& thread{ GetThreadCounters() };
+			return thread.counters[static_cast<int>(RayCounter::SphereTests)].load(std::memory_order_relaxed)
+				+ thread.counters[static_cast<int>(RayCounter::PlaneTests)].load(std::memory_order_relaxed)
+				+ thread.counters[static_cast<int>(RayCounter::TriangleTests)].load(std::memory_order_relaxed)
+				+ thread.counters[static_cast<int>(RayCounter::AABBTests)].load(std::memory_order_relaxed);
+#else
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+		}
+
+		inline const char* GetCostUnit()
+		{
+			return RAY_STATS_ENABLED ? "tests" : "ns";
+		}
+
+		/**
+		 * \brief Sums the counters of all threads
+		 * \return everything counted since the previous call
+		 */
+		RayStatsFrame CollectFrame();
+
+		const char* GetCounterName(RayCounter counter);
+		void Print(const RayStatsFrame& stats);
+		//Single line JSON object, one member per counter
+		std::string ToJson(const RayStatsFrame& stats);
+	}
+}
+
+#if RAY_STATS_ENABLED
+#define RAY_STAT(counter) ::dae::RayStats::Increment(::dae::RayCounter::counter)
+#define RAY_STAT_ADD(counter, amount) ::dae::RayStats::Increment(::dae::RayCounter::counter, amount)
+#else
+#define RAY_STAT(counter) ((void)0)
+#define RAY_STAT_ADD(counter, amount) ((void)0)
+#endif
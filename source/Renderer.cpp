@@ -9,14 +9,166 @@
 #include "Material.h"
 #include "Scene.h"
 #include "Utils.h"
+#include "RayBatch.h"
+#include "Profiler.h"
+#include "ScratchArena.h"
+#include "AllocationTracker.h"
+#include "Checkpoint.h"
 
-#include <future>
-#include <ppl.h>
-//#define ASYNC
-#define PARALLEL_FOR
+#include <chrono>
 
 using namespace dae;
 
+namespace
+{
+	//Per-pixel state of a render tile, allocated from the scratch arena of the thread
+	struct TileSample
+	{
+		HitRecord hit{};
+		Vector3 viewDirection{};
+		ColorRGB color{};
+		uint32_t cost{};
+		//Not in the pixel subset, filled in after tracing
+		bool isSkipped{};
+		//Color was taken from the shading history, no shadow rays or shading needed
+		bool isReused{};
+		uint8_t historyAge{};
+		//Shadow cache slot of the cell of the hit
+		uint32_t shadowCacheSlot{};
+	};
+
+	//Reused across tiles and frames, only grow
+	thread_local ShadowRayBatch t_ShadowRays{};
+	thread_local GeometryCandidates t_TileCandidates{};
+	thread_local std::vector<GeometryCandidates> t_LightCandidates{};
+
+	//Blue (cheap) over cyan, green and yellow to red (expensive), t in [0,1]
+	ColorRGB GetHeatmapColor(float t)
+	{
+		constexpr int NumStops{ 5 };
+		const ColorRGB stops[NumStops]{ { 0.f, 0.f, 1.f }, { 0.f, 1.f, 1.f }, { 0.f, 1.f, 0.f }, { 1.f, 1.f, 0.f }, { 1.f, 0.f, 0.f } };
+
+		const float position{ std::clamp(t, 0.f, 1.f) * (NumStops - 1) };
+		const int stop{ std::min(static_cast<int>(position), NumStops - 2) };
+		return ColorRGB::Lerp(stops[stop], stops[stop + 1], position - stop);
+	}
+
+	//Gradient strip in the bottom left corner, from 0 to the max cost
+	constexpr int HeatmapLegendWidth{ 256 };
+	constexpr int HeatmapLegendHeight{ 8 };
+	constexpr int HeatmapLegendMargin{ 8 };
+
+	//Pixel that saw position with the given camera, the inverse of the primary ray setup. False when it was behind the camera or off screen
+	bool ReprojectToPixel(const Vector3& position, const Matrix& cameraToWorld, float fov, float aspectRatio, int width, int height, int& pixelIndex)
+	{
+		const Vector3 toPosition{ position - cameraToWorld.GetTranslation() };
+		const float z{ Vector3::Dot(toPosition, cameraToWorld.GetAxisZ()) };
+		if (z <= 0.f)
+			return false;
+
+		const float cx{ Vector3::Dot(toPosition, cameraToWorld.GetAxisX()) / z };
+		const float cy{ Vector3::Dot(toPosition, cameraToWorld.GetAxisY()) / z };
+		const float rx{ (cx / (aspectRatio * fov) + 1.f) * 0.5f * static_cast<float>(width) };
+		const float ry{ (1.f - cy / fov) * 0.5f * static_cast<float>(height) };
+		if (rx < 0.f || ry < 0.f || rx >= static_cast<float>(width) || ry >= static_cast<float>(height))
+			return false;
+
+		pixelIndex = static_cast<int>(rx) + static_cast<int>(ry) * width;
+		return true;
+	}
+
+	//Volume of the primary rays of a tile, grown by a pixel on every side so no ray leaves it through rounding
+	Frustum GetTileFrustum(const TileContext& context, const TileUtils::TileRect& tile, int width, int height)
+	{
+		const auto getDirection{ [&context, width, height](int px, int py) {
+			const float cx{ (2 * (static_cast<float>(px) / static_cast<float>(width)) - 1) * context.aspectRatio * context.fov };
+			const float cy{ (1 - (2 * (static_cast<float>(py) / static_cast<float>(height)))) * context.fov };
+			return context.cameraToWorld.TransformVector(Vector3{ cx, cy, 1 });
+		} };
+
+		const Vector3 corners[4]{
+			getDirection(tile.x - 1, tile.y - 1),
+			getDirection(tile.x + tile.width + 1, tile.y - 1),
+			getDirection(tile.x + tile.width + 1, tile.y + tile.height + 1),
+			getDirection(tile.x - 1, tile.y + tile.height + 1)
+		};
+		const Vector3 center{ corners[0] + corners[2] };
+
+		//A side plane through the camera for every edge, flipped to face the center ray
+		Frustum frustum{};
+		for (int i{ 0 }; i < 4; ++i)
+		{
+			Vector3 normal{ Vector3::Cross(corners[i], corners[(i + 1) % 4]) };
+			if (Vector3::Dot(normal, center) < 0.f)
+				normal = -normal;
+			frustum.AddPlane(normal, context.cameraOrigin);
+		}
+		return frustum;
+	}
+
+	/**
+	 * \brief Fills t_LightCandidates with the geometry the traced shadow rays of every light can hit.
+	 * The rays of a point light stay inside the box around their origins and the light, directional lights keep the whole scene
+	 * \param pBounds Scratch space for two points per light
+	 */
+	void CullShadowGeometry(const Scene& scene, const std::vector<Light>& lights, const std::vector<ShadowRay>& rays, Vector3* pBounds)
+	{
+		if (t_LightCandidates.size() < lights.size())
+			t_LightCandidates.resize(lights.size());
+
+		for (size_t i{ 0 }; i < lights.size(); ++i)
+		{
+			pBounds[i * 2] = Vector3{ FLT_MAX, FLT_MAX, FLT_MAX };
+			pBounds[i * 2 + 1] = Vector3{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		}
+		for (const ShadowRay& shadowRay : rays)
+		{
+			if (shadowRay.isResolved)
+				continue;
+			pBounds[shadowRay.lightIndex * 2] = Vector3::Min(pBounds[shadowRay.lightIndex * 2], shadowRay.ray.origin);
+			pBounds[shadowRay.lightIndex * 2 + 1] = Vector3::Max(pBounds[shadowRay.lightIndex * 2 + 1], shadowRay.ray.origin);
+		}
+
+		for (size_t i{ 0 }; i < lights.size(); ++i)
+		{
+			Vector3 min{ pBounds[i * 2] };
+			Vector3 max{ pBounds[i * 2 + 1] };
+			if (min.x > max.x)
+				continue;
+
+			if (lights[i].type != LightType::Point)
+			{
+				scene.CullGeometry(Frustum{}, t_LightCandidates[i]);
+				continue;
+			}
+
+			//Rays end at the light, the margin covers the ray offset and rounding
+			min = Vector3::Min(min, lights[i].origin);
+			max = Vector3::Max(max, lights[i].origin);
+			const Vector3 extent{ max - min };
+			const float margin{ 0.001f * (1.f + std::max(extent.x, std::max(extent.y, extent.z))) };
+			const Vector3 padding{ margin, margin, margin };
+			scene.CullGeometry(Frustum::FromBox(min - padding, max + padding), t_LightCandidates[i]);
+		}
+	}
+
+	//Depth, normal and material test of a hit against the hit a history pixel was shaded for
+	bool IsSameSurface(const HitRecord& hit, const HitRecord& historyHit)
+	{
+		constexpr float maxRelativeDistance{ 0.02f };
+		constexpr float minNormalCosine{ 0.95f };
+
+		if (!historyHit.didHit || historyHit.materialIndex != hit.materialIndex)
+			return false;
+
+		const float maxDistance{ maxRelativeDistance * hit.t };
+		if ((historyHit.origin - hit.origin).SqrMagnitude() > maxDistance * maxDistance)
+			return false;
+
+		return Vector3::Dot(hit.normal.Normalized(), historyHit.normal.Normalized()) >= minNormalCosine;
+	}
+}
+
 Renderer::Renderer(SDL_Window* pWindow) :
 	m_pWindow(pWindow),
 	m_pBuffer(SDL_GetWindowSurface(pWindow))
@@ -25,104 +177,571 @@ Renderer::Renderer(SDL_Window* pWindow) :
 	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
 	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
 	offset = 0.0001f;
+
+	const size_t numPixels{ static_cast<size_t>(m_Width) * m_Height };
+	m_AccumulationBuffer.resize(numPixels);
+	m_AlbedoBuffer.resize(numPixels);
+	m_CostBuffer.resize(numPixels);
+	m_NormalBuffer.resize(numPixels);
+	m_DepthBuffer.resize(numPixels);
+	m_GBuffer.resize(numPixels);
+	m_PreviousGBuffer.resize(numPixels);
+	m_HistoryColor.resize(numPixels);
+	m_PreviousHistoryColor.resize(numPixels);
+	m_HistoryAge.resize(numPixels);
+	m_PreviousHistoryAge.resize(numPixels);
+
+	m_Denoiser.Resize(m_Width, m_Height);
+	m_Denoiser.SetGuides(m_AlbedoBuffer.data(), m_NormalBuffer.data(), m_DepthBuffer.data());
+
+	SetExecutionBackend(m_ExecutionBackend);
 }
 
-void Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRation, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials) const {
-	const int px = pixelIndex % m_Width;
-	const int py = pixelIndex / m_Width;
+Renderer::~Renderer()
+{
+	delete m_pExecutor;
+	m_pExecutor = nullptr;
+}
+
+void Renderer::SetShadowCacheCellSize(float cellSize)
+{
+	m_pShadowCache.reset();
+	if (cellSize > 0.f)
+		m_pShadowCache = std::make_unique<ShadowCache>(cellSize);
+}
+
+bool Renderer::OpenFrameStream(const std::string& path, StreamFormat format, int framesPerSecond)
+{
+	//The previous stream writes its queued frames first
+	m_pFrameStream.reset();
+	const PixelShifts shifts{ m_pBuffer->format->Rshift, m_pBuffer->format->Gshift, m_pBuffer->format->Bshift };
+	m_pFrameStream = std::make_unique<FrameStream>(path, format, m_Width, m_Height, shifts, framesPerSecond);
+	if (!m_pFrameStream->IsOpen())
+		m_pFrameStream.reset();
+	return m_pFrameStream != nullptr;
+}
+
+void Renderer::RenderTile(const TileContext& context, uint32_t tileIndex) {
+	PROFILE_SCOPE_ARG("RenderTile", tileIndex);
+	if (context.pMovedBounds && !IsTileAffected(context, tileIndex)) {
+		return;
+	}
+
+	const TileUtils::TileRect tile{ TileUtils::GetTileRect(tileIndex, m_Width, m_Height, TileSize) };
+	const Scene* const pScene{ context.pScene };
+	const std::vector<Light>& lights{ *context.pLights };
+	const std::vector<Material*>& materials{ *context.pMaterials };
+
+	//Scratch memory of the tile, given back when the tile is done
+	ScratchArena& arena{ ScratchArena::GetThreadArena() };
+	const ScratchArena::Scope arenaScope{ arena };
+	const uint32_t numSamples{ static_cast<uint32_t>(tile.width * tile.height) };
+	TileSample* const samples{ arena.Allocate<TileSample>(numSamples) };
+	//At most one visible light per shadow ray of a hit
+	const ShadowRay** const visibleRays{ arena.Allocate<const ShadowRay*>(lights.size()) };
+	Vector3* const lightDirections{ arena.Allocate<Vector3>(lights.size()) };
+	ColorRGB* const BRDFs{ arena.Allocate<ColorRGB>(lights.size()) };
+	//Min and max of the shadow ray origins of every light
+	Vector3* const lightBounds{ arena.Allocate<Vector3>(lights.size() * 2) };
+	uint64_t numRays{ 0 };
+
+	const bool measureCost{ m_CurrentLightingMode == LightingMode::Cost };
+	//Cached results are only valid for traced shadows, and would hide the cost of the rays they replace
+	ShadowCache* const pShadowCache{ m_ShadowsEnabled && !measureCost ? m_pShadowCache.get() : nullptr };
+	uint64_t numCachedShadowRays{ 0 };
+
+	//Geometry the primary rays of the tile can hit, culled once the first of them is traced
+	GeometryCandidates& tileCandidates{ t_TileCandidates };
+	bool isTileCulled{ false };
+
+	for (int sample{ 0 }; sample < m_SamplesPerPixel; ++sample)
+	{
+		//The first sample after a reset goes through the pixel center, so a single sample matches the non-progressive image
+		const uint32_t sampleIndex{ m_AccumulatedSamples + sample };
+		const uint32_t sampleSeed{ PcgHash(m_Seed + sampleIndex) };
+		const bool reuseHits{ context.reuseHits && sampleIndex == 0 };
+		const bool useHistory{ context.useHistory && sampleIndex == 0 };
+
+		//Primary rays
+		for (int y{ 0 }; y < tile.height; ++y)
+		{
+			for (int x{ 0 }; x < tile.width; ++x)
+			{
+				TileSample& tileSample{ samples[x + y * tile.width] };
+				const int px{ tile.x + x };
+				const int py{ tile.y + y };
+
+				float jitterX{ 0.5f };
+				float jitterY{ 0.5f };
+				if (sampleIndex > 0)
+				{
+					uint32_t seed{ sampleSeed ^ static_cast<uint32_t>(px + py * m_Width) };
+					jitterX = RandomFloat(seed);
+					jitterY = RandomFloat(seed);
+				}
+
+				float rx{ px + jitterX };
+				float ry{ py + jitterY };
+
+				float cx{ (2 * (rx / static_cast<float>(m_Width)) - 1) * context.aspectRatio * context.fov };
+				float cy{ (1 - (2 * (ry / static_cast<float>(m_Height)))) * context.fov };
 
-	float rx{ px + 0.5f };
-	float ry{ py + 0.5f };
+				Vector3 rayDirection{ cx, cy, 1 };
+				tileSample.viewDirection = context.cameraToWorld.TransformVector(rayDirection.Normalized());
+				tileSample.color = colors::Black;
 
-	float cx{ (2 * (rx / static_cast<float>(m_Width)) - 1) * aspectRation * fov };
-	float cy{ (1-(2 * (ry / static_cast<float>(m_Height)))) * fov };
+				tileSample.isReused = false;
+				tileSample.historyAge = 0;
+				tileSample.isSkipped = !IsTraced(px, py);
+
+				const int pixelIndex{ px + py * m_Width };
+				if (tileSample.isSkipped)
+				{
+					tileSample.hit = HitRecord{};
+				}
+				else if (reuseHits)
+				{
+					tileSample.hit = m_PreviousGBuffer[pixelIndex];
+				}
+				else
+				{
+					if (m_TileCullingEnabled && !isTileCulled)
+					{
+						pScene->CullGeometry(GetTileFrustum(context, tile, m_Width, m_Height), tileCandidates);
+						isTileCulled = true;
+					}
 
-	Vector3 rayDirection{ cx, cy, 1 };
+					tileSample.hit = HitRecord{};
+					Ray viewRay{ context.cameraOrigin, tileSample.viewDirection };
+					const uint64_t costStart{ measureCost ? RayStats::GetThreadCost() : 0 };
+					if (m_TileCullingEnabled)
+						pScene->GetClosestHit(viewRay, tileSample.hit, tileCandidates);
+					else
+						pScene->GetClosestHit(viewRay, tileSample.hit);
+					if (measureCost) {
+						tileSample.cost += static_cast<uint32_t>(RayStats::GetThreadCost() - costStart);
+					}
+					++numRays;
+				}
+				if (sampleIndex == 0) {
+					m_GBuffer[pixelIndex] = tileSample.hit;
+				}
 
-	Matrix camToWorld{ camera.CalculateCameraToWorld() };
-	Vector3 transformedCamera{ camToWorld.TransformVector(rayDirection.Normalized()) };
+				//Reuse the shading of the surface seen by the previous frame, if it is still the same one. The age limit is staggered
+				//over neighbouring pixels so reused pixels don't all expire in the same frame
+				int historyIndex{};
+				if (useHistory && tileSample.hit.didHit
+					&& ReprojectToPixel(tileSample.hit.origin, context.historyCameraToWorld, context.historyFov, context.aspectRatio, m_Width, m_Height, historyIndex)
+					&& m_PreviousHistoryAge[historyIndex] < MaxHistoryAge - (pixelIndex & 3)
+					&& IsSameSurface(tileSample.hit, m_PreviousGBuffer[historyIndex]))
+				{
+					tileSample.color = m_PreviousHistoryColor[historyIndex];
+					tileSample.historyAge = static_cast<uint8_t>(m_PreviousHistoryAge[historyIndex] + 1);
+					tileSample.isReused = true;
+				}
+			}
+		}
 
-	Ray viewRay{ camera.origin, transformedCamera };
-	ColorRGB finalColor{};
+		//Shadow rays, collected for the whole tile so they can be traced in a coherent order
+		ShadowRayBatch& shadowRays{ t_ShadowRays };
+		shadowRays.Clear();
+		uint32_t numResolved{ 0 };
+		for (uint32_t sampleIndexInTile{ 0 }; sampleIndexInTile < numSamples; ++sampleIndexInTile)
+		{
+			TileSample& tileSample{ samples[sampleIndexInTile] };
+			const HitRecord& closestHit{ tileSample.hit };
+			if (!closestHit.didHit || tileSample.isReused) {
+				continue;
+			}
 
-	HitRecord closestHit{};
+			ShadowCache::Visibility cachedVisibility{};
+			if (pShadowCache)
+			{
+				tileSample.shadowCacheSlot = pShadowCache->FindSlot(pShadowCache->GetKey(closestHit.origin, closestHit.normal));
+				cachedVisibility = pShadowCache->GetVisibility(tileSample.shadowCacheSlot);
+			}
+
+			for (uint32_t lightIndex{ 0 }; lightIndex < lights.size(); ++lightIndex)
+			{
+				//check if point we hit can see light
+				//if not, go to next light and skip light calculation
+				Vector3 direction{ LightUtils::GetDirectionToLight(lights[lightIndex], closestHit.origin) };
+				Vector3 normalisedDirection{ direction.Normalized() };
+				float LCL{ Vector3::Dot(closestHit.normal.Normalized(), normalisedDirection) };
+				if (LCL < 0) {
+					continue;
+				}
+
+				Ray lightRay{ closestHit.origin + (closestHit.normal * offset), normalisedDirection, offset, direction.Magnitude() };
+				if (cachedVisibility.IsKnown(lightIndex))
+				{
+					shadowRays.AddResolved(lightRay, sampleIndexInTile, lightIndex, LCL, !cachedVisibility.IsVisible(lightIndex));
+					++numResolved;
+				}
+				else
+				{
+					shadowRays.Add(lightRay, sampleIndexInTile, lightIndex, LCL);
+				}
+			}
+		}
+
+		//shadow
+		if (m_ShadowsEnabled) {
+			PROFILE_SCOPE_ARG("TraceShadowRays", tileIndex);
+			const auto start{ std::chrono::steady_clock::now() };
+			const GeometryCandidates* pLightCandidates{ nullptr };
+			if (m_TileCullingEnabled)
+			{
+				CullShadowGeometry(*pScene, lights, shadowRays.GetRays(), lightBounds);
+				pLightCandidates = t_LightCandidates.data();
+			}
+			shadowRays.Trace(pScene, m_RayReorderingEnabled, measureCost, pLightCandidates);
+			const auto duration{ std::chrono::steady_clock::now() - start };
+			m_ShadowTraceNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+			numRays += shadowRays.GetRays().size() - numResolved;
+		}
+		numCachedShadowRays += numResolved;
 
-	int lightsSize{ static_cast<int>(lights.size()) };
-	pScene->GetClosestHit(viewRay, closestHit);
-	const auto material{ materials[closestHit.materialIndex] };
+		if (pShadowCache) {
+			for (const ShadowRay& shadowRay : shadowRays.GetRays())
+			{
+				if (!shadowRay.isResolved)
+					pShadowCache->Store(samples[shadowRay.hitIndex].shadowCacheSlot, shadowRay.lightIndex, !shadowRay.isOccluded);
+			}
+		}
 
-	if (closestHit.didHit) {
+		if (measureCost && m_ShadowsEnabled) {
+			for (const ShadowRay& shadowRay : shadowRays.GetRays())
+			{
+				samples[shadowRay.hitIndex].cost += shadowRay.cost;
+			}
+		}
 
-		for (const Light& light : lights)
+		//render equation, evaluated in generation order so the result matches the unsorted trace.
+		//The rays of one hit are consecutive, so all visible lights of a hit are shaded in one ShadeLights call
+		const std::vector<ShadowRay>& rays{ shadowRays.GetRays() };
+		for (size_t first{ 0 }; first < rays.size();)
 		{
-			//check if point we hit can see light
-			//if not, go to next lightand skip light calculation
-			Vector3 direction{ LightUtils::GetDirectionToLight(light,closestHit.origin) };
-			Vector3 normalisedDirection{ direction.Normalized() };
-			float LCL{ Vector3::Dot(closestHit.normal.Normalized(), normalisedDirection)};
-			if (LCL < 0) {
+			const uint32_t hitIndex{ rays[first].hitIndex };
+
+			int numVisible{ 0 };
+			for (; first < rays.size() && rays[first].hitIndex == hitIndex; ++first)
+			{
+				if (rays[first].isOccluded) {
+					continue;
+				}
+
+				visibleRays[numVisible] = &rays[first];
+				lightDirections[numVisible] = rays[first].ray.direction;
+				++numVisible;
+			}
+
+			if (numVisible == 0) {
 				continue;
 			}
 
-			Ray lightRay{ closestHit.origin + (closestHit.normal * offset), normalisedDirection, offset, direction.Magnitude() };
+			TileSample& tileSample{ samples[hitIndex] };
+			const HitRecord& closestHit{ tileSample.hit };
+
+			const bool needsBRDF{ m_CurrentLightingMode == LightingMode::BRDF || m_CurrentLightingMode == LightingMode::Combined };
+			if (needsBRDF)
+			{
+				materials[closestHit.materialIndex]->ShadeLights(closestHit, lightDirections, numVisible, tileSample.viewDirection, BRDFs);
+			}
+
+			for (int i{ 0 }; i < numVisible; ++i)
+			{
+				const Light& light{ lights[visibleRays[i]->lightIndex] };
+				const float LCL{ visibleRays[i]->observedArea };
 
-			//shadow
-			if (m_ShadowsEnabled) {
-				if (pScene->DoesHit(lightRay))
+				switch (m_CurrentLightingMode)
 				{
+				case LightingMode::BRDF: {
+					tileSample.color += BRDFs[i];
+					break;
+				}
+				case LightingMode::Radiance: {
+					ColorRGB eRGB{ LightUtils::GetRadiance(light, closestHit.origin) };
+					tileSample.color += eRGB;
+					break;
+				}
+				case LightingMode::ObservedArea: {
+					tileSample.color += ColorRGB(LCL, LCL, LCL);
+					break;
+				}
+				case LightingMode::Cost: {
+					//Shown from m_CostBuffer on resolve
+					break;
+				}
+				case LightingMode::Combined:
+				default: {
+					ColorRGB eRGB{ LightUtils::GetRadiance(light, closestHit.origin) };
+					tileSample.color += eRGB * BRDFs[i] * LCL;
+					break;
+				}
+				}
+			}
+		}
+
+		//Accumulate samples, guide buffers come from the first hit
+		for (int y{ 0 }; y < tile.height; ++y)
+		{
+			for (int x{ 0 }; x < tile.width; ++x)
+			{
+				TileSample& tileSample{ samples[x + y * tile.width] };
+				if (tileSample.isSkipped) {
 					continue;
 				}
+				const int pixelIndex{ (tile.x + x) + ((tile.y + y) * m_Width) };
+
+				tileSample.color.MaxToOne();
+				if (sampleIndex == 0)
+				{
+					const HitRecord& closestHit{ tileSample.hit };
+					m_AccumulationBuffer[pixelIndex] = tileSample.color;
+					m_AlbedoBuffer[pixelIndex] = closestHit.didHit ? materials[closestHit.materialIndex]->GetAlbedo() : colors::Black;
+					m_NormalBuffer[pixelIndex] = closestHit.didHit ? closestHit.normal.Normalized() : Vector3::Zero;
+					m_DepthBuffer[pixelIndex] = closestHit.didHit ? closestHit.t : 0.f;
+					m_HistoryColor[pixelIndex] = tileSample.color;
+					m_HistoryAge[pixelIndex] = tileSample.historyAge;
+				}
+				else
+				{
+					m_AccumulationBuffer[pixelIndex] += tileSample.color;
+				}
 			}
+		}
+	}
+
+	m_NumRays += numRays;
+	m_NumCachedShadowRays += numCachedShadowRays;
 
-			//render equation
-			switch (m_CurrentLightingMode)
+	if (measureCost)
+	{
+		uint32_t tileMaxCost{ 0 };
+		for (int y{ 0 }; y < tile.height; ++y)
+		{
+			for (int x{ 0 }; x < tile.width; ++x)
 			{
-			case LightingMode::BRDF: {
-				ColorRGB BRDFrgb{ material->Shade(closestHit, lightRay.direction, viewRay.direction) };
-				finalColor += BRDFrgb;
-				break;
+				const uint32_t cost{ samples[x + y * tile.width].cost / m_SamplesPerPixel };
+				m_CostBuffer[(tile.x + x) + ((tile.y + y) * m_Width)] = cost;
+				tileMaxCost = std::max(tileMaxCost, cost);
 			}
-			case LightingMode::Radiance: {
-				ColorRGB eRGB{ LightUtils::GetRadiance(light, closestHit.origin) };
-				finalColor += eRGB;
-				break;
+		}
+
+		uint32_t maxCost{ m_MaxCost.load() };
+		while (tileMaxCost > maxCost && !m_MaxCost.compare_exchange_weak(maxCost, tileMaxCost)) {}
+	}
+}
+
+void Renderer::FillTile(uint32_t tileIndex)
+{
+	PROFILE_SCOPE_ARG("FillTile", tileIndex);
+	const TileUtils::TileRect tile{ TileUtils::GetTileRect(tileIndex, m_Width, m_Height, TileSize) };
+	const float sampleWeight{ 1.f / static_cast<float>(m_AccumulatedSamples) };
+
+	//Offsets of two traced pixels on opposite sides of a pixel that wasn't traced
+	struct NeighbourPair
+	{
+		int x0, y0, x1, y1;
+	};
+
+	//Index of the traced pixel at an offset, mirrored to the other pixel of the pair at the screen border. False when both are off screen
+	const auto getNeighbours{ [this](int x, int y, const NeighbourPair& pair, int& first, int& second) {
+		const bool isFirstOnScreen{ x + pair.x0 >= 0 && x + pair.x0 < m_Width && y + pair.y0 >= 0 && y + pair.y0 < m_Height };
+		const bool isSecondOnScreen{ x + pair.x1 >= 0 && x + pair.x1 < m_Width && y + pair.y1 >= 0 && y + pair.y1 < m_Height };
+		if (!isFirstOnScreen && !isSecondOnScreen)
+			return false;
+
+		first = isFirstOnScreen ? (x + pair.x0) + (y + pair.y0) * m_Width : (x + pair.x1) + (y + pair.y1) * m_Width;
+		second = isSecondOnScreen ? (x + pair.x1) + (y + pair.y1) * m_Width : first;
+		return true;
+	} };
+
+	//Color and relative depth difference of two traced pixels, high across an edge
+	const auto getDifference{ [this, sampleWeight](int first, int second) {
+		const ColorRGB& colorA{ m_AccumulationBuffer[first] };
+		const ColorRGB& colorB{ m_AccumulationBuffer[second] };
+		const float colorDifference{ (std::abs(colorA.r - colorB.r) + std::abs(colorA.g - colorB.g) + std::abs(colorA.b - colorB.b)) * sampleWeight };
+		const float depthA{ m_DepthBuffer[first] };
+		const float depthB{ m_DepthBuffer[second] };
+		return colorDifference + std::abs(depthA - depthB) / std::max(depthA + depthB, 1e-6f);
+	} };
+
+	for (int y{ tile.y }; y < tile.y + tile.height; ++y)
+	{
+		for (int x{ tile.x }; x < tile.x + tile.width; ++x)
+		{
+			if (IsTraced(x, y)) {
+				continue;
 			}
-			case LightingMode::ObservedArea: {
-				finalColor += ColorRGB(LCL, LCL, LCL);
-				break;
+
+			//Checkerboard pixels lie between a horizontal and a vertical pair, quarter pixels between one pair on
+			//their row or column, or two diagonal pairs in the center of a 2x2 block
+			NeighbourPair pairs[2]{ { -1, 0, 1, 0 }, { 0, -1, 0, 1 } };
+			int numPairs{ 2 };
+			if (m_PixelSubset == PixelSubset::Quarter)
+			{
+				const bool isOddX{ (x & 1) != 0 };
+				const bool isOddY{ (y & 1) != 0 };
+				if (isOddX && isOddY)
+				{
+					pairs[0] = { -1, -1, 1, 1 };
+					pairs[1] = { 1, -1, -1, 1 };
+				}
+				else
+				{
+					pairs[0] = isOddX ? pairs[0] : pairs[1];
+					numPairs = 1;
+				}
 			}
-			case LightingMode::Combined: {
-				ColorRGB BRDFrgb{ material->Shade(closestHit, lightRay.direction, viewRay.direction) };
-				ColorRGB eRGB{ LightUtils::GetRadiance(light, closestHit.origin) };
-				finalColor += eRGB * BRDFrgb * LCL;
-				break;
+
+			//Interpolate along the pair that differs least, so edges are followed instead of blurred
+			int first{ -1 };
+			int second{ -1 };
+			float minDifference{ FLT_MAX };
+			for (int pairIndex{ 0 }; pairIndex < numPairs; ++pairIndex)
+			{
+				int pairFirst{};
+				int pairSecond{};
+				if (!getNeighbours(x, y, pairs[pairIndex], pairFirst, pairSecond)) {
+					continue;
+				}
+
+				const float difference{ getDifference(pairFirst, pairSecond) };
+				if (difference < minDifference)
+				{
+					minDifference = difference;
+					first = pairFirst;
+					second = pairSecond;
+				}
+			}
+			if (first < 0) {
+				continue;
 			}
-			default: {
-				ColorRGB BRDFrgb{ material->Shade(closestHit, lightRay.direction, viewRay.direction) };
-				ColorRGB eRGB{ LightUtils::GetRadiance(light, closestHit.origin) };
-				finalColor += eRGB * BRDFrgb * LCL;
-				break;
+
+			const int pixelIndex{ x + y * m_Width };
+			m_AccumulationBuffer[pixelIndex] = ColorRGB::Lerp(m_AccumulationBuffer[first], m_AccumulationBuffer[second], 0.5f);
+			m_AlbedoBuffer[pixelIndex] = ColorRGB::Lerp(m_AlbedoBuffer[first], m_AlbedoBuffer[second], 0.5f);
+			const Vector3 normal{ m_NormalBuffer[first] + m_NormalBuffer[second] };
+			m_NormalBuffer[pixelIndex] = normal.SqrMagnitude() > 0.f ? normal.Normalized() : Vector3::Zero;
+			m_DepthBuffer[pixelIndex] = (m_DepthBuffer[first] + m_DepthBuffer[second]) * 0.5f;
+		}
+	}
+}
+
+bool Renderer::IsTileAffected(const TileContext& context, uint32_t tileIndex) const
+{
+	const TileUtils::TileRect tile{ TileUtils::GetTileRect(tileIndex, m_Width, m_Height, TileSize) };
+	const std::vector<MovedBounds>& movedBounds{ *context.pMovedBounds };
+	const std::vector<Light>& lights{ *context.pLights };
+
+	//The segments below are those RenderTile traced for the pixel center last frame: the view ray up to its hit and the shadow rays from there.
+	//A pixel can only change if one of them passes through where a moved mesh was or is now
+	const auto doesSegmentHitMovedMesh{ [&movedBounds](const Vector3& origin, const Vector3& direction, float tMax) {
+		for (const MovedBounds& bounds : movedBounds)
+		{
+			if (GeometryUtils::DoesSegmentHitBox(origin, direction, tMax, Vector3::Min(bounds.previousMin, bounds.min), Vector3::Max(bounds.previousMax, bounds.max)))
+				return true;
+		}
+		return false;
+	} };
+
+	for (int py{ tile.y }; py < tile.y + tile.height; ++py)
+	{
+		for (int px{ tile.x }; px < tile.x + tile.width; ++px)
+		{
+			const HitRecord& hit{ m_GBuffer[px + py * m_Width] };
+
+			const float cx{ (2 * ((px + 0.5f) / static_cast<float>(m_Width)) - 1) * context.aspectRatio * context.fov };
+			const float cy{ (1 - (2 * ((py + 0.5f) / static_cast<float>(m_Height)))) * context.fov };
+			const Vector3 viewDirection{ context.cameraToWorld.TransformVector(Vector3{ cx, cy, 1 }.Normalized()) };
+			//Slightly past the hit, so a hit on the surface of the bounds counts
+			if (doesSegmentHitMovedMesh(context.cameraOrigin, viewDirection, hit.didHit ? hit.t * 1.01f : FLT_MAX))
+				return true;
+
+			if (!hit.didHit) {
+				continue;
 			}
+
+			for (const Light& light : lights)
+			{
+				const Vector3 direction{ LightUtils::GetDirectionToLight(light, hit.origin) };
+				if (doesSegmentHitMovedMesh(hit.origin, direction.Normalized(), direction.Magnitude()))
+					return true;
 			}
 		}
 	}
-	else {
-		finalColor = colors::Black;
+	return false;
+}
+
+bool Renderer::IsTraced(int x, int y) const
+{
+	switch (m_PixelSubset)
+	{
+	case PixelSubset::Checkerboard:
+		return ((x + y) & 1) == 0;
+	case PixelSubset::Quarter:
+		return (x & 1) == 0 && (y & 1) == 0;
+	case PixelSubset::Full:
+	default:
+		return true;
 	}
-#pragma endregion
+}
+
+ColorRGB Renderer::GetPixelColor(int x, int y, float sampleWeight) const
+{
+	const int pixelIndex{ x + (y * m_Width) };
+	if (m_CurrentLightingMode == LightingMode::Cost)
+	{
+		const int legendX{ x - HeatmapLegendMargin };
+		const int legendY{ y - (m_Height - HeatmapLegendMargin - HeatmapLegendHeight) };
+		const bool isLegend{ legendX >= 0 && legendX < HeatmapLegendWidth && legendY >= 0 && legendY < HeatmapLegendHeight };
+
+		return isLegend ?
+			GetHeatmapColor(static_cast<float>(legendX) / (HeatmapLegendWidth - 1)) :
+			GetHeatmapColor(static_cast<float>(m_CostBuffer[pixelIndex]) / m_HeatmapMaxCost);
+	}
+
+	//Through a const reference, the non-const ColorRGB operator* would scale the accumulated sum in place
+	const ColorRGB& accumulatedColor{ m_AccumulationBuffer[pixelIndex] };
+	return m_DenoiserEnabled ? m_Denoiser.GetPixel(pixelIndex) : accumulatedColor * sampleWeight;
+}
+
+void Renderer::ResolveTile(uint32_t tileIndex)
+{
+	PROFILE_SCOPE_ARG("ResolveTile", tileIndex);
+	const TileUtils::TileRect tile{ TileUtils::GetTileRect(tileIndex, m_Width, m_Height, TileSize) };
+	const float sampleWeight{ 1.f / static_cast<float>(m_AccumulatedSamples) };
 
 	//Update Color in Buffer
-	finalColor.MaxToOne();
+	for (int y{ tile.y }; y < tile.y + tile.height; ++y)
+	{
+		for (int x{ tile.x }; x < tile.x + tile.width; ++x)
+		{
+			const int pixelIndex{ x + (y * m_Width) };
+			ColorRGB finalColor{ GetPixelColor(x, y, sampleWeight) };
+			finalColor.MaxToOne();
+
+			m_pTargetPixels[pixelIndex] = SDL_MapRGB(m_pBuffer->format,
+				static_cast<uint8_t>(finalColor.r * 255),
+				static_cast<uint8_t>(finalColor.g * 255),
+				static_cast<uint8_t>(finalColor.b * 255)
+			);
+		}
+	}
+}
 
-	m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
-		static_cast<uint8_t>(finalColor.r * 255),
-		static_cast<uint8_t>(finalColor.g * 255),
-		static_cast<uint8_t>(finalColor.b * 255)
-	);
+void Renderer::Render(Scene* pScene)
+{
+	RenderFrame(pScene, m_pBufferPixels);
+	Present(m_pBufferPixels);
 }
 
-void Renderer::Render(Scene* pScene) const
+void Renderer::RenderFrame(Scene* pScene, uint32_t* pPixels)
 {
+	PROFILE_SCOPE("Render");
+	ALLOCATION_CHECK_SCOPE("Renderer::Render");
 	Camera& camera = pScene->GetCamera();
 	const std::vector<Material*>& materials = pScene->GetMaterials();
 	const std::vector<Light>& lights = pScene->GetLights();
@@ -133,61 +752,268 @@ void Renderer::Render(Scene* pScene) const
 
 	const float fov{ tanf(camera.fovAngle * TO_RADIANS / 2.f) };
 
-	const uint32_t numPixels = m_Width * m_Height ;
+	const Matrix cameraToWorld{ camera.CalculateCameraToWorld() };
+	const Vector3 cameraOrigin{ camera.origin };
 
-	#if defined(ASYNC)
-	const uint32_t numCores{ std::thread::hardware_concurrency() };
-	std::vector<std::future<void>> async_futures{};
-	const uint32_t numPixelsPerTask{ numPixels / numCores };
-	uint32_t numUnassignedPixels{ numPixels % numCores };
-	uint32_t currPixelIndex{ 0 };
-	for (uint32_t coreId{ 0 }; coreId < numCores; coreId++)
+	//Progressive accumulation restarts whenever the view or the geometry changes
+	bool cameraMoved{ fov != m_PreviousFov };
+	for (int row{ 0 }; row < 4; ++row)
 	{
-		uint32_t taskSize{ numPixelsPerTask };
-		if (numUnassignedPixels > 0) {
-			++taskSize;
-			--numUnassignedPixels;
-		}
+		const Vector4 current{ cameraToWorld[row] };
+		const Vector4 previous{ m_PreviousCameraToWorld[row] };
+		cameraMoved |= current.x != previous.x || current.y != previous.y || current.z != previous.z || current.w != previous.w;
+	}
+	m_PreviousCameraToWorld = cameraToWorld;
+	m_PreviousFov = fov;
 
-		async_futures.push_back(std::async(std::launch::async, [=, this] {
-				const uint32_t pixelIndexEnd{ currPixelIndex + taskSize };
-				for (uint32_t pixelIndex{ currPixelIndex }; pixelIndex < pixelIndexEnd; ++pixelIndex)
-				{
-					RenderPixel(pScene, pixelIndex, fov, aspectRatio, pScene->GetCamera(), lights, materials);
-				}
-			}
-		));
-		currPixelIndex += taskSize;
+	const bool geometryChanged{ pScene->GetGeometryVersion() != m_PreviousGeometryVersion };
+	const std::vector<MovedBounds>* const pMovedBounds{ geometryChanged ? pScene->GetMovedBoundsSince(m_PreviousGeometryVersion) : nullptr };
+	m_PreviousGeometryVersion = pScene->GetGeometryVersion();
+
+	if (m_pShadowCache && geometryChanged)
+	{
+		if (pMovedBounds)
+			m_pShadowCache->Invalidate(*pMovedBounds, lights, m_pExecutor);
+		else
+			m_pShadowCache->Clear();
 	}
 
-	for (const std::future<void>& f : async_futures)
+	//The cost heatmap measures every pixel
+	const PixelSubset pixelSubset{ m_CurrentLightingMode == LightingMode::Cost ? PixelSubset::Full : m_RequestedPixelSubset.load() };
+	const bool pixelSubsetChanged{ pixelSubset != m_PixelSubset };
+	m_PixelSubset = pixelSubset;
+
+	//Samples shaded another way can't be averaged with the new ones
+	const bool shadingChanged{ m_CurrentLightingMode != m_PreviousLightingMode || m_ShadowsEnabled != m_PreviousShadowsEnabled };
+	m_PreviousLightingMode = m_CurrentLightingMode;
+	m_PreviousShadowsEnabled = m_ShadowsEnabled;
+
+	//When only meshes moved, the tiles they didn't touch still hold the last frame. That needs a complete G-buffer to judge
+	//the tiles by and a framebuffer with exactly one frame of samples, traced with the current settings
+	const bool isLastFrameReusable{ m_IsGBufferValid && m_AccumulatedSamples == static_cast<uint32_t>(m_SamplesPerPixel)
+		&& m_HistoryLightingMode == m_CurrentLightingMode && m_HistoryShadowsEnabled == m_ShadowsEnabled };
+	const bool redrawMovedOnly{ m_PartialRedrawEnabled && pMovedBounds && isLastFrameReusable && !cameraMoved && !pixelSubsetChanged
+		&& m_CurrentLightingMode != LightingMode::Cost };
+
+	if (!m_AccumulationEnabled || cameraMoved || geometryChanged || pixelSubsetChanged || shadingChanged) {
+		m_AccumulatedSamples = 0;
+	}
+	if (cameraMoved || geometryChanged || pixelSubsetChanged) {
+		m_IsGBufferValid = false;
+	}
+
+	//The cost heatmap measures the primary rays, so they are always traced for it
+	const bool measureCost{ m_CurrentLightingMode == LightingMode::Cost };
+	//A frame that starts from sample 0 writes a new G-buffer and shading history, the previous ones are kept to reuse from.
+	//A partial redraw updates the current ones in place instead, neither reuses hits nor history
+	const bool startsFromFirstSample{ m_AccumulatedSamples == 0 };
+	if (startsFromFirstSample && !redrawMovedOnly)
 	{
-		f.wait();
+		std::swap(m_GBuffer, m_PreviousGBuffer);
+		std::swap(m_HistoryColor, m_PreviousHistoryColor);
+		std::swap(m_HistoryAge, m_PreviousHistoryAge);
 	}
+	const bool reuseHits{ m_IsGBufferValid && startsFromFirstSample && !measureCost };
+	//Reprojection only follows the camera, changed geometry, lights or shading settings invalidate the whole history
+	const bool useHistory{ m_TemporalReuseEnabled && m_IsHistoryValid && startsFromFirstSample && !measureCost && !geometryChanged
+		&& m_HistoryLightingMode == m_CurrentLightingMode && m_HistoryShadowsEnabled == m_ShadowsEnabled };
+
+	const uint32_t numTiles{ TileUtils::GetNumTiles(m_Width, m_Height, TileSize) };
+
+	m_ShadowTraceNanoseconds = 0;
+	m_NumRays = 0;
+	m_NumCachedShadowRays = 0;
+	m_MaxCost = 0;
+
+	using Clock = std::chrono::steady_clock;
+	const auto toMilliseconds{ [](Clock::duration duration) { return std::chrono::duration<float, std::milli>(duration).count(); } };
+	auto phaseStart{ Clock::now() };
 
-	#elif defined(PARALLEL_FOR)
-	concurrency::parallel_for(0u, numPixels, [=, this](int i) {
-		RenderPixel(pScene, i, fov, aspectRatio, pScene->GetCamera(), lights, materials);
+	const TileContext tileContext{ pScene, fov, aspectRatio, cameraToWorld, cameraOrigin, &lights, &materials, reuseHits,
+		useHistory, m_HistoryCameraToWorld, m_HistoryFov, redrawMovedOnly ? pMovedBounds : nullptr };
+	ForEachTile(numTiles, [this, &tileContext](uint32_t tileIndex) {
+		RenderTile(tileContext, tileIndex);
 	});
-	#else
-	for (uint32_t i{ 0 }; i < numPixels; i++)
+
+	//Every frame that starts from sample 0 leaves a complete G-buffer and shading history behind
+	if (startsFromFirstSample)
+	{
+		m_IsGBufferValid = true;
+		m_IsHistoryValid = true;
+		m_HistoryCameraToWorld = cameraToWorld;
+		m_HistoryFov = fov;
+		m_HistoryLightingMode = m_CurrentLightingMode;
+		m_HistoryShadowsEnabled = m_ShadowsEnabled;
+	}
+	m_AccumulatedSamples += m_SamplesPerPixel;
+
+	if (m_PixelSubset != PixelSubset::Full)
+	{
+		ForEachTile(numTiles, [this](uint32_t tileIndex) {
+			FillTile(tileIndex);
+		});
+	}
+
+	m_ShadowTraceTime = m_ShadowTraceNanoseconds * 1e-6f;
+	m_HeatmapMaxCost = std::max(m_MaxCost.load(), 1u);
+	m_FrameStats.numRays = m_NumRays;
+	m_FrameStats.numCachedShadowRays = m_NumCachedShadowRays;
+	m_FrameStats.traceTime = toMilliseconds(Clock::now() - phaseStart);
+	phaseStart = Clock::now();
+
+	if (m_DenoiserEnabled && m_CurrentLightingMode != LightingMode::Cost)
+	{
+		const float sampleWeight{ 1.f / static_cast<float>(m_AccumulatedSamples) };
+		ForEachTile(numTiles, [&](uint32_t tileIndex) {
+			PROFILE_SCOPE_ARG("DemodulateTile", tileIndex);
+			m_Denoiser.DemodulateTile(m_AccumulationBuffer.data(), sampleWeight, tileIndex);
+		});
+
+		for (int pass{ 0 }; pass < m_Denoiser.GetNumPasses(); ++pass)
+		{
+			ForEachTile(numTiles, [&](uint32_t tileIndex) {
+				PROFILE_SCOPE_ARG("FilterTile", tileIndex);
+				m_Denoiser.FilterTile(pass, tileIndex);
+			});
+		}
+	}
+	m_FrameStats.denoiseTime = toMilliseconds(Clock::now() - phaseStart);
+	phaseStart = Clock::now();
+
+	m_pTargetPixels = pPixels;
+	ForEachTile(numTiles, [&](uint32_t tileIndex) {
+		ResolveTile(tileIndex);
+	});
+	m_FrameStats.resolveTime = toMilliseconds(Clock::now() - phaseStart);
+
+	m_RayStats = RayStats::CollectFrame();
+	ScratchArena::EndFrame();
+}
+
+void Renderer::Present(const uint32_t* pPixels)
+{
+	const auto start{ std::chrono::steady_clock::now() };
+	if (pPixels != m_pBufferPixels)
 	{
-		RenderPixel(pScene, i, fov, aspectRatio, pScene->GetCamera(), lights, materials);
+		PROFILE_SCOPE("CopyToSurface");
+		std::copy(pPixels, pPixels + static_cast<size_t>(m_Width) * m_Height, m_pBufferPixels);
 	}
-	#endif
 
-	//@END
 	//Update SDL Surface
-	SDL_UpdateWindowSurface(m_pWindow);
+	{
+		PROFILE_SCOPE("SDL_UpdateWindowSurface");
+		SDL_UpdateWindowSurface(m_pWindow);
+	}
+
+	//Waits while the stream is behind, so a slow reader holds back rendering instead of losing frames
+	if (m_pFrameStream)
+		m_pFrameStream->Push(pPixels);
+	m_FrameStats.presentTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Renderer::ForEachTile(uint32_t numTiles, const std::function<void(uint32_t)>& job) const
+{
+	m_pExecutor->ParallelFor(numTiles, job);
+}
+
+uint64_t Renderer::GetImageHash() const
+{
+	uint64_t hash{ 14695981039346656037ull };
+	for (int i{ 0 }; i < m_Width * m_Height; ++i)
+	{
+		hash = (hash ^ m_pBufferPixels[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+void Renderer::GetImage(std::vector<ColorRGB>& image) const
+{
+	const float sampleWeight{ 1.f / static_cast<float>(m_AccumulatedSamples) };
+	image.resize(static_cast<size_t>(m_Width) * m_Height);
+	for (int y{ 0 }; y < m_Height; ++y)
+	{
+		for (int x{ 0 }; x < m_Width; ++x)
+		{
+			image[x + (y * m_Width)] = GetPixelColor(x, y, sampleWeight);
+		}
+	}
+}
+
+void Renderer::GetCheckpoint(const Scene& scene, RenderCheckpoint& checkpoint) const
+{
+	static_assert(static_cast<uint8_t>(PixelSubset::Quarter) + 1 == RenderCheckpoint::NumPixelSubsets);
+	static_assert(static_cast<uint8_t>(LightingMode::Cost) + 1 == RenderCheckpoint::NumLightingModes);
+
+	checkpoint.width = m_Width;
+	checkpoint.height = m_Height;
+	checkpoint.seed = m_Seed;
+	checkpoint.accumulatedSamples = m_AccumulatedSamples;
+	checkpoint.pixelSubset = static_cast<uint8_t>(m_PixelSubset);
+	checkpoint.lightingMode = static_cast<uint8_t>(m_CurrentLightingMode);
+	checkpoint.areShadowsEnabled = m_ShadowsEnabled;
+	checkpoint.cameraToWorld = m_PreviousCameraToWorld;
+	checkpoint.fov = m_PreviousFov;
+	checkpoint.geometryHash = scene.GetContentHash();
+
+	checkpoint.accumulation.assign(m_AccumulationBuffer.begin(), m_AccumulationBuffer.end());
+	checkpoint.albedo.assign(m_AlbedoBuffer.begin(), m_AlbedoBuffer.end());
+	checkpoint.normals.assign(m_NormalBuffer.begin(), m_NormalBuffer.end());
+	checkpoint.depths.assign(m_DepthBuffer.begin(), m_DepthBuffer.end());
+}
+
+bool Renderer::RestoreCheckpoint(const Scene& scene, const RenderCheckpoint& checkpoint)
+{
+	const size_t numPixels{ static_cast<size_t>(m_Width) * m_Height };
+	if (checkpoint.width != m_Width || checkpoint.height != m_Height || checkpoint.accumulation.size() != numPixels
+		|| checkpoint.albedo.size() != numPixels || checkpoint.normals.size() != numPixels || checkpoint.depths.size() != numPixels
+		|| checkpoint.pixelSubset >= RenderCheckpoint::NumPixelSubsets || checkpoint.lightingMode >= RenderCheckpoint::NumLightingModes)
+		return false;
+
+	//The geometry version only counts edits and differs between processes, the content hash tells whether the samples still apply
+	if (checkpoint.geometryHash != scene.GetContentHash())
+		return false;
+
+	m_Seed = checkpoint.seed;
+	m_AccumulatedSamples = checkpoint.accumulatedSamples;
+	m_PixelSubset = static_cast<PixelSubset>(checkpoint.pixelSubset);
+	m_RequestedPixelSubset = m_PixelSubset;
+	m_CurrentLightingMode = static_cast<LightingMode>(checkpoint.lightingMode);
+	m_ShadowsEnabled = checkpoint.areShadowsEnabled;
+	m_PreviousLightingMode = m_CurrentLightingMode;
+	m_PreviousShadowsEnabled = m_ShadowsEnabled;
+	//RenderFrame compares the next frame to these, so a matching view and the unchanged geometry continue the accumulation
+	m_PreviousCameraToWorld = checkpoint.cameraToWorld;
+	m_PreviousFov = checkpoint.fov;
+	m_PreviousGeometryVersion = scene.GetGeometryVersion();
+
+	std::copy(checkpoint.accumulation.begin(), checkpoint.accumulation.end(), m_AccumulationBuffer.begin());
+	std::copy(checkpoint.albedo.begin(), checkpoint.albedo.end(), m_AlbedoBuffer.begin());
+	std::copy(checkpoint.normals.begin(), checkpoint.normals.end(), m_NormalBuffer.begin());
+	std::copy(checkpoint.depths.begin(), checkpoint.depths.end(), m_DepthBuffer.begin());
+
+	//Neither was saved, the next frame that starts from sample 0 writes them again
+	m_IsGBufferValid = false;
+	m_IsHistoryValid = false;
+	return true;
+}
+
+void Renderer::SetExecutionBackend(ExecutionBackend backend, uint32_t numThreads, bool pinThreads)
+{
+	//Workers of the previous backend are joined before the new ones are started
+	delete m_pExecutor;
+	m_pExecutor = Executor::Create(backend, numThreads, pinThreads);
+	m_ExecutionBackend = backend;
 }
 
-bool Renderer::SaveBufferToImage() const
+void Renderer::CycleExecutionBackend()
 {
-	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
+	m_ExecutionBackend == ExecutionBackend::Serial ?
+		SetExecutionBackend(ExecutionBackend(0)) :
+		SetExecutionBackend(ExecutionBackend(static_cast<int>(m_ExecutionBackend) + 1));
 }
 
 void Renderer::CycleLightingMode() {
-	m_CurrentLightingMode == LightingMode::Combined ?
+	m_CurrentLightingMode == LightingMode::Cost ?
 		m_CurrentLightingMode = LightingMode(0) :
 		m_CurrentLightingMode = LightingMode(static_cast<int>(m_CurrentLightingMode) + 1);
 }
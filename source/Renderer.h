@@ -1,53 +1,265 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
 #include <vector>
 
+#include "Math.h"
+#include "DataTypes.h"
+#include "Denoiser.h"
+#include "Executor.h"
+#include "RayStats.h"
+#include "ShadowCache.h"
+#include "FrameStream.h"
+
 struct SDL_Window;
 struct SDL_Surface;
 
 namespace dae
 {
 	class Scene;
-	struct Matrix;
+	struct MovedBounds;
 	struct Camera;
 	class Material;
 	struct Light;
+	struct RenderCheckpoint;
+
+	//Wall-clock time of every phase of the last Render call (ms)
+	struct FrameStats
+	{
+		float traceTime{};
+		float denoiseTime{};
+		float resolveTime{};
+		float presentTime{};
+		//Primary and shadow rays traced, over all samples
+		uint64_t numRays{};
+		//Shadow rays answered by the shadow cache instead of traced
+		uint64_t numCachedShadowRays{};
+	};
+
+	//Pixels traced every frame, the others are interpolated from their traced neighbours
+	enum class PixelSubset
+	{
+		Full,
+		//Every other pixel, in a checkerboard pattern
+		Checkerboard,
+		//One pixel of every 2x2 block
+		Quarter
+	};
+
+	//Per-frame inputs of every render tile, bundled so a tile job captures only this and one reference. ForEachTile still builds a
+	//std::function per frame, but a capture that small fits its inline storage, so building it doesn't allocate
+	struct TileContext
+	{
+		const Scene* pScene{};
+		float fov{};
+		float aspectRatio{};
+		Matrix cameraToWorld{};
+		Vector3 cameraOrigin{};
+		const std::vector<Light>* pLights{};
+		const std::vector<Material*>* pMaterials{};
+		//The unjittered first sample takes its primary hit from the G-buffer instead of tracing it
+		bool reuseHits{};
+		//The unjittered first sample reuses the shading history where its hit reprojects onto the same surface
+		bool useHistory{};
+		//Camera the shading history was rendered with
+		Matrix historyCameraToWorld{};
+		float historyFov{};
+		//Only the tiles these moved meshes can have changed are traced, the others keep the last frame. nullptr traces every tile
+		const std::vector<MovedBounds>* pMovedBounds{};
+	};
 
 	class Renderer final
 	{
 	public:
 		Renderer(SDL_Window* pWindow);
-		~Renderer() = default;
+		~Renderer();
 
 		Renderer(const Renderer&) = delete;
 		Renderer(Renderer&&) noexcept = delete;
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
-		void Render(Scene* pScene) const;
-		void RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRation, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials) const;
-		bool SaveBufferToImage() const;
+		//RenderFrame into the window surface, then Present
+		void Render(Scene* pScene);
+		/**
+		 * \brief Traces, denoises and resolves a frame without presenting it
+		 * \param pPixels Width * height pixels in the format of the window surface
+		 */
+		void RenderFrame(Scene* pScene, uint32_t* pPixels);
+		//Copies pPixels to the window surface, unless they are the surface, and shows it. May run on another thread than RenderFrame
+		void Present(const uint32_t* pPixels);
+		void RenderTile(const TileContext& context, uint32_t tileIndex);
+		//Linear color of every pixel of the last frame, as ResolveTile shows it before clamping. For ImageWriter
+		void GetImage(std::vector<ColorRGB>& image) const;
 		void CycleLightingMode();
 		void ToggleShadows() { m_ShadowsEnabled = !m_ShadowsEnabled; }
+		void ToggleRayReordering() { m_RayReorderingEnabled = !m_RayReorderingEnabled; }
+		void ToggleDenoiser() { m_DenoiserEnabled = !m_DenoiserEnabled; }
+		void ToggleAccumulation() { m_AccumulationEnabled = !m_AccumulationEnabled; }
+		void SetAccumulationEnabled(bool isEnabled) { m_AccumulationEnabled = isEnabled; }
+		void ToggleTemporalReuse() { m_TemporalReuseEnabled = !m_TemporalReuseEnabled; }
+		void SetSamplesPerPixel(int samplesPerPixel) { m_SamplesPerPixel = std::max(samplesPerPixel, 1); }
+		//Caches shadow ray results in a world space grid of the given cell size, 0 turns the cache off. Not while a frame renders
+		void SetShadowCacheCellSize(float cellSize);
+		const ShadowCache* GetShadowCache() const { return m_pShadowCache.get(); }
+		/**
+		 * \brief Writes every presented frame to path ("-" for stdout) from now on, replacing any stream opened before
+		 * \return false when the output couldn't be opened
+		 */
+		bool OpenFrameStream(const std::string& path, StreamFormat format, int framesPerSecond);
+		const FrameStream* GetFrameStream() const { return m_pFrameStream.get(); }
+		//Copies the accumulated samples and everything needed to continue them into checkpoint, reusing its buffers. Not while a frame renders
+		void GetCheckpoint(const Scene& scene, RenderCheckpoint& checkpoint) const;
+		/**
+		 * \brief Continues the progressive render a checkpoint was taken of. The next frame adds its samples to the restored ones,
+		 * as long as the camera and the pixel subset still match the checkpoint. Not while a frame renders
+		 * \return false when the checkpoint has another resolution or was taken of other scene content, nothing is restored then
+		 */
+		bool RestoreCheckpoint(const Scene& scene, const RenderCheckpoint& checkpoint);
+		//Off traces every tile whenever the geometry changed, instead of only the tiles touched by moved meshes
+		void SetPartialRedrawEnabled(bool isEnabled) { m_PartialRedrawEnabled = isEnabled; }
+		//Off tests every ray against the whole scene, instead of only the geometry inside the frustum of its tile or shadow rays
+		void SetTileCullingEnabled(bool isEnabled) { m_TileCullingEnabled = isEnabled; }
+		//Takes effect when the next frame starts, may be called while a frame renders. The cost heatmap always traces every pixel
+		void SetPixelSubset(PixelSubset subset) { m_RequestedPixelSubset = subset; }
+
+		/**
+		 * \brief Replaces the parallel backend used for rendering right away, the old executor and its threads are destroyed.
+		 * Not while a frame renders, and pointers from GetExecutor are invalid afterwards
+		 * \param numThreads Number of threads, 0 uses the hardware concurrency
+		 * \param pinThreads Pin the worker threads to cores (ThreadPool only)
+		 */
+		void SetExecutionBackend(ExecutionBackend backend, uint32_t numThreads = 0, bool pinThreads = false);
+		//SetExecutionBackend with the next backend, not while a frame renders
+		void CycleExecutionBackend();
+		Executor* GetExecutor() const { return m_pExecutor; }
+		int GetWidth() const { return m_Width; }
+		int GetHeight() const { return m_Height; }
+
+		bool IsCostHeatmapEnabled() const { return m_CurrentLightingMode == LightingMode::Cost; }
+		//Cost per pixel sample that maps to the top of the heatmap (red), in RayStats::GetCostUnit
+		uint32_t GetHeatmapMaxCost() const { return m_HeatmapMaxCost; }
+		bool IsRayReorderingEnabled() const { return m_RayReorderingEnabled; }
+		bool IsDenoiserEnabled() const { return m_DenoiserEnabled; }
+		bool IsAccumulationEnabled() const { return m_AccumulationEnabled; }
+		bool IsTemporalReuseEnabled() const { return m_TemporalReuseEnabled; }
+		uint32_t GetAccumulatedSamples() const { return m_AccumulatedSamples; }
+		//Time spent tracing shadow rays last frame, summed over all threads (ms)
+		float GetShadowTraceTime() const { return m_ShadowTraceTime; }
+		const FrameStats& GetFrameStats() const { return m_FrameStats; }
+		//Ray counters of the last frame, all zero when built without RAY_STATS_ENABLED
+		const RayStatsFrame& GetRayStats() const { return m_RayStats; }
+
+		//FNV-1a hash of the presented image, equal hashes mean identical frames
+		uint64_t GetImageHash() const;
 
 	private:
+		void ForEachTile(uint32_t numTiles, const std::function<void(uint32_t)>& job) const;
+		void ResolveTile(uint32_t tileIndex);
+		//Color shown at the pixel: the accumulated average, the denoised color or the heatmap
+		ColorRGB GetPixelColor(int x, int y, float sampleWeight) const;
+		//Interpolates the pixels of the tile that weren't traced, along the neighbours that differ least in color and depth
+		void FillTile(uint32_t tileIndex);
+		bool IsTraced(int x, int y) const;
+		//Whether a moved mesh covers or uncovers a pixel of the tile, or casts or removes a shadow on it, judged by the last G-buffer
+		bool IsTileAffected(const TileContext& context, uint32_t tileIndex) const;
+
 		SDL_Window* m_pWindow{};
 
 		SDL_Surface* m_pBuffer{};
 		uint32_t* m_pBufferPixels{};
+		//Pixels ResolveTile writes to, the window surface or a buffer of the frame pipeline
+		uint32_t* m_pTargetPixels{};
 
 		enum class LightingMode{
 			ObservedArea,
 			Radiance,
 			BRDF,
-			Combined
+			Combined,
+			//False color heatmap of the intersection cost of every pixel
+			Cost
 		};
 
+		static constexpr int TileSize{ 32 };
+		//Frames a pixel may reuse its shading before it is shaded again, bounds the error of view dependent shading
+		static constexpr uint8_t MaxHistoryAge{ 8 };
+
 		int m_Width{};
 		int m_Height{};
 		float offset{};
 		LightingMode m_CurrentLightingMode{ LightingMode::Combined };
 		bool m_ShadowsEnabled{ true };
+		bool m_RayReorderingEnabled{ true };
+		bool m_DenoiserEnabled{ false };
+		bool m_AccumulationEnabled{ false };
+		bool m_TemporalReuseEnabled{ false };
+		bool m_PartialRedrawEnabled{ true };
+		bool m_TileCullingEnabled{ true };
+		std::atomic<PixelSubset> m_RequestedPixelSubset{ PixelSubset::Full };
+		//Subset of the current frame
+		PixelSubset m_PixelSubset{ PixelSubset::Full };
+
+		//Float framebuffer, holds the sum of all samples since the last reset
+		std::vector<ColorRGB> m_AccumulationBuffer{};
+		uint32_t m_AccumulatedSamples{};
+		int m_SamplesPerPixel{ 1 };
+		uint32_t m_Seed{ 0 };
+
+		//Guide buffers, written by the first (unjittered) sample of every pixel
+		std::vector<ColorRGB> m_AlbedoBuffer{};
+		std::vector<Vector3> m_NormalBuffer{};
+		std::vector<float> m_DepthBuffer{};
+
+		//Primary hit of the unjittered first sample of every pixel. Reused while the camera and the geometry stay the same,
+		//so changing only shading settings (lighting mode, shadows, denoiser) doesn't trace primary rays again
+		std::vector<HitRecord> m_GBuffer{};
+		//G-buffer of the last frame that started from sample 0, swapped with m_GBuffer when a frame starts from it
+		std::vector<HitRecord> m_PreviousGBuffer{};
+		bool m_IsGBufferValid{ false };
+
+		//Shading of the unjittered first sample of every pixel and the frames it has been reused for, double buffered like the G-buffer.
+		//Valid while the geometry and the shading settings it was rendered with stay the same, the camera may move
+		std::vector<ColorRGB> m_HistoryColor{};
+		std::vector<ColorRGB> m_PreviousHistoryColor{};
+		std::vector<uint8_t> m_HistoryAge{};
+		std::vector<uint8_t> m_PreviousHistoryAge{};
+		bool m_IsHistoryValid{ false };
+		Matrix m_HistoryCameraToWorld{};
+		float m_HistoryFov{};
+		LightingMode m_HistoryLightingMode{};
+		bool m_HistoryShadowsEnabled{};
+
+		Denoiser m_Denoiser{ TileSize };
+
+		//Intersection cost per pixel sample, only written in the Cost lighting mode
+		std::vector<uint32_t> m_CostBuffer{};
+		std::atomic<uint32_t> m_MaxCost{};
+		uint32_t m_HeatmapMaxCost{ 1 };
+
+		Executor* m_pExecutor{};
+		ExecutionBackend m_ExecutionBackend{ ExecutionBackend::ThreadPool };
+
+		Matrix m_PreviousCameraToWorld{};
+		float m_PreviousFov{};
+		uint64_t m_PreviousGeometryVersion{};
+		LightingMode m_PreviousLightingMode{ LightingMode::Combined };
+		bool m_PreviousShadowsEnabled{ true };
+
+		mutable std::atomic<uint64_t> m_ShadowTraceNanoseconds{};
+		float m_ShadowTraceTime{};
+
+		std::atomic<uint64_t> m_NumRays{};
+		std::atomic<uint64_t> m_NumCachedShadowRays{};
+		//nullptr while off. Cleared or invalidated whenever the geometry changes
+		std::unique_ptr<ShadowCache> m_pShadowCache{};
+		//nullptr while off, fed by Present
+		std::unique_ptr<FrameStream> m_pFrameStream{};
+		FrameStats m_FrameStats{};
+		RayStatsFrame m_RayStats{};
 	};
 }
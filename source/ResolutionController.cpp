@@ -0,0 +1,68 @@
+#include "ResolutionController.h"
+
+#include "Profiler.h"
+
+namespace dae {
+	ResolutionController::ResolutionController(float budget) :
+		m_Budget(budget)
+	{
+	}
+
+	bool ResolutionController::Update(float frameTime)
+	{
+		m_AverageFrameTime = m_FramesSinceChange == 0 ? frameTime : m_AverageFrameTime + (frameTime - m_AverageFrameTime) * Smoothing;
+		if (++m_FramesSinceChange < SettleFrames)
+			return false;
+
+		//Assumes the frame time scales with the traced pixels, Headroom covers the part that doesn't
+		PixelSubset subset{ m_Subset };
+		if (m_AverageFrameTime > m_Budget && m_Subset != PixelSubset::Quarter)
+		{
+			subset = static_cast<PixelSubset>(static_cast<int>(m_Subset) + 1);
+		}
+		else if (m_Subset != PixelSubset::Full)
+		{
+			const PixelSubset larger{ static_cast<PixelSubset>(static_cast<int>(m_Subset) - 1) };
+			const float predicted{ m_AverageFrameTime * GetPixelFraction(larger) / GetPixelFraction(m_Subset) };
+			if (predicted < m_Budget * Headroom)
+				subset = larger;
+		}
+
+		if (subset == m_Subset)
+			return false;
+
+		//Argument: new subset, 0 = full
+		PROFILE_MARKER("PixelSubsetChange", static_cast<int>(subset));
+		m_Subset = subset;
+		m_FramesSinceChange = 0;
+		return true;
+	}
+
+	const char* ResolutionController::GetSubsetName(PixelSubset subset)
+	{
+		switch (subset)
+		{
+		case PixelSubset::Checkerboard:
+			return "checkerboard";
+		case PixelSubset::Quarter:
+			return "quarter";
+		case PixelSubset::Full:
+		default:
+			return "full";
+		}
+	}
+
+	float ResolutionController::GetPixelFraction(PixelSubset subset)
+	{
+		switch (subset)
+		{
+		case PixelSubset::Checkerboard:
+			return 0.5f;
+		case PixelSubset::Quarter:
+			return 0.25f;
+		case PixelSubset::Full:
+		default:
+			return 1.f;
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+
+#include "Renderer.h"
+
+namespace dae
+{
+	/**
+	 * \brief Picks the pixel subset the renderer traces, so the frame time stays within a budget.
+	 * Traces fewer pixels when the smoothed frame time goes over the budget, and more again once the frame time
+	 * predicted for the larger subset fits the budget with some headroom.
+	 */
+	class ResolutionController final
+	{
+	public:
+		//Budget is the target frame time (ms)
+		explicit ResolutionController(float budget);
+		~ResolutionController() = default;
+
+		ResolutionController(const ResolutionController&) = delete;
+		ResolutionController(ResolutionController&&) noexcept = delete;
+		ResolutionController& operator=(const ResolutionController&) = delete;
+		ResolutionController& operator=(ResolutionController&&) noexcept = delete;
+
+		//Feeds the time of the last frame (ms), returns true when the subset changed
+		bool Update(float frameTime);
+
+		PixelSubset GetSubset() const { return m_Subset; }
+		float GetBudget() const { return m_Budget; }
+		float GetAverageFrameTime() const { return m_AverageFrameTime; }
+
+		static const char* GetSubsetName(PixelSubset subset);
+		//Fraction of the pixels traced with subset
+		static float GetPixelFraction(PixelSubset subset);
+
+	private:
+		//Weight of the newest frame in the smoothed frame time
+		static constexpr float Smoothing{ 0.1f };
+		//Frames to measure after a change before the next one, so the smoothed time reflects the new subset
+		static constexpr uint32_t SettleFrames{ 15 };
+		//Part of the budget the predicted frame time has to stay below to trace more pixels again, avoids flip-flopping
+		static constexpr float Headroom{ 0.8f };
+
+		float m_Budget{};
+		float m_AverageFrameTime{};
+		uint32_t m_FramesSinceChange{};
+		PixelSubset m_Subset{ PixelSubset::Full };
+	};
+}
@@ -1,39 +1,127 @@
 #include "Scene.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+#include <typeinfo>
+
 #include "Utils.h"
 #include "Material.h"
+#include "RayQuery.h"
+#include "Executor.h"
+#include "ScratchArena.h"
 
 namespace dae {
-
-#pragma region Base Scene
-	//Initialize Scene with Default Solid Color Material (RED)
-	Scene::Scene():
-		m_Materials({ new Material_SolidColor({1,0,0})})
+	namespace
 	{
-		m_SphereGeometries.reserve(32);
-		m_PlaneGeometries.reserve(32);
-		m_TriangleMeshGeometries.reserve(32);
-		m_TriangleGeometries.reserve(32);
-		m_Lights.reserve(32);
-	}
+		//Shared by all scenes, so no two scenes ever have the same geometry version
+		std::atomic<uint64_t> g_NextGeometryVersion{ 1 };
 
-	Scene::~Scene()
-	{
-		for(auto& pMaterial : m_Materials)
+		//FNV-1a over 32 bit words instead of bytes, the values hashed are all made of 4 byte members without padding
+		template<typename T>
+		void HashWords(uint64_t& hash, const T* pValues, size_t count)
+		{
+			static_assert(std::is_trivially_copyable_v<T> && sizeof(T) % sizeof(uint32_t) == 0);
+			const uint8_t* const pBytes{ reinterpret_cast<const uint8_t*>(pValues) };
+			const size_t numWords{ count * sizeof(T) / sizeof(uint32_t) };
+			for (size_t i{ 0 }; i < numWords; ++i)
+			{
+				uint32_t word{};
+				std::memcpy(&word, pBytes + i * sizeof(uint32_t), sizeof(uint32_t));
+				hash = HashWord(hash, word);
+			}
+		}
+
+		template<typename T>
+		void HashWords(uint64_t& hash, const std::vector<T>& values)
 		{
-			delete pMaterial;
-			pMaterial = nullptr;
+			HashWords(hash, values.data(), values.size());
 		}
 
-		m_Materials.clear();
+		//Smaller meshes are updated on the calling thread, handing out the jobs would cost more than it saves
+		constexpr size_t VerticesPerJob{ 16 * 1024 };
+
+		struct MeshUpdateJob
+		{
+			TriangleMesh* pMesh{};
+			Matrix transform{};
+			uint32_t numJobs{};
+			//Bounds of every chunk, reduced once all jobs finished
+			Vector3* pChunkMin{};
+			Vector3* pChunkMax{};
+		};
+
+		//UpdateAABB and UpdateTransforms in a single pass over the vertices, split into chunks run on the executor
+		void UpdateMeshParallel(TriangleMesh& mesh, Executor& executor)
+		{
+			PROFILE_SCOPE("UpdateMeshParallel");
+			ScratchArena& arena{ ScratchArena::GetThreadArena() };
+			const ScratchArena::Scope scope{ arena };
+
+			MeshUpdateJob job{};
+			job.pMesh = &mesh;
+			job.transform = mesh.ConsumePendingTransform();
+			job.numJobs = static_cast<uint32_t>((mesh.positions.size() + VerticesPerJob - 1) / VerticesPerJob);
+			job.pChunkMin = arena.Allocate<Vector3>(job.numJobs);
+			job.pChunkMax = arena.Allocate<Vector3>(job.numJobs);
+
+			executor.ParallelFor(job.numJobs, [&job](uint32_t jobIndex) {
+				TriangleMesh& mesh{ *job.pMesh };
+
+				const size_t firstPosition{ jobIndex * VerticesPerJob };
+				const size_t numPositions{ std::min(VerticesPerJob, mesh.positions.size() - firstPosition) };
+				Vector3* pPositions{ mesh.positions.data() + firstPosition };
+
+				//Bounds before the transform, as UpdateAABB computes them
+				Vector3 minAABB{ pPositions[0] };
+				Vector3 maxAABB{ pPositions[0] };
+				for (size_t i{ 1 }; i < numPositions; ++i)
+				{
+					minAABB = Vector3::Min(pPositions[i], minAABB);
+					maxAABB = Vector3::Max(pPositions[i], maxAABB);
+				}
+				job.pChunkMin[jobIndex] = minAABB;
+				job.pChunkMax[jobIndex] = maxAABB;
+
+				job.transform.TransformPoints(pPositions, pPositions, numPositions);
+
+				//There are per face or per vertex normals, either way they are split over the same number of jobs
+				const size_t normalsPerJob{ (mesh.normals.size() + job.numJobs - 1) / job.numJobs };
+				const size_t firstNormal{ std::min(jobIndex * normalsPerJob, mesh.normals.size()) };
+				const size_t numNormals{ std::min(normalsPerJob, mesh.normals.size() - firstNormal) };
+				job.transform.TransformVectors(mesh.normals.data() + firstNormal, mesh.normals.data() + firstNormal, numNormals);
+			});
+
+			mesh.minAABB = job.pChunkMin[0];
+			mesh.maxAABB = job.pChunkMax[0];
+			for (uint32_t i{ 1 }; i < job.numJobs; ++i)
+			{
+				mesh.minAABB = Vector3::Min(job.pChunkMin[i], mesh.minAABB);
+				mesh.maxAABB = Vector3::Max(job.pChunkMax[i], mesh.maxAABB);
+			}
+			mesh.FinishTransformUpdate(job.transform);
+		}
+	}
+
+#pragma region Base Scene
+	//Initialize Scene with Default Solid Color Material (RED)
+	Scene::Scene()
+	{
+		AddMaterial<Material_SolidColor>(ColorRGB{ 1, 0, 0 });
 	}
 
+	//The material arena destroys the materials
+	Scene::~Scene() = default;
+
 	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
 	{
+		RAY_STAT(PrimaryRays);
 		HitRecord smallestRecord{ };
 		smallestRecord.t = FLT_MAX;
 
 		HitRecord temp{};
-		for (const Sphere& sphere : m_SphereGeometries)
+		for (const Sphere& sphere : m_SphereGeometries.GetItems())
 		{
 			GeometryUtils::HitTest_Sphere(sphere, ray, temp);
 			if (temp.t < smallestRecord.t) {
@@ -41,7 +129,7 @@ namespace dae {
 			}
 		}
 		
-		for (const Plane& plane : m_PlaneGeometries)
+		for (const Plane& plane : m_PlaneGeometries.GetItems())
 		{
 			GeometryUtils::HitTest_Plane(plane, ray, temp);
 			if (temp.t < smallestRecord.t) {
@@ -49,7 +137,7 @@ namespace dae {
 			}
 		}
 
-		for (const TriangleMesh& mesh : m_TriangleMeshGeometries)
+		for (const TriangleMesh& mesh : m_TriangleMeshGeometries.GetItems())
 		{
 			GeometryUtils::HitTest_TriangleMesh(mesh, ray, temp);
 			if (temp.t < smallestRecord.t) {
@@ -61,25 +149,154 @@ namespace dae {
 	}
 
 	bool Scene::DoesHit(const Ray& ray) const {
+		RAY_STAT(ShadowRays);
 
 		HitRecord temp{};
-		for (const Sphere& sphere : m_SphereGeometries)
+		for (const Sphere& sphere : m_SphereGeometries.GetItems())
 		{
 			if (GeometryUtils::HitTest_Sphere(sphere, ray, temp, true)) {
+				RAY_STAT(ShadowEarlyOuts);
 				return true;
 			}
 		}
 
-		for (const Plane& plane : m_PlaneGeometries)
+		for (const Plane& plane : m_PlaneGeometries.GetItems())
 		{
 			if(GeometryUtils::HitTest_Plane(plane, ray, temp, true)) {
+				RAY_STAT(ShadowEarlyOuts);
 				return true;
 			}
 		}
 
-		for (const TriangleMesh& mesh : m_TriangleMeshGeometries)
+		for (const TriangleMesh& mesh : m_TriangleMeshGeometries.GetItems())
 		{
 			if(GeometryUtils::HitTest_TriangleMesh(mesh, ray, temp, true)) {
+				RAY_STAT(ShadowEarlyOuts);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void Scene::CullGeometry(const Frustum& frustum, GeometryCandidates& candidates) const
+	{
+		candidates.Clear();
+
+		//Objects are few, so there is room for all of them from the first call. The triangle list only grows to the most
+		//triangles a frustum has culled so far: the vectors are kept by the caller, and one per thread and light sized for
+		//every triangle of the scene would cost far more than the few times it grows
+		const std::vector<Sphere>& spheres{ m_SphereGeometries.GetItems() };
+		const std::vector<TriangleMesh>& meshes{ m_TriangleMeshGeometries.GetItems() };
+		candidates.spheres.reserve(spheres.size());
+		candidates.meshes.reserve(meshes.size());
+
+		for (uint32_t i{ 0 }; i < spheres.size(); ++i)
+		{
+			if (GeometryUtils::DoesSphereOverlapFrustum(frustum, spheres[i].origin, spheres[i].radius))
+				candidates.spheres.push_back(i);
+		}
+
+		for (uint32_t i{ 0 }; i < meshes.size(); ++i)
+		{
+			const TriangleMesh& mesh{ meshes[i] };
+			if (!GeometryUtils::DoesBoxOverlapFrustum(frustum, mesh.transformedMinAABB, mesh.transformedMaxAABB))
+				continue;
+
+			GeometryCandidates::MeshCandidate candidate{ i };
+			if (GeometryUtils::IsBoxInsideFrustum(frustum, mesh.transformedMinAABB, mesh.transformedMaxAABB))
+			{
+				candidate.isWholeMesh = true;
+				candidates.meshes.push_back(candidate);
+				continue;
+			}
+
+			candidate.firstTriangle = static_cast<uint32_t>(candidates.triangles.size());
+			const uint32_t numTriangles{ static_cast<uint32_t>(mesh.normals.size()) };
+			for (uint32_t triangle{ 0 }; triangle < numTriangles; ++triangle)
+			{
+				const int* pIndices{ &mesh.indices[triangle * 3] };
+				if (GeometryUtils::DoesTriangleOverlapFrustum(frustum, mesh.positions[pIndices[0]], mesh.positions[pIndices[1]], mesh.positions[pIndices[2]]))
+					candidates.triangles.push_back(triangle);
+			}
+			candidate.numTriangles = static_cast<uint32_t>(candidates.triangles.size()) - candidate.firstTriangle;
+			if (candidate.numTriangles > 0)
+				candidates.meshes.push_back(candidate);
+		}
+	}
+
+	void Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit, const GeometryCandidates& candidates) const
+	{
+		RAY_STAT(PrimaryRays);
+		HitRecord smallestRecord{ };
+		smallestRecord.t = FLT_MAX;
+
+		HitRecord temp{};
+		const std::vector<Sphere>& spheres{ m_SphereGeometries.GetItems() };
+		for (const uint32_t sphereIndex : candidates.spheres)
+		{
+			GeometryUtils::HitTest_Sphere(spheres[sphereIndex], ray, temp);
+			if (temp.t < smallestRecord.t) {
+				smallestRecord = temp;
+			}
+		}
+
+		for (const Plane& plane : m_PlaneGeometries.GetItems())
+		{
+			GeometryUtils::HitTest_Plane(plane, ray, temp);
+			if (temp.t < smallestRecord.t) {
+				smallestRecord = temp;
+			}
+		}
+
+		const std::vector<TriangleMesh>& meshes{ m_TriangleMeshGeometries.GetItems() };
+		for (const GeometryCandidates::MeshCandidate& candidate : candidates.meshes)
+		{
+			const TriangleMesh& mesh{ meshes[candidate.meshIndex] };
+			if (candidate.isWholeMesh)
+				GeometryUtils::HitTest_TriangleMesh(mesh, ray, temp);
+			else
+				GeometryUtils::HitTest_TriangleMesh(mesh, &candidates.triangles[candidate.firstTriangle], candidate.numTriangles, ray, temp);
+
+			if (temp.t < smallestRecord.t) {
+				smallestRecord = temp;
+			}
+		}
+
+		closestHit = smallestRecord;
+	}
+
+	bool Scene::DoesHit(const Ray& ray, const GeometryCandidates& candidates) const
+	{
+		RAY_STAT(ShadowRays);
+
+		HitRecord temp{};
+		const std::vector<Sphere>& spheres{ m_SphereGeometries.GetItems() };
+		for (const uint32_t sphereIndex : candidates.spheres)
+		{
+			if (GeometryUtils::HitTest_Sphere(spheres[sphereIndex], ray, temp, true)) {
+				RAY_STAT(ShadowEarlyOuts);
+				return true;
+			}
+		}
+
+		for (const Plane& plane : m_PlaneGeometries.GetItems())
+		{
+			if (GeometryUtils::HitTest_Plane(plane, ray, temp, true)) {
+				RAY_STAT(ShadowEarlyOuts);
+				return true;
+			}
+		}
+
+		const std::vector<TriangleMesh>& meshes{ m_TriangleMeshGeometries.GetItems() };
+		for (const GeometryCandidates::MeshCandidate& candidate : candidates.meshes)
+		{
+			const TriangleMesh& mesh{ meshes[candidate.meshIndex] };
+			const bool didHit{ candidate.isWholeMesh
+				? GeometryUtils::HitTest_TriangleMesh(mesh, ray, temp, true)
+				: GeometryUtils::HitTest_TriangleMesh(mesh, &candidates.triangles[candidate.firstTriangle], candidate.numTriangles, ray, temp, true) };
+			if (didHit) {
+				RAY_STAT(ShadowEarlyOuts);
 				return true;
 			}
 		}
@@ -87,40 +304,227 @@ namespace dae {
 		return false;
 	}
 
+	uint64_t Scene::GetNumTriangles() const
+	{
+		uint64_t numTriangles{ m_TriangleGeometries.GetSize() };
+		for (const TriangleMesh& mesh : m_TriangleMeshGeometries.GetItems())
+		{
+			numTriangles += mesh.indices.size() / 3;
+		}
+		return numTriangles;
+	}
+
+	uint64_t Scene::GetContentHash() const
+	{
+		uint64_t hash{ HashOffsetBasis };
+		const auto hashSize{ [&hash](size_t size) {
+			const uint64_t value{ size };
+			HashWords(hash, &value, 1);
+		} };
+
+		hashSize(m_SphereGeometries.GetItems().size());
+		HashWords(hash, m_SphereGeometries.GetItems());
+		hashSize(m_PlaneGeometries.GetItems().size());
+		HashWords(hash, m_PlaneGeometries.GetItems());
+		hashSize(m_TriangleGeometries.GetItems().size());
+		HashWords(hash, m_TriangleGeometries.GetItems());
+		hashSize(m_TriangleMeshGeometries.GetItems().size());
+		for (const TriangleMesh& mesh : m_TriangleMeshGeometries.GetItems())
+		{
+			//UpdateTransforms writes the world space vertices over these, so they are the ones rays are traced against
+			hashSize(mesh.positions.size());
+			HashWords(hash, mesh.positions);
+			hashSize(mesh.normals.size());
+			HashWords(hash, mesh.normals);
+			hashSize(mesh.indices.size());
+			HashWords(hash, mesh.indices);
+			HashWords(hash, &mesh.materialIndex, 1);
+			HashWords(hash, &mesh.cullMode, 1);
+		}
+		hashSize(m_Lights.GetItems().size());
+		HashWords(hash, m_Lights.GetItems());
+
+		//The type tells materials with the same parameters apart
+		hashSize(m_Materials.size());
+		for (const Material* pMaterial : m_Materials)
+		{
+			const char* const typeName{ typeid(*pMaterial).name() };
+			for (const char* pCharacter{ typeName }; *pCharacter != '\0'; ++pCharacter)
+			{
+				hash = HashWord(hash, static_cast<uint8_t>(*pCharacter));
+			}
+			hash = pMaterial->HashParameters(hash);
+		}
+		return hash;
+	}
+
+	size_t Scene::GetGeometryMemory() const
+	{
+		size_t bytes{ m_SphereGeometries.GetMemory()
+			+ m_PlaneGeometries.GetMemory()
+			+ m_TriangleGeometries.GetMemory()
+			+ m_TriangleMeshGeometries.GetMemory()
+			+ m_Lights.GetMemory()
+			+ m_Materials.capacity() * sizeof(Material*)
+			+ m_MaterialArena.GetMemory() };
+
+		for (const TriangleMesh& mesh : m_TriangleMeshGeometries.GetItems())
+		{
+			bytes += (mesh.positions.capacity() + mesh.normals.capacity() + mesh.transformedPositions.capacity() + mesh.transformedNormals.capacity()) * sizeof(Vector3)
+				+ mesh.indices.capacity() * sizeof(int);
+		}
+		return bytes;
+	}
+
+	void Scene::BuildRayQueryScene(RayQueryScene& queryScene) const
+	{
+		queryScene.Clear();
+		for (const Sphere& sphere : m_SphereGeometries.GetItems())
+			queryScene.AddSphere(sphere);
+		for (const Plane& plane : m_PlaneGeometries.GetItems())
+			queryScene.AddPlane(plane);
+		for (const TriangleMesh& mesh : m_TriangleMeshGeometries.GetItems())
+			queryScene.AddTriangleMesh(mesh);
+	}
+
+	void Scene::MarkGeometryChanged()
+	{
+		m_GeometryVersion = g_NextGeometryVersion.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	const std::vector<MovedBounds>* Scene::GetMovedBoundsSince(uint64_t geometryVersion) const
+	{
+		if (geometryVersion != m_MovedBoundsStartVersion || m_GeometryVersion != m_MovedBoundsEndVersion)
+			return nullptr;
+		return &m_MovedBounds;
+	}
+
+	bool Scene::RemoveSphere(SphereHandle handle)
+	{
+		if (!m_SphereGeometries.Remove(handle))
+			return false;
+		MarkGeometryChanged();
+		return true;
+	}
+
+	bool Scene::RemovePlane(PlaneHandle handle)
+	{
+		if (!m_PlaneGeometries.Remove(handle))
+			return false;
+		MarkGeometryChanged();
+		return true;
+	}
+
+	bool Scene::RemoveTriangleMesh(TriangleMeshHandle handle)
+	{
+		if (!m_TriangleMeshGeometries.Remove(handle))
+			return false;
+		MarkGeometryChanged();
+		return true;
+	}
+
+	bool Scene::RemoveLight(LightHandle handle)
+	{
+		if (!m_Lights.Remove(handle))
+			return false;
+		MarkGeometryChanged();
+		return true;
+	}
+
+	void Scene::CopyRenderState(const Scene& source)
+	{
+		PROFILE_SCOPE("CopyRenderState");
+		//Camera has const members and can't be assigned, the view is all rendering needs
+		m_Camera.origin = source.m_Camera.origin;
+		m_Camera.fovAngle = source.m_Camera.fovAngle;
+		m_Camera.forward = source.m_Camera.forward;
+		m_Camera.up = source.m_Camera.up;
+		m_Camera.right = source.m_Camera.right;
+		m_Camera.totalPitch = source.m_Camera.totalPitch;
+		m_Camera.totalYaw = source.m_Camera.totalYaw;
+		m_SphereGeometries.CopyFrom(source.m_SphereGeometries);
+		m_PlaneGeometries.CopyFrom(source.m_PlaneGeometries);
+		m_TriangleGeometries.CopyFrom(source.m_TriangleGeometries);
+		m_Lights.CopyFrom(source.m_Lights);
+		m_TriangleMeshGeometries.CopyFrom(source.m_TriangleMeshGeometries, [](TriangleMesh& destination, const TriangleMesh& sourceMesh, bool isSameItem) {
+			if (!isSameItem || destination.version != sourceMesh.version)
+			{
+				destination = sourceMesh;
+				return;
+			}
+			destination.materialIndex = sourceMesh.materialIndex;
+			destination.cullMode = sourceMesh.cullMode;
+		});
+		m_Materials = source.m_Materials;
+		m_GeometryVersion = source.m_GeometryVersion;
+		m_MovedBounds = source.m_MovedBounds;
+		m_MovedBoundsStartVersion = source.m_MovedBoundsStartVersion;
+		m_MovedBoundsEndVersion = source.m_MovedBoundsEndVersion;
+	}
+
 #pragma region Scene Helpers
-	Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
+	void Scene::UpdateMeshTransforms()
+	{
+		m_MovedBounds.clear();
+		m_MovedBoundsStartVersion = m_GeometryVersion;
+		for (TriangleMesh& mesh : m_TriangleMeshGeometries.GetItems())
+		{
+			if (!mesh.isDirty)
+				continue;
+
+			MovedBounds& bounds{ m_MovedBounds.emplace_back() };
+			bounds.previousMin = mesh.transformedMinAABB;
+			bounds.previousMax = mesh.transformedMaxAABB;
+
+			if (m_pExecutor && mesh.positions.size() >= 2 * VerticesPerJob)
+			{
+				UpdateMeshParallel(mesh, *m_pExecutor);
+			}
+			else
+			{
+				mesh.UpdateAABB();
+				mesh.UpdateTransforms();
+			}
+			bounds.min = mesh.transformedMinAABB;
+			bounds.max = mesh.transformedMaxAABB;
+			MarkGeometryChanged();
+		}
+		m_MovedBoundsEndVersion = m_GeometryVersion;
+	}
+
+	SphereHandle Scene::AddSphere(const Vector3& origin, float radius, MaterialId materialIndex)
 	{
 		Sphere s;
 		s.origin = origin;
 		s.radius = radius;
 		s.materialIndex = materialIndex;
 
-		m_SphereGeometries.emplace_back(s);
-		return &m_SphereGeometries.back();
+		MarkGeometryChanged();
+		return m_SphereGeometries.Add(s);
 	}
 
-	Plane* Scene::AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex)
+	PlaneHandle Scene::AddPlane(const Vector3& origin, const Vector3& normal, MaterialId materialIndex)
 	{
 		Plane p;
 		p.origin = origin;
 		p.normal = normal;
 		p.materialIndex = materialIndex;
 
-		m_PlaneGeometries.emplace_back(p);
-		return &m_PlaneGeometries.back();
+		MarkGeometryChanged();
+		return m_PlaneGeometries.Add(p);
 	}
 
-	TriangleMesh* Scene::AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex)
+	TriangleMeshHandle Scene::AddTriangleMesh(TriangleCullMode cullMode, MaterialId materialIndex)
 	{
 		TriangleMesh m{};
 		m.cullMode = cullMode;
 		m.materialIndex = materialIndex;
 
-		m_TriangleMeshGeometries.emplace_back(m);
-		return &m_TriangleMeshGeometries.back();
+		MarkGeometryChanged();
+		return m_TriangleMeshGeometries.Add(std::move(m));
 	}
 
-	Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
+	LightHandle Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
 	{
 		Light l;
 		l.origin = origin;
@@ -128,11 +532,11 @@ namespace dae {
 		l.color = color;
 		l.type = LightType::Point;
 
-		m_Lights.emplace_back(l);
-		return &m_Lights.back();
+		MarkGeometryChanged();
+		return m_Lights.Add(l);
 	}
 
-	Light* Scene::AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color)
+	LightHandle Scene::AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color)
 	{
 		Light l;
 		l.direction = direction;
@@ -140,14 +544,8 @@ namespace dae {
 		l.color = color;
 		l.type = LightType::Directional;
 
-		m_Lights.emplace_back(l);
-		return &m_Lights.back();
-	}
-
-	unsigned char Scene::AddMaterial(Material* pMaterial)
-	{
-		m_Materials.push_back(pMaterial);
-		return static_cast<unsigned char>(m_Materials.size() - 1);
+		MarkGeometryChanged();
+		return m_Lights.Add(l);
 	}
 #pragma endregion
 #pragma endregion
@@ -156,12 +554,12 @@ namespace dae {
 	void Scene_W1::Initialize()
 	{
 		//default: Material id0 >> SolidColor Material (RED)
-		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
+		constexpr MaterialId matId_Solid_Red = 0;
+		const MaterialId matId_Solid_Blue = AddMaterial<Material_SolidColor>(colors::Blue);
 
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		const MaterialId matId_Solid_Yellow = AddMaterial<Material_SolidColor>(colors::Yellow);
+		const MaterialId matId_Solid_Green = AddMaterial<Material_SolidColor>(colors::Green);
+		const MaterialId matId_Solid_Magenta = AddMaterial<Material_SolidColor>(colors::Magenta);
 
 		//Spheres
 		AddSphere({ -25.f, 0.f, 100.f }, 50.f, matId_Solid_Red);
@@ -182,11 +580,11 @@ namespace dae {
 		m_Camera.origin = { 0.f,3.f,-9.f };
 		m_Camera.fovAngle = 45.f;
 
-		constexpr unsigned char matId_Solid_Red = 0;
-		const unsigned char matId_Solid_Blue = AddMaterial(new Material_SolidColor{ colors::Blue });
-		const unsigned char matId_Solid_Yellow = AddMaterial(new Material_SolidColor{ colors::Yellow });
-		const unsigned char matId_Solid_Green = AddMaterial(new Material_SolidColor{ colors::Green });
-		const unsigned char matId_Solid_Magenta = AddMaterial(new Material_SolidColor{ colors::Magenta });
+		constexpr MaterialId matId_Solid_Red = 0;
+		const MaterialId matId_Solid_Blue = AddMaterial<Material_SolidColor>(colors::Blue);
+		const MaterialId matId_Solid_Yellow = AddMaterial<Material_SolidColor>(colors::Yellow);
+		const MaterialId matId_Solid_Green = AddMaterial<Material_SolidColor>(colors::Green);
+		const MaterialId matId_Solid_Magenta = AddMaterial<Material_SolidColor>(colors::Magenta);
 
 		//Plane
 		AddPlane({ -5.f, 0.f, 0.f }, { 1.f, 0.f,0.f }, matId_Solid_Green);
@@ -214,14 +612,14 @@ namespace dae {
 		m_Camera.origin = { 0.f,3.f,-9.f };
 		m_Camera.fovAngle = 45.f;
 
-		const auto matCT_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ .95f, .93f, .88f }, 1.f, 1.f));
-		const auto matCT_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ .95f, .93f, .88f }, 1.f, .6f));
-		const auto matCT_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ .95f, .93f, .88f }, 1.f, .1f));
-		const auto matCT_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ .95f, .93f, .88f }, 0.f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ .95f, .93f, .88f }, 0.f, .6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .95f, .93f, .88f }, 0.f, .1f));
+		const auto matCT_GrayRoughMetal = AddMaterial<Material_CookTorrence>(ColorRGB{ .95f, .93f, .88f }, 1.f, 1.f);
+		const auto matCT_GrayMediumMetal = AddMaterial<Material_CookTorrence>(ColorRGB{ .95f, .93f, .88f }, 1.f, .6f);
+		const auto matCT_GraySmoothMetal = AddMaterial<Material_CookTorrence>(ColorRGB{ .95f, .93f, .88f }, 1.f, .1f);
+		const auto matCT_GrayRoughPlastic = AddMaterial<Material_CookTorrence>(ColorRGB{ .95f, .93f, .88f }, 0.f, 1.f);
+		const auto matCT_GrayMediumPlastic = AddMaterial<Material_CookTorrence>(ColorRGB{ .95f, .93f, .88f }, 0.f, .6f);
+		const auto matCT_GraySmoothPlastic = AddMaterial<Material_CookTorrence>(ColorRGB{ .95f, .93f, .88f }, 0.f, .1f);
 
-		const auto matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, .57f, .57f }, 1.f));
+		const auto matLambert_GrayBlue = AddMaterial<Material_Lambert>(ColorRGB{ .49f, .57f, .57f }, 1.f);
 		
 		//Plane
 		AddPlane({ 0.f, 0.f, 10.f }, { 0.f, 0.f, -1.f }, matLambert_GrayBlue); //back
@@ -231,9 +629,9 @@ namespace dae {
 		AddPlane({ -5.f, 0.f, 0.f }, { 1.f, 0.f, 0.f  }, matLambert_GrayBlue); //left
 
 		//Spheres
-		/*const auto matLambertPhong1 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 3.f));
-		const auto matLambertPhong2 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 15.f));
-		const auto matLambertPhong3 = AddMaterial(new Material_LambertPhong(colors::Blue, 0.5f, 0.5f, 50.f));
+		/*const auto matLambertPhong1 = AddMaterial<Material_LambertPhong>(colors::Blue, 0.5f, 0.5f, 3.f);
+		const auto matLambertPhong2 = AddMaterial<Material_LambertPhong>(colors::Blue, 0.5f, 0.5f, 15.f);
+		const auto matLambertPhong3 = AddMaterial<Material_LambertPhong>(colors::Blue, 0.5f, 0.5f, 50.f);
 		AddSphere({ -1.75f, 1.f, 0.f }, .75f, matLambertPhong1);
 		AddSphere({ 0.f,    1.f, 0.f }, .75f, matLambertPhong2);
 		AddSphere({ 1.75f,  1.f, 0.f }, .75f, matLambertPhong3);*/
@@ -257,11 +655,11 @@ namespace dae {
 		m_Camera.origin = { 0.f,1.f,-5.f };
 		m_Camera.fovAngle = 45.f;
 
-		const unsigned char matLambert_Red = AddMaterial(new Material_Lambert(colors::Red, 1.f));
-		const unsigned char matLambert_Yellow = AddMaterial(new Material_Lambert(colors::Yellow, 1.f));
-		const auto matLambertPhong_Blue = AddMaterial(new Material_LambertPhong(colors::Blue, 1.f, 1.f, 60.f));
+		const MaterialId matLambert_Red = AddMaterial<Material_Lambert>(colors::Red, 1.f);
+		const MaterialId matLambert_Yellow = AddMaterial<Material_Lambert>(colors::Yellow, 1.f);
+		const auto matLambertPhong_Blue = AddMaterial<Material_LambertPhong>(colors::Blue, 1.f, 1.f, 60.f);
 
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .95f, .93f, .88f }, 0.f, .1f));
+		const auto matCT_GraySmoothPlastic = AddMaterial<Material_CookTorrence>(ColorRGB{ .95f, .93f, .88f }, 0.f, .1f);
 
 
 		//spheres
@@ -287,8 +685,8 @@ namespace dae {
 
 		m_Camera.fovAngle = 45.f;
 
-		const unsigned char matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, .57f, .57f }, 1.f));
-		const unsigned char matLambert_White = AddMaterial(new Material_Lambert(colors::Gray, 1.f));
+		const MaterialId matLambert_GrayBlue = AddMaterial<Material_Lambert>(ColorRGB{ .49f, .57f, .57f }, 1.f);
+		const MaterialId matLambert_White = AddMaterial<Material_Lambert>(colors::Gray, 1.f);
 
 		//plane
 		AddPlane({ 0.f,0.f,10.f }, { 0.f,0.f,-1.f }, matLambert_GrayBlue);
@@ -305,7 +703,8 @@ namespace dae {
 		m_TriangleGeometries.emplace_back(triangle);*/
 
 		//2 triangles
-		pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
+		m_Mesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
+		TriangleMesh* pMesh{ GetTriangleMesh(m_Mesh) };
 		pMesh->positions = {
 			{ -.75f,  -1.f, .0f},
 			{ -.75f,  1.f,  .0f},
@@ -342,9 +741,8 @@ namespace dae {
 	void Scene_W4_Test::Update(Timer* pTimer) {
 		Scene::Update(pTimer);
 
-		//pMesh->RotateY(PI_DIV_2 * pTimer->GetTotal());
-		pMesh->UpdateAABB();
-		pMesh->UpdateTransforms();
+		//GetTriangleMesh(m_Mesh)->RotateY(PI_DIV_2 * pTimer->GetTotal());
+		UpdateMeshTransforms();
 	}
 #pragma endregion
 
@@ -354,15 +752,15 @@ namespace dae {
 		m_Camera.origin = { 0.f, 3.f, -9.f };
 		m_Camera.fovAngle = 45.f;
 
-		const auto matCT_GrayRoughMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, 1.f));
-		const auto matCT_GrayMediumMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .6f));
-		const auto matCT_GraySmoothMetal = AddMaterial(new Material_CookTorrence({ .972f, .960f, .915f }, 1.f, .1f));
-		const auto matCT_GrayRoughPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, 0.f, 1.f));
-		const auto matCT_GrayMediumPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, 0.f, .6f));
-		const auto matCT_GraySmoothPlastic = AddMaterial(new Material_CookTorrence({ .75f, .75f, .75f }, 0.f, .1f));
+		const auto matCT_GrayRoughMetal = AddMaterial<Material_CookTorrence>(ColorRGB{ .972f, .960f, .915f }, 1.f, 1.f);
+		const auto matCT_GrayMediumMetal = AddMaterial<Material_CookTorrence>(ColorRGB{ .972f, .960f, .915f }, 1.f, .6f);
+		const auto matCT_GraySmoothMetal = AddMaterial<Material_CookTorrence>(ColorRGB{ .972f, .960f, .915f }, 1.f, .1f);
+		const auto matCT_GrayRoughPlastic = AddMaterial<Material_CookTorrence>(ColorRGB{ .75f, .75f, .75f }, 0.f, 1.f);
+		const auto matCT_GrayMediumPlastic = AddMaterial<Material_CookTorrence>(ColorRGB{ .75f, .75f, .75f }, 0.f, .6f);
+		const auto matCT_GraySmoothPlastic = AddMaterial<Material_CookTorrence>(ColorRGB{ .75f, .75f, .75f }, 0.f, .1f);
 
-		const unsigned char matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, .57f, .57f }, 1.f));
-		const unsigned char matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const MaterialId matLambert_GrayBlue = AddMaterial<Material_Lambert>(ColorRGB{ .49f, .57f, .57f }, 1.f);
+		const MaterialId matLambert_White = AddMaterial<Material_Lambert>(colors::White, 1.f);
 
 		//plane
 		AddPlane({ 0.f,0.f,10.f }, { 0.f,0.f,-1.f }, matLambert_GrayBlue);
@@ -381,26 +779,17 @@ namespace dae {
 
 		//meshes
 		const Triangle baseTriangle = { Vector3( -.75f, 1.5f, 0.f ), Vector3( .75f, 0.f, 0.f ), Vector3( -.75f, 0.f, 0.f ) };
-		m_Meshes[0] = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		m_Meshes[0]->AppendTriangle(baseTriangle, true);
-		m_Meshes[0]->normals.reserve(m_Meshes[0]->indices.size());
-		m_Meshes[0]->Translate({ -1.75f, 4.5f, 0.f });
-		m_Meshes[0]->UpdateAABB();
-		m_Meshes[0]->UpdateTransforms();
-
-		m_Meshes[1] = AddTriangleMesh(TriangleCullMode::FrontFaceCulling, matLambert_White);
-		m_Meshes[1]->AppendTriangle(baseTriangle, true);
-		m_Meshes[1]->normals.reserve(m_Meshes[0]->indices.size());
-		m_Meshes[1]->Translate({ 0.f, 4.5f, 0.f });
-		m_Meshes[1]->UpdateAABB();
-		m_Meshes[1]->UpdateTransforms();
-
-		m_Meshes[2] = AddTriangleMesh(TriangleCullMode::NoCulling, matLambert_White);
-		m_Meshes[2]->AppendTriangle(baseTriangle, true);
-		m_Meshes[2]->normals.reserve(m_Meshes[0]->indices.size());
-		m_Meshes[2]->Translate({ 1.75f, 4.5f, 0.f });
-		m_Meshes[2]->UpdateAABB();
-		m_Meshes[2]->UpdateTransforms();
+		const TriangleCullMode cullModes[3]{ TriangleCullMode::BackFaceCulling, TriangleCullMode::FrontFaceCulling, TriangleCullMode::NoCulling };
+		for (int i{ 0 }; i < 3; ++i)
+		{
+			m_Meshes[i] = AddTriangleMesh(cullModes[i], matLambert_White);
+			TriangleMesh* pMesh{ GetTriangleMesh(m_Meshes[i]) };
+			pMesh->AppendTriangle(baseTriangle, true);
+			pMesh->normals.reserve(pMesh->indices.size());
+			pMesh->Translate({ -1.75f + 1.75f * i, 4.5f, 0.f });
+			pMesh->UpdateAABB();
+			pMesh->UpdateTransforms();
+		}
 
 		//light
 		AddPointLight({ 0.f,5.f,5.f }, 50.f, ColorRGB(1.f, .61f, .45f));
@@ -412,12 +801,11 @@ namespace dae {
 		Scene::Update(pTimer);
 
 		float yawAngle{ (cos(pTimer->GetTotal()) + 1.f) / 2.f * PI_2 };
-		for (const auto& m: m_Meshes)
+		for (TriangleMeshHandle handle : m_Meshes)
 		{
-			m->RotateY(yawAngle);
-			m->UpdateAABB();
-			m->UpdateTransforms();
+			GetTriangleMesh(handle)->RotateY(yawAngle);
 		}
+		UpdateMeshTransforms();
 	}
 #pragma endregion
 
@@ -428,8 +816,8 @@ namespace dae {
 		m_Camera.origin = { 0.f, 3.f, -9.f };
 		m_Camera.fovAngle = 45.f;
 
-		const unsigned char matLambert_GrayBlue = AddMaterial(new Material_Lambert({ .49f, .57f, .57f }, 1.f));
-		const unsigned char matLambert_White = AddMaterial(new Material_Lambert(colors::White, 1.f));
+		const MaterialId matLambert_GrayBlue = AddMaterial<Material_Lambert>(ColorRGB{ .49f, .57f, .57f }, 1.f);
+		const MaterialId matLambert_White = AddMaterial<Material_Lambert>(colors::White, 1.f);
 
 		//plane
 		AddPlane({ 0.f,0.f,10.f }, { 0.f,0.f,-1.f }, matLambert_GrayBlue);
@@ -440,17 +828,18 @@ namespace dae {
 
 
 		//bunny
-		m_pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
+		m_Mesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
+		TriangleMesh* pMesh{ GetTriangleMesh(m_Mesh) };
 		Utils::ParseOBJ("Resources/lowpoly_bunny2.obj",
-			m_pMesh->positions,
-			m_pMesh->normals,
-			m_pMesh->indices
+			pMesh->positions,
+			pMesh->normals,
+			pMesh->indices
 		);
 
-		m_pMesh->Scale({ 2.f, 2.f, 2.f });
+		pMesh->Scale({ 2.f, 2.f, 2.f });
 
-		m_pMesh->UpdateAABB();
-		m_pMesh->UpdateTransforms();
+		pMesh->UpdateAABB();
+		pMesh->UpdateTransforms();
 
 		//light
 		AddPointLight({ 0.f,5.f,5.f }, 50.f, ColorRGB(1.f, .61f, .45f));
@@ -462,11 +851,116 @@ namespace dae {
 		Scene::Update(pTimer);
 
 		float yawAngle{ (cos(pTimer->GetTotal()) + 1.f) / 2.f * PI_2 };
-		m_pMesh->RotateY(yawAngle);
-		m_pMesh->UpdateAABB();
-		m_pMesh->UpdateTransforms();
+		GetTriangleMesh(m_Mesh)->RotateY(yawAngle);
+		UpdateMeshTransforms();
 	}
 #pragma endregion
 
+#pragma region Stress
+	Scene_Stress::Scene_Stress(const StressSceneSettings& settings) :
+		m_Settings(settings)
+	{
+	}
+
+	void Scene_Stress::Initialize()
+	{
+		sceneName = "Stress Scene";
+		m_Camera.origin = { 0.f, 12.f, -32.f };
+		m_Camera.fovAngle = 45.f;
+
+		uint32_t seed{ PcgHash(m_Settings.seed) };
+		const auto random{ [&seed](float min, float max) { return min + RandomFloat(seed) * (max - min); } };
+
+		constexpr int NumMaterials{ 8 };
+		MaterialId materials[NumMaterials]{};
+		for (int i{ 0 }; i < NumMaterials; ++i)
+		{
+			const ColorRGB albedo{ random(.2f, 1.f), random(.2f, 1.f), random(.2f, 1.f) };
+			const float roughness{ random(.1f, 1.f) };
+			materials[i] = i % 2 == 0 ?
+				AddMaterial<Material_Lambert>(albedo, 1.f) :
+				AddMaterial<Material_CookTorrence>(albedo, i % 4 == 1 ? 1.f : 0.f, roughness);
+		}
+		const auto randomMaterial{ [&]() { return materials[static_cast<int>(random(0.f, NumMaterials - .001f))]; } };
+
+		//Scene area, terrain is centered at the origin
+		constexpr float AreaSize{ 40.f };
+		constexpr float HalfArea{ AreaSize / 2.f };
+		constexpr float TerrainHeight{ 1.f };
 
+		//Pools grow once up front instead of doubling while the scene is built
+		m_SphereGeometries.Reserve(m_Settings.numSpheres);
+		m_TriangleMeshGeometries.Reserve(m_Settings.numMeshInstances + 1);
+		m_Lights.Reserve(m_Settings.numLights);
+
+		//ground
+		if (m_Settings.terrainResolution > 0)
+		{
+			TriangleMesh* pTerrain{ GetTriangleMesh(AddTriangleMesh(TriangleCullMode::BackFaceCulling, randomMaterial())) };
+			Utils::GenerateTerrain(m_Settings.terrainResolution, AreaSize, TerrainHeight, seed, pTerrain->positions, pTerrain->normals, pTerrain->indices);
+			pTerrain->UpdateAABB();
+			pTerrain->UpdateTransforms();
+		}
+		else
+		{
+			AddPlane({ 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f }, randomMaterial());
+		}
+
+		//spheres
+		for (uint32_t i{ 0 }; i < m_Settings.numSpheres; ++i)
+		{
+			//Separate statements, the evaluation order of function arguments is unspecified
+			const Vector3 origin{ random(-HalfArea, HalfArea), random(TerrainHeight * 2.f, 8.f), random(-HalfArea, HalfArea) };
+			const float radius{ random(.2f, 1.f) };
+			const MaterialId material{ randomMaterial() };
+			AddSphere(origin, radius, material);
+		}
+
+		//mesh instances, placed directly in world space
+		std::vector<Vector3> positions{};
+		std::vector<Vector3> normals{};
+		std::vector<int> indices{};
+		if (m_Settings.numMeshInstances > 0)
+			Utils::GenerateIcosphere(m_Settings.meshSubdivisions, positions, normals, indices);
+
+		for (uint32_t i{ 0 }; i < m_Settings.numMeshInstances; ++i)
+		{
+			const float scale{ random(.5f, 2.f) };
+			const Vector3 offset{ random(-HalfArea, HalfArea), random(TerrainHeight * 2.f + scale, 10.f), random(-HalfArea, HalfArea) };
+
+			TriangleMesh* pMesh{ GetTriangleMesh(AddTriangleMesh(TriangleCullMode::BackFaceCulling, randomMaterial())) };
+			pMesh->positions.resize(positions.size());
+			for (size_t vertex{ 0 }; vertex < positions.size(); ++vertex)
+			{
+				pMesh->positions[vertex] = positions[vertex] * scale + offset;
+			}
+			pMesh->normals = normals;
+			pMesh->indices = indices;
+			pMesh->UpdateAABB();
+			pMesh->UpdateTransforms();
+		}
+
+		//lights
+		for (uint32_t i{ 0 }; i < m_Settings.numLights; ++i)
+		{
+			const Vector3 origin{ random(-HalfArea, HalfArea), random(12.f, 20.f), random(-HalfArea, HalfArea) };
+			const float intensity{ random(300.f, 600.f) };
+			const ColorRGB color{ 1.f, random(.6f, 1.f), random(.4f, 1.f) };
+			AddPointLight(origin, intensity, color);
+		}
+	}
+#pragma endregion
+
+	Scene* CreateScene(const std::string& name)
+	{
+		if (name == "W1") return new Scene_W1();
+		if (name == "W2") return new Scene_W2();
+		if (name == "W3") return new Scene_W3();
+		if (name == "W3_Test") return new Scene_W3_Test();
+		if (name == "W4_Test") return new Scene_W4_Test();
+		if (name == "W4_Reference") return new Scene_W4_ReferenceScene();
+		if (name == "W4_Bunny") return new Scene_W4_Bunny();
+		if (name == "Stress") return new Scene_Stress(StressSceneSettings{});
+		return nullptr;
+	}
 }
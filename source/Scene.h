@@ -1,10 +1,12 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <vector>
 
 #include "Math.h"
 #include "DataTypes.h"
 #include "Camera.h"
+#include "SceneStorage.h"
 
 namespace dae
 {
@@ -15,6 +17,47 @@ namespace dae
 	struct Sphere;
 	struct Light;
 	struct Triangle;
+	class RayQueryScene;
+	class Executor;
+
+	using SphereHandle = Handle<Sphere>;
+	using PlaneHandle = Handle<Plane>;
+	using TriangleMeshHandle = Handle<TriangleMesh>;
+	using LightHandle = Handle<Light>;
+
+	//World space bounds of a mesh before and after it moved
+	struct MovedBounds
+	{
+		Vector3 previousMin{};
+		Vector3 previousMax{};
+		Vector3 min{};
+		Vector3 max{};
+	};
+
+	//Geometry a group of rays can hit, filled by Scene::CullGeometry. Reused to avoid allocating, the vectors only grow
+	struct GeometryCandidates
+	{
+		struct MeshCandidate
+		{
+			uint32_t meshIndex{};
+			//Range of triangles, ignored when the whole mesh is a candidate
+			uint32_t firstTriangle{};
+			uint32_t numTriangles{};
+			bool isWholeMesh{};
+		};
+
+		//Indices into the sphere and mesh lists of the scene, ascending so hits are tested in the same order as without culling
+		std::vector<uint32_t> spheres{};
+		std::vector<MeshCandidate> meshes{};
+		std::vector<uint32_t> triangles{};
+
+		void Clear()
+		{
+			spheres.clear();
+			meshes.clear();
+			triangles.clear();
+		}
+	};
 
 	//Scene Base Class
 	class Scene
@@ -35,33 +78,101 @@ namespace dae
 		}
 
 		Camera& GetCamera() { return m_Camera; }
+		//Used to update large meshes in parallel, nullptr updates everything on the calling thread
+		void SetExecutor(Executor* pExecutor) { m_pExecutor = pExecutor; }
 		void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
 		bool DoesHit(const Ray& ray) const;
+		/**
+		 * \brief Collects the spheres, meshes and mesh triangles that overlap the frustum, planes are infinite and always tested.
+		 * Rays that stay inside the frustum get the same result from the overloads below as from testing the whole scene
+		 */
+		void CullGeometry(const Frustum& frustum, GeometryCandidates& candidates) const;
+		void GetClosestHit(const Ray& ray, HitRecord& closestHit, const GeometryCandidates& candidates) const;
+		bool DoesHit(const Ray& ray, const GeometryCandidates& candidates) const;
+
+		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries.GetItems(); }
+		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries.GetItems(); }
+		const std::vector<Light>& GetLights() const { return m_Lights.GetItems(); }
+		const std::vector<Material*>& GetMaterials() const { return m_Materials; }
+
+		//nullptr once the item was removed. The pointer is only valid until the next Add or Remove of the same type
+		Sphere* GetSphere(SphereHandle handle) { return m_SphereGeometries.Get(handle); }
+		Plane* GetPlane(PlaneHandle handle) { return m_PlaneGeometries.Get(handle); }
+		TriangleMesh* GetTriangleMesh(TriangleMeshHandle handle) { return m_TriangleMeshGeometries.Get(handle); }
+		Light* GetLight(LightHandle handle) { return m_Lights.Get(handle); }
 
-		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries; }
-		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
-		const std::vector<Light>& GetLights() const { return m_Lights; }
-		const std::vector<Material*> GetMaterials() const { return m_Materials; }
+		bool RemoveSphere(SphereHandle handle);
+		bool RemovePlane(PlaneHandle handle);
+		bool RemoveTriangleMesh(TriangleMeshHandle handle);
+		bool RemoveLight(LightHandle handle);
+
+		/**
+		 * \brief Changes whenever geometry or lights are added, removed or moved, caches built from the scene compare it to know when to rebuild.
+		 * Versions are unique across all scenes, so a cache built from one scene never matches another. Snapshots share the version of their source.
+		 * Edits made through the Get* pointers have to be followed by MarkGeometryChanged.
+		 */
+		uint64_t GetGeometryVersion() const { return m_GeometryVersion; }
+		void MarkGeometryChanged();
+		/**
+		 * \brief Bounds of the meshes that moved since the given geometry version, so a cache only has to update what they touched.
+		 * nullptr when anything else changed since then, or when the changes go back further than the last UpdateMeshTransforms
+		 */
+		const std::vector<MovedBounds>* GetMovedBoundsSince(uint64_t geometryVersion) const;
+
+		uint64_t GetNumTriangles() const;
+		/**
+		 * \brief Hash of the geometry, lights and materials as they are now, unlike the geometry version it is the same for the
+		 * same scene content in every process. Walks every vertex, so it is meant for the odd checkpoint, not for every frame
+		 */
+		uint64_t GetContentHash() const;
+		//Bytes allocated for geometry, lights and materials
+		size_t GetGeometryMemory() const;
+		//Copies the current geometry into queryScene, replacing what it held
+		void BuildRayQueryScene(RayQueryScene& queryScene) const;
+		/**
+		 * \brief Copies the camera, geometry and lights of source so this scene renders the same image.
+		 * Materials are shared with source, not copied. Meshes whose version didn't change since the last copy keep their vertices.
+		 */
+		void CopyRenderState(const Scene& source);
 
 	protected:
 		std::string	sceneName;
 
-		std::vector<Plane> m_PlaneGeometries{};
-		std::vector<Sphere> m_SphereGeometries{};
-		std::vector<Triangle> m_TriangleGeometries{};
-		std::vector<TriangleMesh> m_TriangleMeshGeometries{};
-		std::vector<Light> m_Lights{};
+		HandlePool<Plane> m_PlaneGeometries{};
+		HandlePool<Sphere> m_SphereGeometries{};
+		HandlePool<Triangle> m_TriangleGeometries{};
+		HandlePool<TriangleMesh> m_TriangleMeshGeometries{};
+		HandlePool<Light> m_Lights{};
+		//Point into m_MaterialArena, which owns the materials
 		std::vector<Material*> m_Materials{};
+		ObjectArena m_MaterialArena{};
 
 		Camera m_Camera{};
+		uint64_t m_GeometryVersion{};
+		Executor* m_pExecutor{};
+
+		//Meshes moved by the last UpdateMeshTransforms, which went from the first to the second geometry version
+		std::vector<MovedBounds> m_MovedBounds{};
+		uint64_t m_MovedBoundsStartVersion{};
+		uint64_t m_MovedBoundsEndVersion{};
+
+		//Applies the pending transforms of every mesh that moved, meshes that did not move cost nothing
+		void UpdateMeshTransforms();
 
-		Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
-		Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
-		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
+		SphereHandle AddSphere(const Vector3& origin, float radius, MaterialId materialIndex = 0);
+		PlaneHandle AddPlane(const Vector3& origin, const Vector3& normal, MaterialId materialIndex = 0);
+		TriangleMeshHandle AddTriangleMesh(TriangleCullMode cullMode, MaterialId materialIndex = 0);
 
-		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
-		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
-		unsigned char AddMaterial(Material* pMaterial);
+		LightHandle AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
+		LightHandle AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
+
+		//Constructs the material in the scene's material arena
+		template<typename T, typename... Args>
+		MaterialId AddMaterial(Args&&... args)
+		{
+			m_Materials.push_back(m_MaterialArena.Create<T>(std::forward<Args>(args)...));
+			return static_cast<MaterialId>(m_Materials.size() - 1);
+		}
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -141,7 +252,7 @@ namespace dae
 		void Initialize() override;
 		void Update(Timer* pTimer) override;
 	private:
-		TriangleMesh* pMesh{ nullptr };
+		TriangleMeshHandle m_Mesh{};
 	};
 	
 	class Scene_W4_ReferenceScene final : public Scene
@@ -158,7 +269,7 @@ namespace dae
 		void Initialize() override;
 		void Update(Timer* pTimer) override;
 	private:
-		TriangleMesh* m_Meshes[3]{};
+		TriangleMeshHandle m_Meshes[3]{};
 	};
 	
 	class Scene_W4_Bunny final : public Scene
@@ -176,6 +287,45 @@ namespace dae
 		void Update(Timer* pTimer);
 
 	private:
-		TriangleMesh* m_pMesh{ nullptr };
+		TriangleMeshHandle m_Mesh{};
 	};
+
+	//+++++++++++++++++++++++++++++++++++++++++
+	//Procedural stress scene
+	struct StressSceneSettings
+	{
+		uint32_t seed{ 1 };
+		uint32_t numSpheres{ 64 };
+		uint32_t numLights{ 4 };
+		//Copies of one icosphere mesh, the mesh data is duplicated for every instance
+		uint32_t numMeshInstances{ 4 };
+		//20 * 4^subdivisions triangles per instance
+		int meshSubdivisions{ 2 };
+		//2 * resolution^2 triangles, 0 for a flat plane instead
+		int terrainResolution{ 16 };
+	};
+
+	//Random spheres, lights, meshes and a height field on a 40x40 area, generated from a seed so every run builds the same scene
+	class Scene_Stress final : public Scene
+	{
+	public:
+		Scene_Stress(const StressSceneSettings& settings);
+		~Scene_Stress() override = default;
+
+		Scene_Stress(const Scene_Stress&) = delete;
+		Scene_Stress(Scene_Stress&&) noexcept = delete;
+		Scene_Stress& operator=(const Scene_Stress&) = delete;
+		Scene_Stress& operator=(Scene_Stress&&) noexcept = delete;
+
+		void Initialize() override;
+
+	private:
+		StressSceneSettings m_Settings{};
+	};
+
+	/**
+	 * \brief Creates one of the scenes above by name (W1, W2, W3, W3_Test, W4_Test, W4_Reference, W4_Bunny, Stress)
+	 * \return new, uninitialized scene owned by the caller, nullptr for an unknown name
+	 */
+	Scene* CreateScene(const std::string& name);
 }
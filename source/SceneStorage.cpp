@@ -0,0 +1,66 @@
+#include "SceneStorage.h"
+
+#include <algorithm>
+
+namespace dae {
+	ObjectArena::ObjectArena(size_t blockSize) :
+		m_BlockSize(blockSize)
+	{
+	}
+
+	ObjectArena::~ObjectArena()
+	{
+		Clear();
+		for (unsigned char* pBlock : m_Blocks)
+		{
+			::operator delete(pBlock, std::align_val_t{ BlockAlignment });
+		}
+		m_Blocks.clear();
+	}
+
+	void ObjectArena::Clear()
+	{
+		for (auto it{ m_Destructors.rbegin() }; it != m_Destructors.rend(); ++it)
+		{
+			it->destroy(it->pObject);
+		}
+		m_Destructors.clear();
+
+		while (m_Blocks.size() > 1)
+		{
+			::operator delete(m_Blocks.back(), std::align_val_t{ BlockAlignment });
+			m_Blocks.pop_back();
+			m_BlockSizes.pop_back();
+		}
+		m_Offset = 0;
+	}
+
+	size_t ObjectArena::GetMemory() const
+	{
+		size_t bytes{ m_Destructors.capacity() * sizeof(Destructor) };
+		for (size_t blockSize : m_BlockSizes)
+		{
+			bytes += blockSize;
+		}
+		return bytes;
+	}
+
+	void* ObjectArena::Allocate(size_t size, size_t alignment)
+	{
+		assert(alignment <= BlockAlignment && "Alignment larger than the arena blocks");
+
+		const size_t start{ (m_Offset + alignment - 1) & ~(alignment - 1) };
+		if (!m_Blocks.empty() && start + size <= m_BlockSizes.back())
+		{
+			m_Offset = start + size;
+			return m_Blocks.back() + start;
+		}
+
+		//Objects bigger than a block get a block of their own
+		const size_t blockSize{ std::max(m_BlockSize, size) };
+		m_Blocks.push_back(static_cast<unsigned char*>(::operator new(blockSize, std::align_val_t{ BlockAlignment })));
+		m_BlockSizes.push_back(blockSize);
+		m_Offset = size;
+		return m_Blocks.back();
+	}
+}
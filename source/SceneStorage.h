@@ -0,0 +1,238 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace dae
+{
+	//Refers to an item of a HandlePool. Stays valid while the item lives, the generation tells a removed item apart from a new one in the same slot
+	template<typename T>
+	struct Handle
+	{
+		static constexpr uint32_t InvalidIndex{ UINT32_MAX };
+
+		uint32_t index{ InvalidIndex };
+		uint32_t generation{};
+
+		bool IsValid() const { return index != InvalidIndex; }
+		bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; }
+		bool operator!=(const Handle& other) const { return !(*this == other); }
+	};
+
+	/**
+	 * \brief Stores items contiguously, without gaps, so they can be iterated like a vector.
+	 * Removing an item moves the last one into its place, handles follow the move through a slot table.
+	 * Pointers into the pool are invalidated by Add and Remove, handles are not.
+	 */
+	template<typename T>
+	class HandlePool final
+	{
+	public:
+		HandlePool() = default;
+		~HandlePool() = default;
+
+		HandlePool(const HandlePool&) = delete;
+		HandlePool(HandlePool&&) noexcept = delete;
+		HandlePool& operator=(const HandlePool&) = delete;
+		HandlePool& operator=(HandlePool&&) noexcept = delete;
+
+		Handle<T> Add(T item)
+		{
+			uint32_t slotIndex{};
+			if (m_FreeSlots.empty())
+			{
+				slotIndex = static_cast<uint32_t>(m_Slots.size());
+				m_Slots.push_back({});
+			}
+			else
+			{
+				slotIndex = m_FreeSlots.back();
+				m_FreeSlots.pop_back();
+			}
+
+			Slot& slot{ m_Slots[slotIndex] };
+			slot.itemIndex = static_cast<uint32_t>(m_Items.size());
+			m_Items.push_back(std::move(item));
+			m_ItemSlots.push_back(slotIndex);
+			return { slotIndex, slot.generation };
+		}
+
+		//Returns false if the handle was already stale
+		bool Remove(Handle<T> handle)
+		{
+			if (!IsAlive(handle))
+				return false;
+
+			Slot& slot{ m_Slots[handle.index] };
+			const uint32_t lastItem{ static_cast<uint32_t>(m_Items.size() - 1) };
+			if (slot.itemIndex != lastItem)
+			{
+				m_Items[slot.itemIndex] = std::move(m_Items[lastItem]);
+				m_ItemSlots[slot.itemIndex] = m_ItemSlots[lastItem];
+				m_Slots[m_ItemSlots[slot.itemIndex]].itemIndex = slot.itemIndex;
+			}
+			m_Items.pop_back();
+			m_ItemSlots.pop_back();
+
+			++slot.generation;
+			slot.itemIndex = InvalidItem;
+			m_FreeSlots.push_back(handle.index);
+			return true;
+		}
+
+		bool IsAlive(Handle<T> handle) const
+		{
+			return handle.index < m_Slots.size()
+				&& m_Slots[handle.index].generation == handle.generation
+				&& m_Slots[handle.index].itemIndex != InvalidItem;
+		}
+
+		//nullptr when the handle is stale
+		T* Get(Handle<T> handle)
+		{
+			return IsAlive(handle) ? &m_Items[m_Slots[handle.index].itemIndex] : nullptr;
+		}
+		const T* Get(Handle<T> handle) const
+		{
+			return IsAlive(handle) ? &m_Items[m_Slots[handle.index].itemIndex] : nullptr;
+		}
+
+		void Reserve(size_t count)
+		{
+			m_Items.reserve(count);
+			m_ItemSlots.reserve(count);
+			m_Slots.reserve(count);
+		}
+
+		//Invalidates every handle handed out so far
+		void Clear()
+		{
+			for (size_t i{ 0 }; i < m_ItemSlots.size(); ++i)
+			{
+				Slot& slot{ m_Slots[m_ItemSlots[i]] };
+				++slot.generation;
+				slot.itemIndex = InvalidItem;
+				m_FreeSlots.push_back(m_ItemSlots[i]);
+			}
+			m_Items.clear();
+			m_ItemSlots.clear();
+		}
+
+		/**
+		 * \brief Makes this pool a copy of other, handles of other refer to the same items in both afterwards.
+		 * Reuses the memory of this pool, so copying every frame doesn't allocate once the pool is big enough.
+		 * \param copyItem called as copyItem(T& destination, const T& source, bool isSameItem), isSameItem is true when
+		 * destination was copied from the same item of other before, so data that didn't change can be skipped
+		 */
+		template<typename CopyItem>
+		void CopyFrom(const HandlePool& other, CopyItem copyItem)
+		{
+			const size_t numItems{ other.m_Items.size() };
+			const size_t numPrevious{ std::min(m_Items.size(), numItems) };
+			for (size_t i{ 0 }; i < numPrevious; ++i)
+			{
+				const uint32_t slotIndex{ other.m_ItemSlots[i] };
+				const bool isSameItem{ m_ItemSlots[i] == slotIndex && m_Slots[slotIndex].generation == other.m_Slots[slotIndex].generation };
+				copyItem(m_Items[i], other.m_Items[i], isSameItem);
+			}
+
+			m_Items.resize(numItems);
+			for (size_t i{ numPrevious }; i < numItems; ++i)
+			{
+				copyItem(m_Items[i], other.m_Items[i], false);
+			}
+
+			m_ItemSlots = other.m_ItemSlots;
+			m_Slots = other.m_Slots;
+			m_FreeSlots = other.m_FreeSlots;
+		}
+
+		void CopyFrom(const HandlePool& other)
+		{
+			CopyFrom(other, [](T& destination, const T& source, bool) { destination = source; });
+		}
+
+		size_t GetSize() const { return m_Items.size(); }
+		bool IsEmpty() const { return m_Items.empty(); }
+
+		//All living items, in insertion order until the first Remove
+		std::vector<T>& GetItems() { return m_Items; }
+		const std::vector<T>& GetItems() const { return m_Items; }
+
+		//Bytes of the pool itself, not of memory owned by the items
+		size_t GetMemory() const
+		{
+			return m_Items.capacity() * sizeof(T)
+				+ m_ItemSlots.capacity() * sizeof(uint32_t)
+				+ m_Slots.capacity() * sizeof(Slot)
+				+ m_FreeSlots.capacity() * sizeof(uint32_t);
+		}
+
+	private:
+		static constexpr uint32_t InvalidItem{ UINT32_MAX };
+
+		struct Slot
+		{
+			uint32_t itemIndex{ InvalidItem };
+			uint32_t generation{};
+		};
+
+		std::vector<T> m_Items{};
+		//Slot of every item, to fix up the slot of the item moved by Remove
+		std::vector<uint32_t> m_ItemSlots{};
+		std::vector<Slot> m_Slots{};
+		std::vector<uint32_t> m_FreeSlots{};
+	};
+
+	//Owns objects of any type, packed into large blocks. Objects never move and are all destroyed together with the arena
+	class ObjectArena final
+	{
+	public:
+		ObjectArena(size_t blockSize = DefaultBlockSize);
+		~ObjectArena();
+
+		ObjectArena(const ObjectArena&) = delete;
+		ObjectArena(ObjectArena&&) noexcept = delete;
+		ObjectArena& operator=(const ObjectArena&) = delete;
+		ObjectArena& operator=(ObjectArena&&) noexcept = delete;
+
+		template<typename T, typename... Args>
+		T* Create(Args&&... args)
+		{
+			T* pObject{ new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...) };
+			if constexpr (!std::is_trivially_destructible_v<T>)
+				m_Destructors.push_back({ pObject, [](void* p) { static_cast<T*>(p)->~T(); } });
+			return pObject;
+		}
+
+		//Destroys every object in reverse creation order, the first block is kept for reuse
+		void Clear();
+
+		size_t GetMemory() const;
+
+	private:
+		static constexpr size_t DefaultBlockSize{ 16 * 1024 };
+		static constexpr size_t BlockAlignment{ 64 };
+
+		struct Destructor
+		{
+			void* pObject{};
+			void (*destroy)(void*) {};
+		};
+
+		void* Allocate(size_t size, size_t alignment);
+
+		std::vector<unsigned char*> m_Blocks{};
+		std::vector<size_t> m_BlockSizes{};
+		size_t m_BlockSize{};
+		//Offset into the last block
+		size_t m_Offset{};
+
+		std::vector<Destructor> m_Destructors{};
+	};
+}
@@ -0,0 +1,93 @@
+#include "ScratchArena.h"
+
+#include <atomic>
+#include <cassert>
+
+namespace dae {
+	namespace
+	{
+		std::atomic<uint64_t> g_Frame{};
+
+		unsigned char* AllocateBlock(size_t size)
+		{
+			return static_cast<unsigned char*>(::operator new(size, std::align_val_t{ 64 }));
+		}
+
+		void FreeBlock(unsigned char* pBlock)
+		{
+			::operator delete(pBlock, std::align_val_t{ 64 });
+		}
+	}
+
+	ScratchArena::ScratchArena(size_t capacity) :
+		m_pBlock(AllocateBlock(capacity)),
+		m_Capacity(capacity)
+	{
+	}
+
+	ScratchArena::~ScratchArena()
+	{
+		Reset();
+		FreeBlock(m_pBlock);
+		m_pBlock = nullptr;
+	}
+
+	void* ScratchArena::Allocate(size_t size, size_t alignment)
+	{
+		assert(alignment <= BlockAlignment && "Alignment larger than the arena blocks");
+
+		const size_t start{ (m_Offset + alignment - 1) & ~(alignment - 1) };
+		if (start + size <= m_Capacity)
+		{
+			m_Offset = start + size;
+			return m_pBlock + start;
+		}
+
+		m_OverflowBlocks.push_back(AllocateBlock(size));
+		m_OverflowBytes += size + alignment;
+		return m_OverflowBlocks.back();
+	}
+
+	void ScratchArena::Rewind(size_t marker)
+	{
+		assert(marker <= m_Offset && "Rewinding past the current allocation");
+		m_Offset = marker;
+	}
+
+	void ScratchArena::Reset()
+	{
+		m_Offset = 0;
+		if (m_OverflowBlocks.empty())
+			return;
+
+		for (unsigned char* pBlock : m_OverflowBlocks)
+		{
+			FreeBlock(pBlock);
+		}
+		m_OverflowBlocks.clear();
+
+		//Big enough for the frame that overflowed, assuming it held everything at once
+		FreeBlock(m_pBlock);
+		m_Capacity += m_OverflowBytes;
+		m_pBlock = AllocateBlock(m_Capacity);
+		m_OverflowBytes = 0;
+	}
+
+	ScratchArena& ScratchArena::GetThreadArena()
+	{
+		thread_local ScratchArena t_Arena{};
+
+		const uint64_t frame{ g_Frame.load(std::memory_order_relaxed) };
+		if (t_Arena.m_Frame != frame)
+		{
+			t_Arena.Reset();
+			t_Arena.m_Frame = frame;
+		}
+		return t_Arena;
+	}
+
+	void ScratchArena::EndFrame()
+	{
+		g_Frame.fetch_add(1, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace dae
+{
+	//Linear allocator for per-frame scratch memory, every thread has its own (see GetThreadArena).
+	//Memory is only given back all at once, on Rewind or when the arena is reset after EndFrame.
+	class ScratchArena final
+	{
+	public:
+		//Gives back everything allocated while the scope was alive
+		class Scope final
+		{
+		public:
+			explicit Scope(ScratchArena& arena) :
+				m_Arena(arena),
+				m_Marker(arena.GetMarker())
+			{
+			}
+			~Scope()
+			{
+				m_Arena.Rewind(m_Marker);
+			}
+
+			Scope(const Scope&) = delete;
+			Scope(Scope&&) noexcept = delete;
+			Scope& operator=(const Scope&) = delete;
+			Scope& operator=(Scope&&) noexcept = delete;
+
+		private:
+			ScratchArena& m_Arena;
+			size_t m_Marker{};
+		};
+
+		ScratchArena(size_t capacity = DefaultCapacity);
+		~ScratchArena();
+
+		ScratchArena(const ScratchArena&) = delete;
+		ScratchArena(ScratchArena&&) noexcept = delete;
+		ScratchArena& operator=(const ScratchArena&) = delete;
+		ScratchArena& operator=(ScratchArena&&) noexcept = delete;
+
+		/**
+		 * \brief Allocations that don't fit get a block of their own, which is freed on the next Reset.
+		 * That Reset grows the arena so the same frame fits without extra blocks.
+		 */
+		void* Allocate(size_t size, size_t alignment);
+
+		//Default constructs count elements. They are never destroyed, so T has to be trivially destructible
+		template<typename T>
+		T* Allocate(size_t count)
+		{
+			static_assert(std::is_trivially_destructible_v<T>, "Scratch memory is given back without calling destructors");
+			T* pElements{ static_cast<T*>(Allocate(count * sizeof(T), alignof(T))) };
+			for (size_t i{ 0 }; i < count; ++i)
+			{
+				new (pElements + i) T{};
+			}
+			return pElements;
+		}
+
+		size_t GetMarker() const { return m_Offset; }
+		void Rewind(size_t marker);
+		void Reset();
+
+		size_t GetCapacity() const { return m_Capacity; }
+
+		//Arena of the calling thread, reset first when a frame ended since its last use
+		static ScratchArena& GetThreadArena();
+		//Called once all work of a frame finished, no scratch memory of the frame may be used after this
+		static void EndFrame();
+
+	private:
+		static constexpr size_t DefaultCapacity{ 256 * 1024 };
+		static constexpr size_t BlockAlignment{ 64 };
+
+		unsigned char* m_pBlock{};
+		size_t m_Capacity{};
+		size_t m_Offset{};
+
+		std::vector<unsigned char*> m_OverflowBlocks{};
+		size_t m_OverflowBytes{};
+
+		//Value of the frame counter at the last reset
+		uint64_t m_Frame{};
+	};
+}
@@ -0,0 +1,161 @@
+#include "ShadowCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Scene.h"
+#include "Executor.h"
+#include "Profiler.h"
+#include "Utils.h"
+
+namespace dae {
+	ShadowCache::ShadowCache(float cellSize, uint32_t capacityLog2) :
+		m_CellSize(cellSize),
+		m_InverseCellSize(1.f / cellSize),
+		m_SlotMask((1u << capacityLog2) - 1),
+		m_Slots(size_t{ 1 } << capacityLog2)
+	{
+	}
+
+	uint64_t ShadowCache::GetKey(const Vector3& position, const Vector3& normal) const
+	{
+		const auto getCoordinate{ [this](float value) {
+			const int64_t coordinate{ static_cast<int64_t>(std::floor(value * m_InverseCellSize)) + CoordinateOffset };
+			return static_cast<uint64_t>(std::clamp<int64_t>(coordinate, 0, static_cast<int64_t>(CoordinateMask)));
+		} };
+
+		//Dominant axis of the normal and its sign, 0 to 5
+		const float absX{ std::abs(normal.x) };
+		const float absY{ std::abs(normal.y) };
+		const float absZ{ std::abs(normal.z) };
+		uint64_t side{};
+		if (absX >= absY && absX >= absZ)
+			side = normal.x < 0.f ? 1 : 0;
+		else if (absY >= absZ)
+			side = normal.y < 0.f ? 3 : 2;
+		else
+			side = normal.z < 0.f ? 5 : 4;
+
+		return OccupiedBit | (side << 60) | (getCoordinate(position.x) << 40) | (getCoordinate(position.y) << 20) | getCoordinate(position.z);
+	}
+
+	uint32_t ShadowCache::FindSlot(uint64_t key)
+	{
+		const uint32_t home{ GetHomeSlot(key) };
+		for (uint32_t probe{ 0 }; probe < MaxProbes; ++probe)
+		{
+			const uint32_t slotIndex{ (home + probe) & m_SlotMask };
+			Slot& slot{ m_Slots[slotIndex] };
+			uint64_t slotKey{ slot.key.load(std::memory_order_acquire) };
+			//Claim an empty slot, unless another thread claimed it first
+			if (slotKey == 0 && slot.key.compare_exchange_strong(slotKey, key, std::memory_order_acq_rel))
+			{
+				m_NumCells.fetch_add(1, std::memory_order_relaxed);
+				return slotIndex;
+			}
+			if (slotKey == key)
+				return slotIndex;
+		}
+		return InvalidSlot;
+	}
+
+	ShadowCache::Visibility ShadowCache::GetVisibility(uint32_t slot) const
+	{
+		if (slot == InvalidSlot)
+			return {};
+
+		const uint32_t visibility{ m_Slots[slot].visibility.load(std::memory_order_relaxed) };
+		return { static_cast<uint16_t>(visibility >> 16), static_cast<uint16_t>(visibility & 0xffff) };
+	}
+
+	void ShadowCache::Store(uint32_t slot, uint32_t lightIndex, bool isVisible)
+	{
+		if (slot == InvalidSlot || lightIndex >= MaxLights)
+			return;
+
+		m_Slots[slot].visibility.fetch_or((1u << (lightIndex + 16)) | (isVisible ? 1u << lightIndex : 0u), std::memory_order_relaxed);
+	}
+
+	void ShadowCache::Clear()
+	{
+		PROFILE_SCOPE("ShadowCache::Clear");
+		for (Slot& slot : m_Slots)
+		{
+			slot.key.store(0, std::memory_order_relaxed);
+			slot.visibility.store(0, std::memory_order_relaxed);
+		}
+		m_NumCells.store(0, std::memory_order_relaxed);
+	}
+
+	void ShadowCache::Invalidate(const std::vector<MovedBounds>& movedBounds, const std::vector<Light>& lights, Executor* pExecutor)
+	{
+		PROFILE_SCOPE("ShadowCache::Invalidate");
+		if (movedBounds.empty())
+			return;
+
+		const uint32_t numLights{ std::min(static_cast<uint32_t>(lights.size()), MaxLights) };
+		//Shadow rays start anywhere in a cell, within half its diagonal of the center. Grown by that much, the bounds catch every
+		//ray whose parallel through the center misses them
+		const float cellRadius{ m_CellSize * 0.87f };
+		const Vector3 margin{ cellRadius, cellRadius, cellRadius };
+
+		const auto invalidateSlots{ [&](uint32_t jobIndex) {
+			const size_t first{ static_cast<size_t>(jobIndex) * SlotsPerJob };
+			const size_t last{ std::min(first + SlotsPerJob, m_Slots.size()) };
+			for (size_t slotIndex{ first }; slotIndex < last; ++slotIndex)
+			{
+				Slot& slot{ m_Slots[slotIndex] };
+				const uint64_t key{ slot.key.load(std::memory_order_relaxed) };
+				if (key == 0)
+					continue;
+
+				const Vector3 center{ GetCellCenter(key) };
+				uint32_t forgetBits{ 0 };
+				for (uint32_t lightIndex{ 0 }; lightIndex < numLights; ++lightIndex)
+				{
+					const Vector3 direction{ LightUtils::GetDirectionToLight(lights[lightIndex], center) };
+					const float distance{ direction.Magnitude() };
+					const Vector3 normalizedDirection{ direction / distance };
+					for (const MovedBounds& bounds : movedBounds)
+					{
+						const Vector3 boxMin{ Vector3::Min(bounds.previousMin, bounds.min) - margin };
+						const Vector3 boxMax{ Vector3::Max(bounds.previousMax, bounds.max) + margin };
+						if (GeometryUtils::DoesSegmentHitBox(center, normalizedDirection, distance, boxMin, boxMax))
+						{
+							forgetBits |= (1u << (lightIndex + 16)) | (1u << lightIndex);
+							break;
+						}
+					}
+				}
+				if (forgetBits != 0)
+					slot.visibility.fetch_and(~forgetBits, std::memory_order_relaxed);
+			}
+		} };
+
+		const uint32_t numJobs{ static_cast<uint32_t>((m_Slots.size() + SlotsPerJob - 1) / SlotsPerJob) };
+		if (!pExecutor)
+		{
+			for (uint32_t jobIndex{ 0 }; jobIndex < numJobs; ++jobIndex)
+			{
+				invalidateSlots(jobIndex);
+			}
+			return;
+		}
+		pExecutor->ParallelFor(numJobs, [&invalidateSlots](uint32_t jobIndex) {
+			invalidateSlots(jobIndex);
+		});
+	}
+
+	uint32_t ShadowCache::GetHomeSlot(uint64_t key) const
+	{
+		return static_cast<uint32_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & m_SlotMask;
+	}
+
+	Vector3 ShadowCache::GetCellCenter(uint64_t key) const
+	{
+		const auto getCenter{ [this](uint64_t coordinate) {
+			return (static_cast<float>(static_cast<int64_t>(coordinate) - CoordinateOffset) + 0.5f) * m_CellSize;
+		} };
+		return { getCenter((key >> 40) & CoordinateMask), getCenter((key >> 20) & CoordinateMask), getCenter(key & CoordinateMask) };
+	}
+}
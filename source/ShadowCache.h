@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "Math.h"
+
+namespace dae
+{
+	struct Light;
+	struct MovedBounds;
+	class Executor;
+
+	/**
+	 * \brief Shadow ray results of static surfaces, so they are looked up instead of traced again in later frames.
+	 * A sparse hash grid over world space: every cell stores which lights are visible from it, learned from the first shadow
+	 * ray traced from the cell. Shadow edges snap to the cells, the cell size trades accuracy for hits.
+	 * FindSlot, GetVisibility and Store may run on any number of threads at once, Clear and Invalidate only while none of them runs.
+	 */
+	class ShadowCache final
+	{
+	public:
+		//Lights with a higher index are never cached
+		static constexpr uint32_t MaxLights{ 16 };
+		static constexpr uint32_t InvalidSlot{ UINT32_MAX };
+
+		struct Visibility
+		{
+			uint16_t known{};
+			uint16_t visible{};
+
+			bool IsKnown(uint32_t lightIndex) const { return lightIndex < MaxLights && (known & (1u << lightIndex)) != 0; }
+			bool IsVisible(uint32_t lightIndex) const { return (visible & (1u << lightIndex)) != 0; }
+		};
+
+		/**
+		 * \param cellSize Edge length of a grid cell in world units
+		 * \param capacityLog2 The grid holds up to 2^capacityLog2 cells, once full new cells are not cached
+		 */
+		ShadowCache(float cellSize, uint32_t capacityLog2 = 18);
+		~ShadowCache() = default;
+
+		ShadowCache(const ShadowCache&) = delete;
+		ShadowCache(ShadowCache&&) noexcept = delete;
+		ShadowCache& operator=(const ShadowCache&) = delete;
+		ShadowCache& operator=(ShadowCache&&) noexcept = delete;
+
+		//Cell of a surface point, the two sides of a thin surface fall in different cells
+		uint64_t GetKey(const Vector3& position, const Vector3& normal) const;
+		//Slot of the cell, claimed for it when it has none yet. InvalidSlot when the grid is full around the cell
+		uint32_t FindSlot(uint64_t key);
+		Visibility GetVisibility(uint32_t slot) const;
+		void Store(uint32_t slot, uint32_t lightIndex, bool isVisible);
+
+		void Clear();
+		//Forgets, per light, the cells whose shadow rays to that light can pass through where a moved mesh was or is now
+		void Invalidate(const std::vector<MovedBounds>& movedBounds, const std::vector<Light>& lights, Executor* pExecutor);
+
+		float GetCellSize() const { return m_CellSize; }
+		uint32_t GetNumCells() const { return m_NumCells.load(std::memory_order_relaxed); }
+		uint32_t GetCapacity() const { return static_cast<uint32_t>(m_Slots.size()); }
+
+	private:
+		//Slots probed after the one a key hashes to
+		static constexpr uint32_t MaxProbes{ 16 };
+		static constexpr uint32_t SlotsPerJob{ 16 * 1024 };
+		//Cell coordinates are stored in 20 bits per axis, offset to be positive
+		static constexpr int64_t CoordinateOffset{ 1 << 19 };
+		static constexpr uint64_t CoordinateMask{ (1ull << 20) - 1 };
+		//Set in every key, an empty slot holds 0
+		static constexpr uint64_t OccupiedBit{ 1ull << 63 };
+
+		//Key and visibility share a cache line, a lookup touches one line
+		struct Slot
+		{
+			//A slot keeps its key until Clear, so a slot found once stays the slot of its cell
+			std::atomic<uint64_t> key{};
+			//Known lights in the upper 16 bits, visible lights in the lower 16
+			std::atomic<uint32_t> visibility{};
+		};
+
+		uint32_t GetHomeSlot(uint64_t key) const;
+		Vector3 GetCellCenter(uint64_t key) const;
+
+		float m_CellSize{};
+		float m_InverseCellSize{};
+		uint32_t m_SlotMask{};
+
+		std::vector<Slot> m_Slots;
+		std::atomic<uint32_t> m_NumCells{};
+	};
+}
@@ -24,6 +24,9 @@ void Timer::Reset()
 	m_StopTime = 0;
 	m_FPSTimer = 0.0f;
 	m_FPSCount = 0;
+	m_FixedFrameCount = 1;
+	m_TotalTime = 0.0f;
+	m_ElapsedTime = 0.0f;
 	m_IsStopped = false;
 }
 
@@ -90,6 +93,14 @@ void Timer::Update()
 
 	m_TotalTime = (float)(((m_CurrentTime - m_PausedTime) - m_BaseTime) * m_SecondsPerCount);
 
+	//Deterministic time for benchmarks, the scene sees the same timeline every run
+	if (m_FixedTimestep > 0.0f)
+	{
+		m_ElapsedTime = m_FixedTimestep;
+		m_TotalTime = m_FixedFrameCount * m_FixedTimestep;
+		++m_FixedFrameCount;
+	}
+
 	//FPS LOGIC
 	m_FPSTimer += m_ElapsedTime;
 	++m_FPSCount;
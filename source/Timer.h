@@ -19,6 +19,12 @@ namespace dae
 
 		void StartBenchmark(int numFrames = 10);
 
+		/**
+		 * \brief Makes every Update advance the time by exactly 'timestep' seconds, independent of the wall clock
+		 * \param timestep Seconds per frame, 0 goes back to real time
+		 */
+		void SetFixedTimestep(float timestep) { m_FixedTimestep = timestep; }
+
 		void Reset();
 		void Start();
 		void Update();
@@ -47,6 +53,9 @@ namespace dae
 		float m_ElapsedUpperBound = 0.03f;
 		float m_FPSTimer = 0.0f;
 
+		float m_FixedTimestep = 0.0f;
+		uint32_t m_FixedFrameCount = 1;
+
 		bool m_IsStopped = true;
 		bool m_ForceElapsedUpperBound = false;
 
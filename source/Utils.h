@@ -4,7 +4,9 @@
 #include <iostream>
 #include "Math.h"
 #include "DataTypes.h"
+#include "RayStats.h"
 #include <string>  
+#include <unordered_map>
 
 
 namespace dae
@@ -15,6 +17,7 @@ namespace dae
 		//SPHERE HIT-TESTS
 		inline bool HitTest_Sphere(const Sphere& sphere, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
+			RAY_STAT(SphereTests);
 
 			//is faster
 			#pragma region Geometric way
@@ -31,6 +34,7 @@ namespace dae
 
 			float t{ dp - tca };
 			if (t > ray.min && t < ray.max) {
+				RAY_STAT(Hits);
 				if (ignoreHitRecord) return true;
 				Vector3 I{ ray.origin + t * ray.direction };
 				hitRecord.didHit = true;
@@ -92,9 +96,11 @@ namespace dae
 		//PLANE HIT-TESTS
 		inline bool HitTest_Plane(const Plane& plane, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
 		{
+			RAY_STAT(PlaneTests);
 			float t{ Vector3::Dot((plane.origin - ray.origin), plane.normal)/ Vector3::Dot(ray.direction, plane.normal) };
 
 			if (t > ray.min && t < ray.max) {
+				RAY_STAT(Hits);
 				if (ignoreHitRecord) return true;
 				Vector3 I{ ray.origin + t * ray.direction };
 				hitRecord.didHit = true;
@@ -340,19 +346,38 @@ namespace dae
 			return tMax > 0 && tMax >= tMin;
 		}
 
-		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		//Slab test of the segment origin + t * direction, t in [0, tMax]
+		inline bool DoesSegmentHitBox(const Vector3& origin, const Vector3& direction, float tMax, const Vector3& boxMin, const Vector3& boxMax)
+		{
+			float tNear{ 0.f };
+			float tFar{ tMax };
+			for (int axis{ 0 }; axis < 3; ++axis)
+			{
+				const float inverseDirection{ 1.f / direction[axis] };
+				const float t1{ (boxMin[axis] - origin[axis]) * inverseDirection };
+				const float t2{ (boxMax[axis] - origin[axis]) * inverseDirection };
+				tNear = std::max(tNear, std::min(t1, t2));
+				tFar = std::min(tFar, std::max(t1, t2));
+			}
+			return tNear <= tFar;
+		}
+
+		//Tests the triangles getTriangle(0) to getTriangle(numTriangles - 1) of the mesh, in that order
+		template<typename GetTriangle>
+		inline bool HitTest_MeshTriangles(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord, int numTriangles, GetTriangle getTriangle)
 		{
+			RAY_STAT(AABBTests);
 			if (!SlabTest_TriangleMesh(mesh, ray)) {
+				RAY_STAT(AABBEarlyOuts);
 				return false;
 			}
 
 			float distance{ FLT_MAX };
 			Triangle t;
 			HitRecord temp;
-			int size{ static_cast<int>(mesh.normals.size()) };
-			for (int i = 0; i < size; i++)
+			for (int i = 0; i < numTriangles; i++)
 			{
-				int i2{ i * 3 };
+				int i2{ static_cast<int>(getTriangle(i)) * 3 };
 				t.v0 = mesh.positions[mesh.indices[i2]];
 				t.v1 = mesh.positions[mesh.indices[i2 + 1]];
 				t.v2 = mesh.positions[mesh.indices[i2 + 2]];
@@ -362,27 +387,124 @@ namespace dae
 				t.cullMode = mesh.cullMode;
 
 				if (HitTest_Triangle(t, ray, temp, ignoreHitRecord)) {
-					if(ignoreHitRecord) return true;
+					RAY_STAT(Hits);
+					if (ignoreHitRecord) {
+						RAY_STAT_ADD(TriangleTests, i + 1);
+						return true;
+					}
 
-					if (hitRecord.didHit && temp.t < distance) {
+					if (temp.t < distance) {
 						distance = temp.t;
 						hitRecord = temp;
 					}
 				}
 			}
+			//Counted once per mesh instead of per triangle, to keep the counters out of the inner loop
+			RAY_STAT_ADD(TriangleTests, numTriangles);
 			
 			return hitRecord.didHit;
 		}
 
+		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		{
+			return HitTest_MeshTriangles(mesh, ray, hitRecord, ignoreHitRecord, static_cast<int>(mesh.normals.size()), [](int i) { return i; });
+		}
+
+		//Only the listed triangles, so the result matches the whole mesh as long as the ray can't hit any of the others
+		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const uint32_t* pTriangles, uint32_t numTriangles, const Ray& ray, HitRecord& hitRecord, bool ignoreHitRecord = false)
+		{
+			return HitTest_MeshTriangles(mesh, ray, hitRecord, ignoreHitRecord, static_cast<int>(numTriangles), [pTriangles](int i) { return pTriangles[i]; });
+		}
+
 		inline bool HitTest_TriangleMesh(const TriangleMesh& mesh, const Ray& ray)
 		{
 			HitRecord temp{};
 			return HitTest_TriangleMesh(mesh, ray, temp, true);
 		}
 		#pragma endregion
+
+		#pragma region Frustum Culling
+		//Conservative tests, they only answer false when the geometry is entirely outside the frustum
+		inline bool DoesSphereOverlapFrustum(const Frustum& frustum, const Vector3& center, float radius)
+		{
+			for (int i{ 0 }; i < frustum.numPlanes; ++i)
+			{
+				if (Vector3::Dot(frustum.normals[i], center) - frustum.distances[i] < -radius)
+					return false;
+			}
+			return true;
+		}
+
+		inline bool DoesBoxOverlapFrustum(const Frustum& frustum, const Vector3& boxMin, const Vector3& boxMax)
+		{
+			for (int i{ 0 }; i < frustum.numPlanes; ++i)
+			{
+				//Corner furthest along the normal
+				const Vector3& normal{ frustum.normals[i] };
+				const Vector3 corner{ normal.x >= 0.f ? boxMax.x : boxMin.x, normal.y >= 0.f ? boxMax.y : boxMin.y, normal.z >= 0.f ? boxMax.z : boxMin.z };
+				if (Vector3::Dot(normal, corner) < frustum.distances[i])
+					return false;
+			}
+			return true;
+		}
+
+		inline bool IsBoxInsideFrustum(const Frustum& frustum, const Vector3& boxMin, const Vector3& boxMax)
+		{
+			for (int i{ 0 }; i < frustum.numPlanes; ++i)
+			{
+				//Corner furthest against the normal
+				const Vector3& normal{ frustum.normals[i] };
+				const Vector3 corner{ normal.x >= 0.f ? boxMin.x : boxMax.x, normal.y >= 0.f ? boxMin.y : boxMax.y, normal.z >= 0.f ? boxMin.z : boxMax.z };
+				if (Vector3::Dot(normal, corner) < frustum.distances[i])
+					return false;
+			}
+			return true;
+		}
+
+		inline bool DoesTriangleOverlapFrustum(const Frustum& frustum, const Vector3& v0, const Vector3& v1, const Vector3& v2)
+		{
+			for (int i{ 0 }; i < frustum.numPlanes; ++i)
+			{
+				const Vector3& normal{ frustum.normals[i] };
+				const float distance{ frustum.distances[i] };
+				if (Vector3::Dot(normal, v0) < distance && Vector3::Dot(normal, v1) < distance && Vector3::Dot(normal, v2) < distance)
+					return false;
+			}
+			return true;
+		}
+		#pragma endregion
 	
 	}
 
+	namespace TileUtils
+	{
+		struct TileRect
+		{
+			int x{};
+			int y{};
+			int width{};
+			int height{};
+		};
+
+		inline uint32_t GetNumTiles(int width, int height, int tileSize)
+		{
+			return static_cast<uint32_t>(((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize));
+		}
+
+		//Screen rectangle of a tile, tiles are numbered row by row
+		inline TileRect GetTileRect(uint32_t tileIndex, int width, int height, int tileSize)
+		{
+			const int numTilesX{ (width + tileSize - 1) / tileSize };
+
+			TileRect rect{};
+			rect.x = static_cast<int>(tileIndex) % numTilesX * tileSize;
+			rect.y = static_cast<int>(tileIndex) / numTilesX * tileSize;
+			rect.width = std::min(tileSize, width - rect.x);
+			rect.height = std::min(tileSize, height - rect.y);
+			return rect;
+		}
+	}
+
 	namespace LightUtils
 	{
 		//Direction from target to light
@@ -473,5 +595,130 @@ namespace dae
 			return true;
 		}
 #pragma warning(pop)
+
+		//One face normal per triangle, like ParseOBJ
+		inline void CalculateFaceNormals(const std::vector<Vector3>& positions, const std::vector<int>& indices, std::vector<Vector3>& normals)
+		{
+			normals.resize(indices.size() / 3);
+			for (size_t i{ 0 }; i < normals.size(); ++i)
+			{
+				const Vector3& v0{ positions[indices[i * 3]] };
+				const Vector3& v1{ positions[indices[i * 3 + 1]] };
+				const Vector3& v2{ positions[indices[i * 3 + 2]] };
+				normals[i] = Vector3::Cross(v1 - v0, v2 - v0).Normalized();
+			}
+		}
+
+		/**
+		 * \brief Unit sphere made by subdividing an icosahedron, every subdivision has 4 times the triangles (20 * 4^subdivisions)
+		 */
+		inline void GenerateIcosphere(int subdivisions, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
+		{
+			const float t{ (1.f + sqrtf(5.f)) / 2.f };
+			positions = {
+				{ -1.f, t, 0.f }, { 1.f, t, 0.f }, { -1.f, -t, 0.f }, { 1.f, -t, 0.f },
+				{ 0.f, -1.f, t }, { 0.f, 1.f, t }, { 0.f, -1.f, -t }, { 0.f, 1.f, -t },
+				{ t, 0.f, -1.f }, { t, 0.f, 1.f }, { -t, 0.f, -1.f }, { -t, 0.f, 1.f }
+			};
+			for (Vector3& position : positions)
+			{
+				position.Normalize();
+			}
+
+			//Counter-clockwise seen from outside, so the face normals point out
+			indices = {
+				0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11,
+				1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+				3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9,
+				4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1
+			};
+
+			std::vector<int> subdivided{};
+			for (int level{ 0 }; level < subdivisions; ++level)
+			{
+				//Edges are shared by two triangles, both have to use the same midpoint
+				std::unordered_map<uint64_t, int> midpoints{};
+				midpoints.reserve(indices.size());
+				const auto getMidpoint{ [&](int a, int b) {
+					const uint64_t key{ (static_cast<uint64_t>(std::min(a, b)) << 32) | static_cast<uint32_t>(std::max(a, b)) };
+					const auto it{ midpoints.find(key) };
+					if (it != midpoints.end())
+						return it->second;
+
+					positions.push_back(((positions[a] + positions[b]) * 0.5f).Normalized());
+					const int index{ static_cast<int>(positions.size()) - 1 };
+					midpoints.emplace(key, index);
+					return index;
+				} };
+
+				subdivided.clear();
+				subdivided.reserve(indices.size() * 4);
+				for (size_t i{ 0 }; i < indices.size(); i += 3)
+				{
+					const int v0{ indices[i] };
+					const int v1{ indices[i + 1] };
+					const int v2{ indices[i + 2] };
+					const int a{ getMidpoint(v0, v1) };
+					const int b{ getMidpoint(v1, v2) };
+					const int c{ getMidpoint(v2, v0) };
+
+					subdivided.insert(subdivided.end(), { v0, a, c, v1, b, a, v2, c, b, a, b, c });
+				}
+				indices.swap(subdivided);
+			}
+
+			CalculateFaceNormals(positions, indices, normals);
+		}
+
+		/**
+		 * \brief Height field on the XZ plane, centered around the origin, with 2 * resolution^2 triangles facing up
+		 * \param seed Seed of the random wave phases and directions
+		 */
+		inline void GenerateTerrain(int resolution, float size, float height, uint32_t seed, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
+		{
+			//Sum of a few sine waves with random direction and phase
+			constexpr int NumWaves{ 4 };
+			Vector3 waveDirections[NumWaves]{};
+			float wavePhases[NumWaves]{};
+			for (int i{ 0 }; i < NumWaves; ++i)
+			{
+				const float angle{ RandomFloat(seed) * PI_2 };
+				waveDirections[i] = Vector3{ cosf(angle), 0.f, sinf(angle) } * static_cast<float>(1 << i) * (PI_2 / size);
+				wavePhases[i] = RandomFloat(seed) * PI_2;
+			}
+
+			const int numVertices{ resolution + 1 };
+			positions.resize(static_cast<size_t>(numVertices) * numVertices);
+			for (int z{ 0 }; z < numVertices; ++z)
+			{
+				for (int x{ 0 }; x < numVertices; ++x)
+				{
+					Vector3 position{ (static_cast<float>(x) / resolution - 0.5f) * size, 0.f, (static_cast<float>(z) / resolution - 0.5f) * size };
+					for (int i{ 0 }; i < NumWaves; ++i)
+					{
+						position.y += sinf(Vector3::Dot(waveDirections[i], position) + wavePhases[i]) * height / static_cast<float>(1 << i);
+					}
+					positions[x + z * numVertices] = position;
+				}
+			}
+
+			indices.resize(static_cast<size_t>(resolution) * resolution * 6);
+			int* pIndex{ indices.data() };
+			for (int z{ 0 }; z < resolution; ++z)
+			{
+				for (int x{ 0 }; x < resolution; ++x)
+				{
+					const int v00{ x + z * numVertices };
+					const int v10{ v00 + 1 };
+					const int v01{ v00 + numVertices };
+					const int v11{ v01 + 1 };
+
+					*pIndex++ = v00; *pIndex++ = v01; *pIndex++ = v10;
+					*pIndex++ = v10; *pIndex++ = v01; *pIndex++ = v11;
+				}
+			}
+
+			CalculateFaceNormals(positions, indices, normals);
+		}
 	}
 }
\ No newline at end of file
@@ -5,12 +5,25 @@
 #undef main
 
 //Standard includes
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
 //Project includes
 #include "Timer.h"
 #include "Renderer.h"
 #include "Scene.h"
+#include "Benchmark.h"
+#include "FramePipeline.h"
+#include "ResolutionController.h"
+#include "ImageWriter.h"
+#include "Checkpoint.h"
+#include "Profiler.h"
+#include "AllocationTracker.h"
 
 using namespace dae;
 
@@ -20,11 +33,263 @@ void ShutDown(SDL_Window* pWindow)
 	SDL_Quit();
 }
 
+bool ParseExecutionBackend(const std::string& name, ExecutionBackend& backend)
+{
+	if (name == "pool") backend = ExecutionBackend::ThreadPool;
+	else if (name == "std") backend = ExecutionBackend::StdExecution;
+	else if (name == "omp") backend = ExecutionBackend::OpenMP;
+	else if (name == "serial") backend = ExecutionBackend::Serial;
+	else return false;
+
+	return true;
+}
+
+bool ParseSweepParameter(const std::string& name, SweepParameter& parameter)
+{
+	for (SweepParameter candidate : { SweepParameter::Spheres, SweepParameter::Lights, SweepParameter::MeshInstances, SweepParameter::TerrainResolution })
+	{
+		if (name == ScalingSweep::GetParameterName(candidate))
+		{
+			parameter = candidate;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+//Whole numbers from min to max, throws std::invalid_argument or std::out_of_range like std::stoul for anything else
+uint32_t ParseUnsigned(const std::string& text, uint32_t min = 0, uint32_t max = UINT32_MAX)
+{
+	size_t numParsed{};
+	const long long value{ std::stoll(text, &numParsed) };
+	if (numParsed != text.size())
+		throw std::invalid_argument{ text };
+	if (value < min || value > max)
+		throw std::out_of_range{ text };
+
+	return static_cast<uint32_t>(value);
+}
+
+//Finite numbers from min up, throws like ParseUnsigned
+float ParseFloat(const std::string& text, float min = 0.f)
+{
+	size_t numParsed{};
+	const float value{ std::stof(text, &numParsed) };
+	if (numParsed != text.size())
+		throw std::invalid_argument{ text };
+	if (!std::isfinite(value) || value < min)
+		throw std::out_of_range{ text };
+
+	return value;
+}
+
+void PrintUsage()
+{
+	std::cout << "Usage: RayTracer [options]\n"
+		<< "  --help                         Prints this list\n"
+		<< "  --scene <name>                 W1, W2, W3, W3_Test, W4_Test, W4_Reference, W4_Bunny or Stress\n"
+		<< "  --backend <pool|std|omp|serial> --threads <n>\n"
+		<< "  --benchmark | --sweep <spheres|lights|instances|terrain> | --scaling [--no-pin]\n"
+		<< "  --frames <n> --output <path> --sweep-start <n> --sweep-steps <n> --seed <n>\n"
+		<< "  --stats <path> --trace <path> --screenshot <path> [--exr-float]\n"
+		<< "  --stream <path|-> --stream-format <y4m|rgb> --stream-fps <n>\n"
+		<< "  --pipeline <depth> --frame-budget <ms> --full-redraw --no-tile-culling --shadow-cache <cell size>\n"
+		<< "  --checkpoint <path> --checkpoint-interval <s> --assert-no-alloc" << std::endl;
+}
+
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	//Command line
+	ExecutionBackend executionBackend{ ExecutionBackend::ThreadPool };
+	uint32_t numThreads{ 0 };
+	std::string sceneName{ "W4_Reference" };
+	bool runBenchmark{ false };
+	BenchmarkSettings benchmarkSettings{};
+	std::string statsPath{};
+	std::string tracePath{};
+	//Written with X, .exr saves the linear colors instead of a PNG
+	std::string screenshotPath{ "RayTracing_Buffer.png" };
+	bool isScreenshotFloat{ false };
+	//Every presented frame is written here ("-" for stdout), for encoding animations with an external tool
+	std::string streamPath{};
+	StreamFormat streamFormat{ StreamFormat::Y4M };
+	int streamFramesPerSecond{ 30 };
+	bool runSweep{ false };
+	SweepSettings sweepSettings{};
+	bool runThreadScaling{ false };
+	ThreadScalingSettings scalingSettings{};
+	//Frame count and output file of the benchmark modes, 0 and empty keep the defaults of each mode
+	int numFrames{ 0 };
+	std::string outputPath{};
+	//Frames in flight of the interactive loop, 1 updates, renders and presents in sequence
+	uint32_t pipelineDepth{ 1 };
+	//Target frame time of the interactive loop (ms), traces fewer pixels to hold it. 0 always traces every pixel
+	float frameBudget{ 0.f };
+	bool partialRedraw{ true };
+	bool tileCulling{ true };
+	//Cell size of the shadow cache in world units, 0 traces every shadow ray
+	float shadowCacheCellSize{ 0.f };
+	//Progressive render resumed from and saved to this file every interval (s), so a stopped job continues where it was
+	std::string checkpointPath{};
+	float checkpointInterval{ 60.f };
+	//Values are parsed right after their option, so a throw means args[i] is the value of args[i - 1]
+	int i{ 1 };
+	try
+	{
+		for (; i < argc; ++i)
+		{
+			const std::string arg{ args[i] };
+			if (arg == "--help")
+			{
+				PrintUsage();
+				return 0;
+			}
+			else if (arg == "--backend" && i + 1 < argc)
+			{
+				if (!ParseExecutionBackend(args[++i], executionBackend))
+					std::cout << "Unknown backend " << args[i] << " (pool, std, omp, serial)" << std::endl;
+			}
+			else if (arg == "--threads" && i + 1 < argc)
+			{
+				numThreads = ParseUnsigned(args[++i]);
+			}
+			else if (arg == "--scene" && i + 1 < argc)
+			{
+				sceneName = args[++i];
+			}
+			else if (arg == "--benchmark")
+			{
+				runBenchmark = true;
+			}
+			else if (arg == "--frames" && i + 1 < argc)
+			{
+				numFrames = static_cast<int>(ParseUnsigned(args[++i], 0, INT32_MAX));
+			}
+			else if (arg == "--output" && i + 1 < argc)
+			{
+				outputPath = args[++i];
+			}
+			else if (arg == "--sweep" && i + 1 < argc)
+			{
+				runSweep = ParseSweepParameter(args[++i], sweepSettings.parameter);
+				if (!runSweep)
+					std::cout << "Unknown sweep parameter " << args[i] << " (spheres, lights, instances, terrain)" << std::endl;
+			}
+			else if (arg == "--sweep-start" && i + 1 < argc)
+			{
+				sweepSettings.start = ParseUnsigned(args[++i]);
+			}
+			else if (arg == "--sweep-steps" && i + 1 < argc)
+			{
+				sweepSettings.numSteps = static_cast<int>(ParseUnsigned(args[++i], 0, INT32_MAX));
+			}
+			else if (arg == "--scaling")
+			{
+				runThreadScaling = true;
+			}
+			else if (arg == "--no-pin")
+			{
+				scalingSettings.pinThreads = false;
+			}
+			else if (arg == "--seed" && i + 1 < argc)
+			{
+				sweepSettings.scene.seed = ParseUnsigned(args[++i]);
+			}
+			else if (arg == "--stats" && i + 1 < argc)
+			{
+				statsPath = args[++i];
+			}
+			else if (arg == "--trace" && i + 1 < argc)
+			{
+				tracePath = args[++i];
+			}
+			else if (arg == "--screenshot" && i + 1 < argc)
+			{
+				screenshotPath = args[++i];
+			}
+			else if (arg == "--exr-float")
+			{
+				//32 bit float channels in EXR screenshots instead of half
+				isScreenshotFloat = true;
+			}
+			else if (arg == "--stream" && i + 1 < argc)
+			{
+				streamPath = args[++i];
+			}
+			else if (arg == "--stream-format" && i + 1 < argc)
+			{
+				//y4m or rgb
+				streamFormat = std::string{ args[++i] } == "rgb" ? StreamFormat::RawRGB : StreamFormat::Y4M;
+			}
+			else if (arg == "--stream-fps" && i + 1 < argc)
+			{
+				streamFramesPerSecond = static_cast<int>(ParseUnsigned(args[++i], 1, INT32_MAX));
+			}
+			else if (arg == "--pipeline" && i + 1 < argc)
+			{
+				pipelineDepth = ParseUnsigned(args[++i]);
+			}
+			else if (arg == "--frame-budget" && i + 1 < argc)
+			{
+				frameBudget = ParseFloat(args[++i]);
+			}
+			else if (arg == "--full-redraw")
+			{
+				//Trace every tile when meshes move, instead of only the tiles they touched
+				partialRedraw = false;
+			}
+			else if (arg == "--no-tile-culling")
+			{
+				//Test every ray against the whole scene, instead of the geometry culled for its tile
+				tileCulling = false;
+			}
+			else if (arg == "--shadow-cache" && i + 1 < argc)
+			{
+				shadowCacheCellSize = ParseFloat(args[++i]);
+			}
+			else if (arg == "--checkpoint" && i + 1 < argc)
+			{
+				checkpointPath = args[++i];
+			}
+			else if (arg == "--checkpoint-interval" && i + 1 < argc)
+			{
+				checkpointInterval = ParseFloat(args[++i]);
+			}
+			else if (arg == "--assert-no-alloc")
+			{
+				//Render and Update must not allocate after their warmup runs
+				AllocationTracker::SetAssertEnabled(true);
+				if (!ALLOCATION_TRACKING_ENABLED)
+					std::cout << "Allocation tracking is compiled out, --assert-no-alloc has no effect" << std::endl;
+			}
+		}
+	}
+	catch (const std::logic_error&)
+	{
+		std::cout << "Invalid value " << args[i] << " for " << args[i - 1] << std::endl;
+		PrintUsage();
+		return 1;
+	}
+
+	if (numFrames > 0)
+	{
+		benchmarkSettings.numFrames = numFrames;
+		sweepSettings.benchmark.numFrames = numFrames;
+		scalingSettings.benchmark.numFrames = numFrames;
+	}
+	if (!outputPath.empty())
+	{
+		benchmarkSettings.outputPath = outputPath;
+		sweepSettings.outputPath = outputPath;
+		scalingSettings.outputPath = outputPath;
+	}
+
+	//Frames go to stdout, the console output moves to stderr so it doesn't end up in the stream
+	if (streamPath == "-")
+		std::cout.rdbuf(std::cerr.rdbuf());
+
+	Profiler::SetThreadName("Main");
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
@@ -44,23 +309,137 @@ int main(int argc, char* args[])
 	//Initialize "framework"
 	const auto pTimer = new Timer();
 	const auto pRenderer = new Renderer(pWindow);
+	pRenderer->SetExecutionBackend(executionBackend, numThreads);
+	pRenderer->SetPartialRedrawEnabled(partialRedraw);
+	pRenderer->SetTileCullingEnabled(tileCulling);
+	pRenderer->SetShadowCacheCellSize(shadowCacheCellSize);
+	if (!streamPath.empty() && !pRenderer->OpenFrameStream(streamPath, streamFormat, streamFramesPerSecond))
+		std::cout << "Could not open " << streamPath << " for streaming" << std::endl;
+	std::cout << "Backend: " << pRenderer->GetExecutor()->GetName() << " (" << pRenderer->GetExecutor()->GetNumThreads() << " threads)" << std::endl;
+
+	//Thread scaling: the benchmark on 1, 2, 4 ... --threads workers, results written as JSON
+	if (runThreadScaling)
+	{
+		scalingSettings.sceneName = sceneName;
+		scalingSettings.maxThreads = numThreads;
+
+		ThreadScalingBenchmark scaling{ scalingSettings };
+		if (!scaling.Run(pRenderer, pTimer))
+			std::cout << "Unknown scene " << sceneName << std::endl;
+		scaling.PrintSummary();
+		if (!scaling.WriteJson())
+			std::cout << "Could not write " << scalingSettings.outputPath << std::endl;
+
+		delete pRenderer;
+		delete pTimer;
+
+		ShutDown(pWindow);
+		return 0;
+	}
 
-	//const auto pScene = new Scene_W1();
-	//const auto pScene = new Scene_W2();
-	//const auto pScene = new Scene_W3();
-	//const auto pScene = new Scene_W3_Test();
-	//const auto pScene = new Scene_W4_Test();
-	const auto pScene = new Scene_W4_ReferenceScene();
-	//const auto pScene = new Scene_W4_Bunny();
+	//Scaling sweep over the stress scene, results written as JSON
+	if (runSweep)
+	{
+		ScalingSweep sweep{ sweepSettings };
+		sweep.Run(pRenderer, pTimer);
+		sweep.PrintSummary();
+		if (!sweep.WriteJson(pRenderer))
+			std::cout << "Could not write " << sweepSettings.outputPath << std::endl;
+
+		delete pRenderer;
+		delete pTimer;
+
+		ShutDown(pWindow);
+		return 0;
+	}
+
+	Scene* const pScene{ sceneName == "Stress" ? new Scene_Stress(sweepSettings.scene) : CreateScene(sceneName) };
+	if (!pScene)
+	{
+		std::cout << "Unknown scene " << sceneName << " (W1, W2, W3, W3_Test, W4_Test, W4_Reference, W4_Bunny)" << std::endl;
+		delete pRenderer;
+		delete pTimer;
+		ShutDown(pWindow);
+		return 1;
+	}
+	pScene->SetExecutor(pRenderer->GetExecutor());
 	pScene->Initialize();
 
+	//Benchmark mode: fixed frame count along a scripted camera path, results written as JSON
+	if (runBenchmark)
+	{
+		benchmarkSettings.sceneName = sceneName;
+		Benchmark benchmark{ benchmarkSettings, CameraPath::CreateDefault(pScene->GetCamera()) };
+		benchmark.Run(pScene, pRenderer, pTimer);
+		benchmark.PrintSummary();
+		if (!benchmark.WriteJson(pRenderer))
+			std::cout << "Could not write " << benchmarkSettings.outputPath << std::endl;
+		if (!tracePath.empty() && !Profiler::WriteChromeTrace(tracePath))
+			std::cout << "Could not write " << tracePath << std::endl;
+
+		delete pScene;
+		delete pRenderer;
+		delete pTimer;
+
+		ShutDown(pWindow);
+		return 0;
+	}
+
+	//Ray counters of the last frame, written as one JSON line every second
+	std::ofstream statsFile{};
+	if (!statsPath.empty())
+		statsFile.open(statsPath);
+
+	//Past a depth of 1 the scene updates while the executor renders, so large meshes are transformed on the main thread
+	const auto pPipeline = new FramePipeline(pRenderer, pipelineDepth);
+	const bool isPipelined{ pPipeline->GetDepth() > 1 };
+	pScene->SetExecutor(isPipelined ? nullptr : pRenderer->GetExecutor());
+	if (isPipelined)
+		std::cout << "Frame pipeline: " << pPipeline->GetDepth() << " frames in flight" << std::endl;
+
+	const auto pResolutionController = frameBudget > 0.f ? new ResolutionController(frameBudget) : nullptr;
+	const auto pImageWriter = new ImageWriter();
+	ImageFormat screenshotFormat{ ImageWriter::GetFormat(screenshotPath) };
+	if (screenshotFormat == ImageFormat::ExrHalf && isScreenshotFloat)
+		screenshotFormat = ImageFormat::ExrFloat;
+
+	//Checkpoints only make sense for a progressive render, so accumulation is on from the first frame
+	uint64_t frameIndex{ 0 };
+	const auto pCheckpointWriter = checkpointPath.empty() ? nullptr : new CheckpointWriter(checkpointPath);
+	RenderCheckpoint checkpoint{};
+	if (pCheckpointWriter)
+	{
+		pRenderer->SetAccumulationEnabled(true);
+		if (!CheckpointWriter::Read(checkpointPath, checkpoint))
+			std::cout << "No valid checkpoint in " << checkpointPath << ", starting from the first sample" << std::endl;
+		else if (checkpoint.sceneName != sceneName || !pRenderer->RestoreCheckpoint(*pScene, checkpoint))
+			std::cout << "Checkpoint " << checkpointPath << " doesn't match the scene or resolution, starting from the first sample" << std::endl;
+		else
+		{
+			frameIndex = checkpoint.frameIndex;
+			std::cout << "Resumed at frame " << frameIndex << " with " << pRenderer->GetAccumulatedSamples() << " samples per pixel" << std::endl;
+		}
+	}
+	const auto saveCheckpoint{ [&] {
+		pRenderer->GetCheckpoint(*pScene, checkpoint);
+		checkpoint.sceneName = sceneName;
+		checkpoint.frameIndex = frameIndex;
+		pCheckpointWriter->Write(checkpoint);
+	} };
+
 	//Start loop
 	pTimer->Start();
+	float checkpointTimer = 0.f;
 	float printTimer = 0.f;
 	bool isLooping = true;
 	bool takeScreenshot = false;
+	bool writeTrace = false;
+	bool printRayStats = false;
 	while (isLooping)
 	{
+		PROFILE_SCOPE("Frame");
+		const auto frameStart{ std::chrono::steady_clock::now() };
+
 		//--------- Get input events ---------
 		SDL_Event e;
 		while (SDL_PollEvent(&e))
@@ -71,45 +450,167 @@ int main(int argc, char* args[])
 				isLooping = false;
 				break;
 			case SDL_KEYUP:
+				//Keys change renderer settings, which the frames in flight must not see halfway
+				pPipeline->Flush();
 				if (e.key.keysym.scancode == SDL_SCANCODE_X)
 					takeScreenshot = true;
 				if (e.key.keysym.scancode == SDL_SCANCODE_F2)
 					pRenderer->ToggleShadows();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F3)
 					pRenderer->CycleLightingMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F4)
+					pRenderer->ToggleRayReordering();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F5)
+				{
+					pRenderer->ToggleDenoiser();
+					std::cout << "Denoiser " << (pRenderer->IsDenoiserEnabled() ? "ON" : "OFF") << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+				{
+					pRenderer->ToggleAccumulation();
+					std::cout << "Progressive accumulation " << (pRenderer->IsAccumulationEnabled() ? "ON" : "OFF") << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F11)
+				{
+					pRenderer->ToggleTemporalReuse();
+					std::cout << "Temporal reuse " << (pRenderer->IsTemporalReuseEnabled() ? "ON" : "OFF") << std::endl;
+				}
 				if (e.key.keysym.scancode == SDL_SCANCODE_F6)
 					pTimer->StartBenchmark();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F7)
+					writeTrace = true;
+				if (e.key.keysym.scancode == SDL_SCANCODE_F10)
+				{
+					printRayStats = !printRayStats;
+					std::cout << "Ray stats " << (printRayStats ? "ON" : "OFF") << (RAY_STATS_ENABLED ? "" : " (compiled out)") << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+				{
+					pRenderer->CycleExecutionBackend();
+					pScene->SetExecutor(isPipelined ? nullptr : pRenderer->GetExecutor());
+					std::cout << "Backend: " << pRenderer->GetExecutor()->GetName() << " (" << pRenderer->GetExecutor()->GetNumThreads() << " threads)" << std::endl;
+				}
 				break;
 
 			}
 		}
 
 		//--------- Update ---------
-		pScene->Update(pTimer);
+		{
+			PROFILE_SCOPE("Scene::Update");
+			ALLOCATION_CHECK_SCOPE("Scene::Update");
+			pScene->Update(pTimer);
+		}
 
 		//--------- Render ---------
-		pRenderer->Render(pScene);
+		pPipeline->Submit(*pScene, frameStart);
+		++frameIndex;
+
+		//--------- Resolution ---------
+		if (pResolutionController)
+		{
+			const float frameTime{ std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count() };
+			if (pResolutionController->Update(frameTime))
+				pRenderer->SetPixelSubset(pResolutionController->GetSubset());
+		}
 
 		//--------- Timer ---------
 		pTimer->Update();
 		printTimer += pTimer->GetElapsed();
 		if (printTimer >= 1.f)
 		{
+			//The stats below belong to the last presented frame
+			pPipeline->Flush();
 			printTimer = 0.f;
+			const FrameLatency latency{ pPipeline->ConsumeLatency() };
 			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			std::cout << "Latency: " << latency.average << " ms (max " << latency.max << " ms)" << std::endl;
+			std::cout << "Shadow rays: " << pRenderer->GetShadowTraceTime() << " ms"
+				<< (pRenderer->IsRayReorderingEnabled() ? " (reordered)" : " (pixel order)") << std::endl;
+			if (pResolutionController)
+				std::cout << "Pixels: " << ResolutionController::GetSubsetName(pResolutionController->GetSubset()) << " (" << pResolutionController->GetAverageFrameTime()
+					<< " ms, budget " << pResolutionController->GetBudget() << " ms)" << std::endl;
+			if (const ShadowCache* pShadowCache{ pRenderer->GetShadowCache() })
+			{
+				const FrameStats& frameStats{ pRenderer->GetFrameStats() };
+				const uint64_t numShadowRays{ frameStats.numRays + frameStats.numCachedShadowRays };
+				std::cout << "Shadow cache: " << pShadowCache->GetNumCells() << " / " << pShadowCache->GetCapacity() << " cells, "
+					<< frameStats.numCachedShadowRays * 100 / std::max<uint64_t>(numShadowRays, 1) << "% of rays cached" << std::endl;
+			}
+			if (pCheckpointWriter)
+				std::cout << "Checkpoints: " << pCheckpointWriter->GetNumSaved() << " saved to " << pCheckpointWriter->GetPath()
+					<< (pCheckpointWriter->GetNumFailed() > 0 ? ", " + std::to_string(pCheckpointWriter->GetNumFailed()) + " failed" : "") << std::endl;
+			if (const FrameStream* pStream{ pRenderer->GetFrameStream() })
+				std::cout << "Stream: " << pStream->GetNumWrittenFrames() << " frames" << (pStream->HasFailed() ? ", output closed" : "") << std::endl;
+			if (pRenderer->IsCostHeatmapEnabled())
+				std::cout << "Cost heatmap: 0 - " << pRenderer->GetHeatmapMaxCost() << " " << RayStats::GetCostUnit() << " per pixel sample" << std::endl;
+			if (printRayStats)
+				RayStats::Print(pRenderer->GetRayStats());
+			AllocationTracker::PrintSites();
+			if (statsFile)
+				statsFile << "{\"time\": " << pTimer->GetTotal() << ", \"rayStats\": " << RayStats::ToJson(pRenderer->GetRayStats()) << "}" << std::endl;
 		}
 
-		//Save screenshot after full render
+		//Save screenshot after full render, the image writer encodes it while the next frames render
 		if (takeScreenshot)
 		{
-			if (!pRenderer->SaveBufferToImage())
-				std::cout << "Screenshot saved!" << std::endl;
-			else
-				std::cout << "Something went wrong. Screenshot not saved!" << std::endl;
+			pPipeline->Flush();
+			std::vector<ColorRGB> image{};
+			pRenderer->GetImage(image);
+			pImageWriter->Write(screenshotPath, screenshotFormat, pRenderer->GetWidth(), pRenderer->GetHeight(), std::move(image));
 			takeScreenshot = false;
 		}
+
+		//Taken between frames and written while the next ones render. Skipped while the last one is still being written
+		checkpointTimer += pTimer->GetElapsed();
+		if (pCheckpointWriter && checkpointTimer >= checkpointInterval && pCheckpointWriter->IsIdle())
+		{
+			pPipeline->Flush();
+			saveCheckpoint();
+			checkpointTimer = 0.f;
+		}
+
+		ImageWriteResult writeResult{};
+		while (pImageWriter->PopResult(writeResult))
+		{
+			if (writeResult.isSaved)
+				std::cout << "Screenshot saved to " << writeResult.path << std::endl;
+			else
+				std::cout << "Something went wrong. Screenshot " << writeResult.path << " not saved!" << std::endl;
+		}
+
+		//Write the last frames of every thread, only between frames so no zone is being recorded
+		if (writeTrace)
+		{
+			pPipeline->Flush();
+			const std::string path{ tracePath.empty() ? "trace.json" : tracePath };
+			if (Profiler::WriteChromeTrace(path))
+				std::cout << "Trace saved to " << path << std::endl;
+			else
+				std::cout << "Something went wrong. Trace not saved!" << std::endl;
+			writeTrace = false;
+		}
 	}
 	pTimer->Stop();
+	delete pPipeline;
+	//SDL turns SIGTERM into a quit event, so a preempted job saves its last frame too
+	if (pCheckpointWriter)
+	{
+		const uint32_t numFailed{ pCheckpointWriter->GetNumFailed() };
+		saveCheckpoint();
+		pCheckpointWriter->Flush();
+		if (pCheckpointWriter->GetNumFailed() > numFailed)
+			std::cout << "Something went wrong. Checkpoint not saved!" << std::endl;
+		else
+			std::cout << "Checkpoint saved to " << checkpointPath << " (" << pRenderer->GetAccumulatedSamples() << " samples per pixel)" << std::endl;
+		delete pCheckpointWriter;
+	}
+	delete pResolutionController;
+	//Finishes the screenshots still being written
+	delete pImageWriter;
+
+	if (!tracePath.empty())
+		Profiler::WriteChromeTrace(tracePath);
 
 	//Shutdown "framework"
 	delete pScene;